@@ -0,0 +1,94 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+
+#include "common/remmina_plugin.h"
+#include "rdp_backoff.h"
+
+static gint64 remmina_rdp_backoff_monotonic_clock(gpointer user_data)
+{
+	return g_get_monotonic_time();
+}
+
+/* Delay before the next reconnection attempt, once nattempt attempts have
+ * already been made: initial_delay first, doubling at each attempt up to
+ * max_delay, then half of it is randomized so that many clients cut by the
+ * same outage do not hit the server at the same time.
+ * random is in [0, 1) */
+gint64 remmina_rdp_backoff_delay(gint nattempt, gint64 initial_delay, gint64 max_delay, gdouble random)
+{
+	TRACE_CALL(__func__);
+	gint64 delay;
+
+	delay = initial_delay;
+	while (nattempt-- > 0 && delay < max_delay)
+		delay *= 2;
+	delay = MIN(delay, max_delay);
+
+	return delay / 2 + (gint64)(random * (delay - delay / 2));
+}
+
+void remmina_rdp_backoff_init(RemminaRdpBackoff *backoff, gint64 initial_delay, gint64 max_delay,
+			      RemminaRdpBackoffClock clock, gpointer clock_data)
+{
+	TRACE_CALL(__func__);
+
+	backoff->initial_delay = initial_delay;
+	backoff->max_delay = max_delay;
+	backoff->clock = clock ? clock : remmina_rdp_backoff_monotonic_clock;
+	backoff->clock_data = clock_data;
+	backoff->next_attempt = backoff->clock(backoff->clock_data);
+}
+
+/* Called when the connection is lost and after each failed attempt, with
+ * the number of attempts made so far. Returns the delay, in ms */
+gint64 remmina_rdp_backoff_schedule(RemminaRdpBackoff *backoff, gint nattempt, gdouble random)
+{
+	TRACE_CALL(__func__);
+	gint64 delay;
+
+	delay = remmina_rdp_backoff_delay(nattempt, backoff->initial_delay, backoff->max_delay, random);
+	backoff->next_attempt = backoff->clock(backoff->clock_data) + delay * 1000;
+
+	return delay;
+}
+
+/* Time left before the next attempt is due, in ms, 0 when it is due */
+gint64 remmina_rdp_backoff_remaining(RemminaRdpBackoff *backoff)
+{
+	gint64 left;
+
+	left = backoff->next_attempt - backoff->clock(backoff->clock_data);
+	return left > 0 ? (left + 999) / 1000 : 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Clock in microseconds, like g_get_monotonic_time() */
+typedef gint64 (*RemminaRdpBackoffClock)(gpointer user_data);
+
+/**
+ * Exponential backoff between two reconnection attempts. Delays are in ms
+ * and are counted from the end of the previous attempt, so a slow attempt
+ * does not eat the wait before the next one.
+ *
+ * The clock is g_get_monotonic_time() unless another one is given, e.g. a
+ * fake clock when checking the schedule.
+ */
+typedef struct remmina_rdp_backoff {
+	gint64			initial_delay;
+	gint64			max_delay;
+	gint64			next_attempt;   /* Clock time the next attempt is due at */
+	RemminaRdpBackoffClock	clock;
+	gpointer		clock_data;
+} RemminaRdpBackoff;
+
+gint64 remmina_rdp_backoff_delay(gint nattempt, gint64 initial_delay, gint64 max_delay, gdouble random);
+
+void remmina_rdp_backoff_init(RemminaRdpBackoff *backoff, gint64 initial_delay, gint64 max_delay,
+			      RemminaRdpBackoffClock clock, gpointer clock_data);
+gint64 remmina_rdp_backoff_schedule(RemminaRdpBackoff *backoff, gint nattempt, gdouble random);
+gint64 remmina_rdp_backoff_remaining(RemminaRdpBackoff *backoff);
+
+G_END_DECLS
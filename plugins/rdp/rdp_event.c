@@ -42,9 +42,25 @@
 #include "rdp_monitor.h"
 #include "rdp_settings.h"
 #include <gdk/gdkkeysyms.h>
+#include <glib-unix.h>
 #include <cairo/cairo-xlib.h>
 #include <freerdp/locale/keyboard.h>
 
+/* Maximum time spent draining the UI queue in a single idle callback,
+ * roughly half a frame at 60 Hz */
+#define REMMINA_RDP_UI_QUEUE_BUDGET_US 8000
+
+/* Preallocated slots of the event rings, must be powers of two */
+#define REMMINA_RDP_EVENT_RING_SIZE 256
+#define REMMINA_RDP_UI_RING_SIZE 128
+
+typedef struct remmina_plugin_rdp_ui_slot {
+	RemminaPluginRdpUiObject	ui;
+	RemminaPluginRdpUiObject *	sync_ui;
+} RemminaPluginRdpUiSlot;
+
+static gboolean remmina_rdp_event_process_ui_queue(gint fd, GIOCondition condition, RemminaProtocolWidget *gp);
+
 gboolean remmina_rdp_event_on_map(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
@@ -133,24 +149,106 @@ static gboolean remmina_rdp_event_on_focus_in(GtkWidget *widget, GdkEventKey *ev
 	return FALSE;
 }
 
+static gboolean remmina_rdp_event_is_motion(const RemminaPluginRdpEvent *e)
+{
+	return e->type == REMMINA_RDP_EVENT_TYPE_MOUSE &&
+	       !e->mouse_event.extended &&
+	       e->mouse_event.flags == PTR_FLAGS_MOVE;
+}
+
 void remmina_rdp_event_event_push(RemminaProtocolWidget *gp, const RemminaPluginRdpEvent *e)
 {
 	TRACE_CALL(__func__);
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 	RemminaPluginRdpEvent *event;
 
-	/* Called by the main GTK thread to send an event to the libfreerdp thread */
+	/* Called by the main GTK thread to send an event to the libfreerdp thread.
+	 * This must never wait for the libfreerdp thread: it may itself be
+	 * blocked on a sync UI call waiting for the main thread. */
 
 	if (!rfi || !rfi->connected || rfi->is_reconnecting)
 		return;
 
-	if (rfi->event_queue) {
-		event = g_memdup(e, sizeof(RemminaPluginRdpEvent));
-		g_async_queue_push(rfi->event_queue, event);
+	if (!rfi->event_ring.slots)
+		return;
 
-		if (write(rfi->event_pipe[1], "\0", 1)) {
+	/* A few clipboard events are pushed from libfreerdp threads, so the
+	 * producers are serialized. The consumer only takes this mutex to reach
+	 * the overflow queue, never to read the ring. */
+	pthread_mutex_lock(&rfi->event_ring_mutex);
+
+	if (g_queue_is_empty(rfi->event_overflow)) {
+		/* Committed slots belong to the consumer: runs of pointer motion
+		 * are coalesced when they are popped */
+		event = remmina_rdp_ring_reserve(&rfi->event_ring);
+		if (event) {
+			*event = *e;
+			remmina_rdp_ring_commit(&rfi->event_ring);
+			pthread_mutex_unlock(&rfi->event_ring_mutex);
+			return;
+		}
+	} else if (remmina_rdp_event_is_motion(e)) {
+		/* A run of pointer motion events is coalesced into its last
+		 * position, any other event ends the run, so button, wheel and
+		 * keyboard ordering is preserved */
+		event = g_queue_peek_tail(rfi->event_overflow);
+		if (remmina_rdp_event_is_motion(event)) {
+			*event = *e;
+			g_atomic_int_inc(&rfi->motion_events_merged);
+			pthread_mutex_unlock(&rfi->event_ring_mutex);
+			return;
 		}
 	}
+
+	/* The ring is full, keep the event aside until the libfreerdp thread
+	 * catches up. Once something is in the overflow queue, every new event
+	 * goes there too, so ordering is preserved. */
+	g_queue_push_tail(rfi->event_overflow, g_memdup(e, sizeof(RemminaPluginRdpEvent)));
+	g_atomic_int_inc(&rfi->event_overflow_len);
+	remmina_rdp_ring_ring_doorbell(&rfi->event_ring);
+	pthread_mutex_unlock(&rfi->event_ring_mutex);
+}
+
+gboolean remmina_rdp_event_event_pop(RemminaProtocolWidget *gp, RemminaPluginRdpEvent *event)
+{
+	TRACE_CALL(__func__);
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
+	RemminaPluginRdpEvent *slot;
+	gboolean ret = FALSE;
+
+	/* Called by the libfreerdp thread to fetch the next event to send.
+	 * The ring always holds the oldest events, the overflow queue the
+	 * newest ones: producers only commit into the ring while the overflow
+	 * queue is empty. The ring is read without locking, its indexes carry
+	 * the ordering between the producers and us. */
+
+	if ((slot = remmina_rdp_ring_peek(&rfi->event_ring)) != NULL) {
+		*event = *slot;
+		remmina_rdp_ring_release(&rfi->event_ring);
+		/* Only the last position of a run of pointer motion matters */
+		while (remmina_rdp_event_is_motion(event) &&
+		       (slot = remmina_rdp_ring_peek(&rfi->event_ring)) != NULL &&
+		       remmina_rdp_event_is_motion(slot)) {
+			*event = *slot;
+			remmina_rdp_ring_release(&rfi->event_ring);
+			g_atomic_int_inc(&rfi->motion_events_merged);
+		}
+		return TRUE;
+	}
+
+	if (g_atomic_int_get(&rfi->event_overflow_len) == 0)
+		return FALSE;
+
+	pthread_mutex_lock(&rfi->event_ring_mutex);
+	if ((slot = g_queue_pop_head(rfi->event_overflow)) != NULL) {
+		*event = *slot;
+		g_free(slot);
+		g_atomic_int_add(&rfi->event_overflow_len, -1);
+		ret = TRUE;
+	}
+	pthread_mutex_unlock(&rfi->event_ring_mutex);
+
+	return ret;
 }
 
 static void remmina_rdp_event_release_all_keys(RemminaProtocolWidget *gp)
@@ -264,20 +362,37 @@ void remmina_rdp_event_update_regions(RemminaProtocolWidget *gp, RemminaPluginRd
 {
 	TRACE_CALL(__func__);
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
-	gint x, y, w, h, i;
-
-	for (i = 0; i < ui->reg.ninvalid; i++) {
-		x = ui->reg.ureg[i].x;
-		y = ui->reg.ureg[i].y;
-		w = ui->reg.ureg[i].w;
-		h = ui->reg.ureg[i].h;
-
-		if (rfi->scale == REMMINA_PROTOCOL_WIDGET_SCALE_MODE_SCALED)
-			remmina_rdp_event_scale_area(gp, &x, &y, &w, &h);
+	cairo_region_t *damage, *old;
+	cairo_rectangle_int_t rect;
+	gint i, n;
+
+	/* Clear the pending flag before taking the accumulated damage, so
+	 * rectangles published after the swap will queue a new update */
+	g_atomic_int_set(&rfi->damage_pending, 0);
+	damage = __atomic_exchange_n(&rfi->damage, NULL, __ATOMIC_ACQ_REL);
+	if (!damage)
+		return;
 
-		gtk_widget_queue_draw_area(rfi->drawing_area, x, y, w, h);
+	if (rfi->scale == REMMINA_PROTOCOL_WIDGET_SCALE_MODE_SCALED) {
+		if (!rfi->damage_scaled)
+			rfi->damage_scaled = cairo_region_create();
+		n = cairo_region_num_rectangles(damage);
+		for (i = 0; i < n; i++) {
+			cairo_region_get_rectangle(damage, i, &rect);
+			remmina_rdp_event_scale_area(gp, &rect.x, &rect.y, &rect.width, &rect.height);
+			cairo_region_union_rectangle(rfi->damage_scaled, &rect);
+		}
+		gtk_widget_queue_draw_region(rfi->drawing_area, rfi->damage_scaled);
+		cairo_region_subtract(rfi->damage_scaled, rfi->damage_scaled);
+	} else {
+		gtk_widget_queue_draw_region(rfi->drawing_area, damage);
 	}
-	g_free(ui->reg.ureg);
+
+	/* Hand the emptied region back to the libfreerdp thread for reuse */
+	cairo_region_subtract(damage, damage);
+	old = __atomic_exchange_n(&rfi->damage_free, damage, __ATOMIC_ACQ_REL);
+	if (old)
+		cairo_region_destroy(old);
 }
 
 void remmina_rdp_event_update_rect(RemminaProtocolWidget *gp, gint x, gint y, gint w, gint h)
@@ -844,11 +959,21 @@ gboolean remmina_rdp_event_on_clipboard(GtkClipboard *gtkClipboard, GdkEvent *ev
 	return TRUE;
 }
 
+static void remmina_rdp_event_on_network_changed(GNetworkMonitor *monitor, gboolean network_available, RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
+
+	/* Do not let a reconnect loop wait for the end of its delay, the network is back */
+	if (rfi && network_available && rfi->is_reconnecting)
+		g_atomic_int_set(&rfi->reconnect_network_changed, TRUE);
+}
+
 void remmina_rdp_event_init(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
 	gchar *s;
-	gint flags;
+	GSource *ui_source;
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 	GtkClipboard *clipboard;
 	RemminaFile *remminafile;
@@ -929,24 +1054,39 @@ void remmina_rdp_event_init(RemminaProtocolWidget *gp)
 		rfi->clipboard.clipboard_handler = g_signal_connect(clipboard, "owner-change", G_CALLBACK(remmina_rdp_event_on_clipboard), gp);
 	}
 
+	/* The default monitor is created and watched from the main thread, the
+	 * reconnect loop of the libfreerdp thread only looks at the flag */
+	rfi->network_monitor = g_network_monitor_get_default();
+	rfi->network_changed_handler = g_signal_connect(rfi->network_monitor, "network-changed",
+							 G_CALLBACK(remmina_rdp_event_on_network_changed), gp);
+
 	rfi->pressed_keys = g_array_new(FALSE, TRUE, sizeof(RemminaPluginRdpEvent));
-	rfi->event_queue = g_async_queue_new_full(g_free);
-	rfi->ui_queue = g_async_queue_new();
-	pthread_mutex_init(&rfi->ui_queue_mutex, NULL);
 
-	if (pipe(rfi->event_pipe)) {
-		g_print("Error creating pipes.\n");
-		rfi->event_pipe[0] = -1;
-		rfi->event_pipe[1] = -1;
+	pthread_mutex_init(&rfi->event_ring_mutex, NULL);
+	rfi->event_overflow = g_queue_new();
+	rfi->event_overflow_len = 0;
+	if (!remmina_rdp_ring_init(&rfi->event_ring, REMMINA_RDP_EVENT_RING_SIZE, sizeof(RemminaPluginRdpEvent))) {
 		rfi->event_handle = NULL;
 	} else {
-		flags = fcntl(rfi->event_pipe[0], F_GETFL, 0);
-		fcntl(rfi->event_pipe[0], F_SETFL, flags | O_NONBLOCK);
-		rfi->event_handle = CreateFileDescriptorEvent(NULL, FALSE, FALSE, rfi->event_pipe[0], WINPR_FD_READ);
+		rfi->event_handle = CreateFileDescriptorEvent(NULL, FALSE, FALSE,
+							      remmina_rdp_ring_get_doorbell_fd(&rfi->event_ring), WINPR_FD_READ);
 		if (!rfi->event_handle)
 			g_print("CreateFileDescriptorEvent() failed\n");
 	}
 
+	pthread_mutex_init(&rfi->ui_queue_mutex, NULL);
+	rfi->ui_overflow = g_queue_new();
+	pthread_mutex_init(&rfi->ui_sync_mutex, NULL);
+	pthread_cond_init(&rfi->ui_sync_cond, NULL);
+	if (remmina_rdp_ring_init(&rfi->ui_ring, REMMINA_RDP_UI_RING_SIZE, sizeof(RemminaPluginRdpUiSlot))) {
+		/* Keep the previous idle priority, so UI objects do not starve GTK redraws */
+		ui_source = g_unix_fd_source_new(remmina_rdp_ring_get_doorbell_fd(&rfi->ui_ring), G_IO_IN);
+		g_source_set_priority(ui_source, G_PRIORITY_DEFAULT_IDLE);
+		g_source_set_callback(ui_source, (GSourceFunc)remmina_rdp_event_process_ui_queue, gp, NULL);
+		rfi->ui_handler = g_source_attach(ui_source, NULL);
+		g_source_unref(ui_source);
+	}
+
 	rfi->object_table = g_hash_table_new_full(NULL, NULL, NULL, g_free);
 
 	rfi->display = gdk_display_get_default();
@@ -960,7 +1100,7 @@ void remmina_rdp_event_init(RemminaProtocolWidget *gp)
 #endif
 }
 
-void remmina_rdp_event_free_event(RemminaProtocolWidget *gp, RemminaPluginRdpUiObject *obj)
+static void remmina_rdp_event_free_event_data(RemminaProtocolWidget *gp, RemminaPluginRdpUiObject *obj)
 {
 	TRACE_CALL(__func__);
 
@@ -972,15 +1112,37 @@ void remmina_rdp_event_free_event(RemminaProtocolWidget *gp, RemminaPluginRdpUiO
 	default:
 		break;
 	}
+}
+
+void remmina_rdp_event_free_event(RemminaProtocolWidget *gp, RemminaPluginRdpUiObject *obj)
+{
+	TRACE_CALL(__func__);
 
+	remmina_rdp_event_free_event_data(gp, obj);
 	g_free(obj);
 }
 
+static void remmina_rdp_event_discard_ui_slot(RemminaProtocolWidget *gp, RemminaPluginRdpUiSlot *slot)
+{
+	TRACE_CALL(__func__);
+	rfContext *rfi = GET_PLUGIN_DATA(gp);
+
+	if (slot->sync_ui) {
+		/* Do not leave the caller waiting forever */
+		pthread_mutex_lock(&rfi->ui_sync_mutex);
+		slot->sync_ui->complete = TRUE;
+		pthread_cond_broadcast(&rfi->ui_sync_cond);
+		pthread_mutex_unlock(&rfi->ui_sync_mutex);
+	} else {
+		remmina_rdp_event_free_event_data(gp, &slot->ui);
+	}
+}
+
 void remmina_rdp_event_uninit(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
-	RemminaPluginRdpUiObject *ui;
+	RemminaPluginRdpUiSlot *slot;
 
 	if (!rfi) return;
 
@@ -993,12 +1155,38 @@ void remmina_rdp_event_uninit(RemminaProtocolWidget *gp)
 		g_source_remove(rfi->delayed_monitor_layout_handler);
 		rfi->delayed_monitor_layout_handler = 0;
 	}
+	if (rfi->network_changed_handler) {
+		g_signal_handler_disconnect(rfi->network_monitor, rfi->network_changed_handler);
+		rfi->network_changed_handler = 0;
+	}
 	if (rfi->ui_handler) {
 		g_source_remove(rfi->ui_handler);
 		rfi->ui_handler = 0;
 	}
-	while ((ui = (RemminaPluginRdpUiObject *)g_async_queue_try_pop(rfi->ui_queue)) != NULL)
-		remmina_rdp_event_free_event(gp, ui);
+	if (rfi->ui_ring.slots) {
+		while ((slot = remmina_rdp_ring_peek(&rfi->ui_ring)) != NULL) {
+			remmina_rdp_event_discard_ui_slot(gp, slot);
+			remmina_rdp_ring_release(&rfi->ui_ring);
+		}
+	}
+	while ((slot = g_queue_pop_head(rfi->ui_overflow)) != NULL) {
+		remmina_rdp_event_discard_ui_slot(gp, slot);
+		g_free(slot);
+	}
+	g_queue_free(rfi->ui_overflow);
+	rfi->ui_overflow = NULL;
+	if (rfi->damage) {
+		cairo_region_destroy(rfi->damage);
+		rfi->damage = NULL;
+	}
+	if (rfi->damage_free) {
+		cairo_region_destroy(rfi->damage_free);
+		rfi->damage_free = NULL;
+	}
+	if (rfi->damage_scaled) {
+		cairo_region_destroy(rfi->damage_scaled);
+		rfi->damage_scaled = NULL;
+	}
 	if (rfi->surface) {
 		cairo_surface_destroy(rfi->surface);
 		rfi->surface = NULL;
@@ -1011,10 +1199,10 @@ void remmina_rdp_event_uninit(RemminaProtocolWidget *gp)
 		g_array_free(rfi->keymap, TRUE);
 		rfi->keymap = NULL;
 	}
-	g_async_queue_unref(rfi->event_queue);
-	rfi->event_queue = NULL;
-	g_async_queue_unref(rfi->ui_queue);
-	rfi->ui_queue = NULL;
+	REMMINA_PLUGIN_DEBUG("%d pointer motion events have been coalesced", rfi->motion_events_merged);
+	remmina_rdp_ring_destroy(&rfi->ui_ring);
+	pthread_cond_destroy(&rfi->ui_sync_cond);
+	pthread_mutex_destroy(&rfi->ui_sync_mutex);
 	pthread_mutex_destroy(&rfi->ui_queue_mutex);
 
 	if (rfi->event_handle) {
@@ -1022,8 +1210,10 @@ void remmina_rdp_event_uninit(RemminaProtocolWidget *gp)
 		rfi->event_handle = NULL;
 	}
 
-	close(rfi->event_pipe[0]);
-	close(rfi->event_pipe[1]);
+	remmina_rdp_ring_destroy(&rfi->event_ring);
+	g_queue_free_full(rfi->event_overflow, g_free);
+	rfi->event_overflow = NULL;
+	pthread_mutex_destroy(&rfi->event_ring_mutex);
 }
 
 static void remmina_rdp_event_create_cairo_surface(rfContext *rfi)
@@ -1300,42 +1490,67 @@ static void remmina_rdp_event_process_ui_event(RemminaProtocolWidget *gp, Remmin
 	}
 }
 
-static gboolean remmina_rdp_event_process_ui_queue(RemminaProtocolWidget *gp)
+static gboolean remmina_rdp_event_process_ui_queue(gint fd, GIOCondition condition, RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
 
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
+	RemminaPluginRdpUiSlot *slot, *queued;
 	RemminaPluginRdpUiObject *ui;
-
-	pthread_mutex_lock(&rfi->ui_queue_mutex);
-	ui = (RemminaPluginRdpUiObject *)g_async_queue_try_pop(rfi->ui_queue);
-	if (ui) {
-		pthread_mutex_lock(&ui->sync_wait_mutex);
+	gint64 deadline;
+
+	/* Drain as many UI objects as we can within one frame budget, so a burst
+	 * of updates coming from the libfreerdp thread reaches the screen in a
+	 * single main loop iteration. */
+	remmina_rdp_ring_clear_doorbell(&rfi->ui_ring);
+	deadline = g_get_monotonic_time() + REMMINA_RDP_UI_QUEUE_BUDGET_US;
+
+	for (;;) {
+		/* The ring always holds the oldest objects, the overflow queue the
+		 * newest ones */
+		queued = NULL;
+		if ((slot = remmina_rdp_ring_peek(&rfi->ui_ring)) == NULL) {
+			pthread_mutex_lock(&rfi->ui_queue_mutex);
+			queued = g_queue_pop_head(rfi->ui_overflow);
+			pthread_mutex_unlock(&rfi->ui_queue_mutex);
+			if (!queued)
+				break;
+			slot = queued;
+		}
+		ui = slot->sync_ui ? slot->sync_ui : &slot->ui;
 		if (!rfi->thread_cancelled)
 			remmina_rdp_event_process_ui_event(gp, ui);
 		// Should we signal the caller thread to unlock ?
 		if (ui->sync) {
+			pthread_mutex_lock(&rfi->ui_sync_mutex);
 			ui->complete = TRUE;
-			pthread_cond_signal(&ui->sync_wait_cond);
-			pthread_mutex_unlock(&ui->sync_wait_mutex);
+			pthread_cond_broadcast(&rfi->ui_sync_cond);
+			pthread_mutex_unlock(&rfi->ui_sync_mutex);
 		} else {
-			remmina_rdp_event_free_event(gp, ui);
+			remmina_rdp_event_free_event_data(gp, ui);
 		}
+		if (queued)
+			g_free(queued);
+		else
+			remmina_rdp_ring_release(&rfi->ui_ring);
 
-		pthread_mutex_unlock(&rfi->ui_queue_mutex);
-		return TRUE;
-	} else {
-		rfi->ui_handler = 0;
-		pthread_mutex_unlock(&rfi->ui_queue_mutex);
-		return FALSE;
+		if (g_get_monotonic_time() >= deadline) {
+			/* Out of budget, ring again to be called on the next main loop
+			 * iteration. A spurious wakeup just finds nothing to do. */
+			remmina_rdp_ring_ring_doorbell(&rfi->ui_ring);
+			break;
+		}
 	}
+
+	return G_SOURCE_CONTINUE;
 }
 
 static void remmina_rdp_event_queue_ui(RemminaProtocolWidget *gp, RemminaPluginRdpUiObject *ui)
 {
 	TRACE_CALL(__func__);
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
-	gboolean ui_sync_save;
+	RemminaPluginRdpUiSlot *slot;
+	gboolean ui_sync_save, overflow;
 	int oldcanceltype;
 
 	if (rfi->thread_cancelled)
@@ -1343,42 +1558,62 @@ static void remmina_rdp_event_queue_ui(RemminaProtocolWidget *gp, RemminaPluginR
 
 	if (remmina_plugin_service->is_main_thread()) {
 		remmina_rdp_event_process_ui_event(gp, ui);
+		if (!ui->sync)
+			remmina_rdp_event_free_event_data(gp, ui);
 		return;
 	}
 
-	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldcanceltype);
+	if (!rfi->ui_ring.slots)
+		return;
 
+	/* ui_queue_mutex serializes producers and guards the overflow queue,
+	 * the main thread consumes the ring without locking. It is never held
+	 * while waiting, so the main thread can always take it. */
 	pthread_mutex_lock(&rfi->ui_queue_mutex);
 
 	ui_sync_save = ui->sync;
 	ui->complete = FALSE;
 
-	if (ui_sync_save) {
-		pthread_mutex_init(&ui->sync_wait_mutex, NULL);
-		pthread_cond_init(&ui->sync_wait_cond, NULL);
+	overflow = !g_queue_is_empty(rfi->ui_overflow);
+	slot = overflow ? NULL : remmina_rdp_ring_reserve(&rfi->ui_ring);
+	if (!slot) {
+		/* The ring is full, keep the object aside until the main thread
+		 * catches up. Once something is in the overflow queue, every new
+		 * object goes there too, so ordering is preserved. */
+		slot = g_new(RemminaPluginRdpUiSlot, 1);
+		g_queue_push_tail(rfi->ui_overflow, slot);
+		overflow = TRUE;
 	}
 
-	ui->complete = FALSE;
+	/* Async objects are copied into the slot, sync objects stay with the
+	 * caller, which is waiting for the result */
+	if (ui_sync_save) {
+		slot->sync_ui = ui;
+	} else {
+		slot->ui = *ui;
+		slot->sync_ui = NULL;
+	}
 
-	g_async_queue_push(rfi->ui_queue, ui);
+	if (overflow)
+		remmina_rdp_ring_ring_doorbell(&rfi->ui_ring);
+	else
+		remmina_rdp_ring_commit(&rfi->ui_ring);
 
-	if (!rfi->ui_handler)
-		rfi->ui_handler = IDLE_ADD((GSourceFunc)remmina_rdp_event_process_ui_queue, gp);
+	pthread_mutex_unlock(&rfi->ui_queue_mutex);
 
 	if (ui_sync_save) {
 		/* Wait for main thread function completion before returning */
-		pthread_mutex_lock(&ui->sync_wait_mutex);
-		pthread_mutex_unlock(&rfi->ui_queue_mutex);
+		pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldcanceltype);
+		pthread_mutex_lock(&rfi->ui_sync_mutex);
+		pthread_cleanup_push((void (*)(void *))pthread_mutex_unlock, &rfi->ui_sync_mutex);
 		while (!ui->complete)
-			pthread_cond_wait(&ui->sync_wait_cond, &ui->sync_wait_mutex);
-		pthread_cond_destroy(&ui->sync_wait_cond);
-		pthread_mutex_destroy(&ui->sync_wait_mutex);
-	} else {
-		pthread_mutex_unlock(&rfi->ui_queue_mutex);
+			pthread_cond_wait(&rfi->ui_sync_cond, &rfi->ui_sync_mutex);
+		pthread_cleanup_pop(1);
+		pthread_setcanceltype(oldcanceltype, NULL);
 	}
-	pthread_setcanceltype(oldcanceltype, NULL);
 }
 
+/* The object is copied into the UI ring, so the caller keeps its ownership */
 void remmina_rdp_event_queue_ui_async(RemminaProtocolWidget *gp, RemminaPluginRdpUiObject *ui)
 {
 	ui->sync = FALSE;
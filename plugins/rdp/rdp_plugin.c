@@ -45,6 +45,7 @@
 #include "rdp_cliprdr.h"
 #include "rdp_monitor.h"
 #include "rdp_channels.h"
+#include "rdp_backoff.h"
 
 #include <errno.h>
 #include <pthread.h>
@@ -194,19 +195,23 @@ static BOOL rf_process_event_queue(RemminaProtocolWidget *gp)
 	UINT16 flags;
 	rdpInput *input;
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
-	RemminaPluginRdpEvent *event;
+	RemminaPluginRdpEvent rdp_event;
+	RemminaPluginRdpEvent *event = &rdp_event;
 	DISPLAY_CONTROL_MONITOR_LAYOUT *dcml;
 	CLIPRDR_FORMAT_DATA_RESPONSE response = { 0 };
 	RemminaFile *remminafile;
 
-	if (rfi->event_queue == NULL)
+	if (rfi->event_ring.slots == NULL)
 		return True;
 
 	input = rfi->instance->input;
 
 	remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
 
-	while ((event = (RemminaPluginRdpEvent *)g_async_queue_try_pop(rfi->event_queue)) != NULL) {
+	/* Clear the doorbell before draining, so events committed meanwhile ring it again */
+	remmina_rdp_ring_clear_doorbell(&rfi->event_ring);
+
+	while (remmina_rdp_event_event_pop(gp, event)) {
 		switch (event->type) {
 		case REMMINA_RDP_EVENT_TYPE_SCANCODE:
 			flags = event->key_event.extended ? KBD_FLAGS_EXTENDED : 0;
@@ -307,8 +312,6 @@ static BOOL rf_process_event_queue(RemminaProtocolWidget *gp)
 			freerdp_abort_connect(rfi->instance);
 			break;
 		}
-
-		g_free(event);
 	}
 
 	return True;
@@ -333,6 +336,8 @@ static gboolean remmina_rdp_tunnel_init(RemminaProtocolWidget *gp)
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 
 	REMMINA_PLUGIN_DEBUG("Tunnel init");
+	/* Reconnects go through the same tunnel while it is alive */
+	remmina_plugin_service->protocol_plugin_keep_tunnel_listening(gp);
 	hostport = remmina_plugin_service->protocol_plugin_start_direct_tunnel(gp, 3389, FALSE);
 	if (hostport == NULL)
 		return FALSE;
@@ -373,14 +378,20 @@ static gboolean remmina_rdp_tunnel_init(RemminaProtocolWidget *gp)
 	return TRUE;
 }
 
+/* Default bounds of the delay between two reconnection attempts, in ms */
+#define RDP_RECONNECT_DEFAULT_INITIAL_DELAY 500
+#define RDP_RECONNECT_DEFAULT_MAX_DELAY 30000
+
 BOOL rf_auto_reconnect(rfContext *rfi)
 {
 	TRACE_CALL(__func__);
 	rdpSettings *settings = rfi->instance->settings;
-	RemminaPluginRdpUiObject *ui;
-	time_t treconn;
+	RemminaPluginRdpUiObject ui = { 0 };
+	RemminaRdpBackoff backoff;
+	gint64 delay, initial_delay, max_delay, remaining;
 	gchar *cval;
 	gint maxattempts;
+	BOOL reconnected;
 
 	RemminaProtocolWidget *gp = rfi->protocol_widget;
 	RemminaFile *remminafile = remmina_plugin_service->protocol_plugin_get_file(gp);
@@ -397,6 +408,13 @@ BOOL rf_auto_reconnect(rfContext *rfi)
 	rfi->reconnect_maxattempts = maxattempts;
 	rfi->reconnect_nattempt = 0;
 
+	initial_delay = remmina_plugin_service->file_get_int(remminafile, "rdp_reconnect_initial_delay", RDP_RECONNECT_DEFAULT_INITIAL_DELAY);
+	if (initial_delay <= 0)
+		initial_delay = RDP_RECONNECT_DEFAULT_INITIAL_DELAY;
+	max_delay = remmina_plugin_service->file_get_int(remminafile, "rdp_reconnect_max_delay", RDP_RECONNECT_DEFAULT_MAX_DELAY);
+	if (max_delay < initial_delay)
+		max_delay = MAX(initial_delay, RDP_RECONNECT_DEFAULT_MAX_DELAY);
+
 	/* Only auto reconnect on network disconnects. */
 	switch (freerdp_error_info(rfi->instance)) {
 	case ERRINFO_GRAPHICS_SUBSYSTEM_FAILED:
@@ -420,26 +438,43 @@ BOOL rf_auto_reconnect(rfContext *rfi)
 	REMMINA_PLUGIN_DEBUG("[%s] network disconnection detected, initiating reconnection attempt",
 			     freerdp_settings_get_string(rfi->settings, FreeRDP_ServerHostname));
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
-	ui->type = REMMINA_RDP_UI_RECONNECT_PROGRESS;
-	remmina_rdp_event_queue_ui_async(rfi->protocol_widget, ui);
+	ui.type = REMMINA_RDP_UI_RECONNECT_PROGRESS;
+	remmina_rdp_event_queue_ui_async(rfi->protocol_widget, &ui);
 
-	/* Sleep half a second to allow:
-	 *  - processing of the UI event we just pushed on the queue
-	 *  - better network conditions
-	 *  Remember: We hare on a thread, so the main gui won’t lock */
+	g_atomic_int_set(&rfi->reconnect_network_changed, FALSE);
 
-	usleep(500000);
+	reconnected = FALSE;
+	remmina_rdp_backoff_init(&backoff, initial_delay, max_delay, NULL, NULL);
 
 	/* Perform an auto-reconnect. */
 	while (TRUE) {
 		/* Quit retrying if max retries has been exceeded */
-		if (rfi->reconnect_nattempt++ >= rfi->reconnect_maxattempts) {
+		if (rfi->reconnect_nattempt >= rfi->reconnect_maxattempts) {
 			REMMINA_PLUGIN_DEBUG("[%s] maximum number of reconnection attempts exceeded.",
 					     freerdp_settings_get_string(rfi->settings, FreeRDP_ServerHostname));
 			break;
 		}
 
+		/* Wait for the backoff delay from the end of the last attempt, while
+		 * checking for rfi->stop_reconnecting_requested and for the network
+		 * coming back. The first delay also leaves time to process the UI event
+		 * we just pushed on the queue. Remember: We are on a thread, so the main
+		 * gui won’t lock */
+		delay = remmina_rdp_backoff_schedule(&backoff, rfi->reconnect_nattempt, g_random_double());
+		rfi->reconnect_nattempt++;
+		REMMINA_PLUGIN_DEBUG("[%s] next reconnection attempt in %" G_GINT64_FORMAT " ms",
+				     freerdp_settings_get_string(rfi->settings, FreeRDP_ServerHostname), delay);
+		while ((remaining = remmina_rdp_backoff_remaining(&backoff)) > 0) {
+			if (rfi->stop_reconnecting_requested)
+				break;
+			if (g_atomic_int_compare_and_exchange(&rfi->reconnect_network_changed, TRUE, FALSE)) {
+				REMMINA_PLUGIN_DEBUG("[%s] network is available again, retrying now.",
+						     freerdp_settings_get_string(rfi->settings, FreeRDP_ServerHostname));
+				break;
+			}
+			usleep(MIN(200, remaining) * 1000);
+		}
+
 		if (rfi->stop_reconnecting_requested) {
 			REMMINA_PLUGIN_DEBUG("[%s] reconnect request loop interrupted by user.",
 					     freerdp_settings_get_string(rfi->settings, FreeRDP_ServerHostname));
@@ -450,11 +485,7 @@ BOOL rf_auto_reconnect(rfContext *rfi)
 		REMMINA_PLUGIN_DEBUG("[%s] reconnection, attempt #%d of %d",
 				     freerdp_settings_get_string(rfi->settings, FreeRDP_ServerHostname), rfi->reconnect_nattempt, rfi->reconnect_maxattempts);
 
-		ui = g_new0(RemminaPluginRdpUiObject, 1);
-		ui->type = REMMINA_RDP_UI_RECONNECT_PROGRESS;
-		remmina_rdp_event_queue_ui_async(rfi->protocol_widget, ui);
-
-		treconn = time(NULL);
+		remmina_rdp_event_queue_ui_async(rfi->protocol_widget, &ui);
 
 		/* Reconnect the SSH tunnel, if needed */
 		if (!remmina_rdp_tunnel_init(rfi->protocol_widget)) {
@@ -464,21 +495,16 @@ BOOL rf_auto_reconnect(rfContext *rfi)
 			if (freerdp_reconnect(rfi->instance)) {
 				/* Reconnection is successful */
 				REMMINA_PLUGIN_DEBUG("[%s] reconnected.", freerdp_settings_get_string(rfi->settings, FreeRDP_ServerHostname));
-				rfi->is_reconnecting = FALSE;
-				return TRUE;
-			}
-		}
-
-		/* Wait until 5 secs have elapsed from last reconnect attempt, while checking for rfi->stop_reconnecting_requested */
-		while (time(NULL) - treconn < 5) {
-			if (rfi->stop_reconnecting_requested)
+				/* rf_end_paint() reports how long the first frame takes */
+				rfi->reconnect_time = g_get_monotonic_time();
+				reconnected = TRUE;
 				break;
-			usleep(200000); // 200ms sleep
+			}
 		}
 	}
 
 	rfi->is_reconnecting = FALSE;
-	return FALSE;
+	return reconnected;
 }
 
 BOOL rf_begin_paint(rdpContext *context)
@@ -501,10 +527,11 @@ BOOL rf_end_paint(rdpContext *context)
 	TRACE_CALL(__func__);
 	rdpGdi *gdi;
 	rfContext *rfi;
-	RemminaPluginRdpUiObject *ui;
+	RemminaPluginRdpUiObject ui = { 0 };
 	int i, ninvalid;
-	region *reg;
 	HGDI_RGN cinvalid;
+	cairo_region_t *damage;
+	cairo_rectangle_int_t rect;
 
 	gdi = context->gdi;
 	rfi = (rfContext *)context;
@@ -515,23 +542,38 @@ BOOL rf_end_paint(rdpContext *context)
 	if (gdi->primary->hdc->hwnd->ninvalid < 1)
 		return TRUE;
 
+	/* Take back the damage not yet submitted by the main thread, or reuse
+	 * the region it handed back after the last submission */
+	damage = __atomic_exchange_n(&rfi->damage, NULL, __ATOMIC_ACQ_REL);
+	if (!damage)
+		damage = __atomic_exchange_n(&rfi->damage_free, NULL, __ATOMIC_ACQ_REL);
+	if (!damage)
+		damage = cairo_region_create();
+
 	ninvalid = gdi->primary->hdc->hwnd->ninvalid;
 	cinvalid = gdi->primary->hdc->hwnd->cinvalid;
-	reg = (region *)g_malloc(sizeof(region) * ninvalid);
 	for (i = 0; i < ninvalid; i++) {
-		reg[i].x = cinvalid[i].x;
-		reg[i].y = cinvalid[i].y;
-		reg[i].w = cinvalid[i].w;
-		reg[i].h = cinvalid[i].h;
+		rect.x = cinvalid[i].x;
+		rect.y = cinvalid[i].y;
+		rect.width = cinvalid[i].w;
+		rect.height = cinvalid[i].h;
+		cairo_region_union_rectangle(damage, &rect);
 	}
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
-	ui->type = REMMINA_RDP_UI_UPDATE_REGIONS;
-	ui->reg.ninvalid = ninvalid;
-	ui->reg.ureg = reg;
+	__atomic_store_n(&rfi->damage, damage, __ATOMIC_RELEASE);
 
-	remmina_rdp_event_queue_ui_async(rfi->protocol_widget, ui);
+	if (rfi->reconnect_time) {
+		REMMINA_PLUGIN_DEBUG("[%s] first frame %" G_GINT64_FORMAT " ms after the reconnection",
+				     freerdp_settings_get_string(rfi->settings, FreeRDP_ServerHostname),
+				     (g_get_monotonic_time() - rfi->reconnect_time) / 1000);
+		rfi->reconnect_time = 0;
+	}
 
+	/* Only one UI update is needed until the main thread consumes the damage */
+	if (g_atomic_int_compare_and_exchange(&rfi->damage_pending, 0, 1)) {
+		ui.type = REMMINA_RDP_UI_UPDATE_REGIONS;
+		remmina_rdp_event_queue_ui_async(rfi->protocol_widget, &ui);
+	}
 
 	gdi->primary->hdc->hwnd->invalid->null = TRUE;
 	gdi->primary->hdc->hwnd->ninvalid = 0;
@@ -666,7 +708,7 @@ static BOOL remmina_rdp_post_connect(freerdp *instance)
 	TRACE_CALL(__func__);
 	rfContext *rfi;
 	RemminaProtocolWidget *gp;
-	RemminaPluginRdpUiObject *ui;
+	RemminaPluginRdpUiObject ui = { 0 };
 	UINT32 freerdp_local_color_format;
 
 	rfi = (rfContext *)instance->context;
@@ -729,9 +771,8 @@ static BOOL remmina_rdp_post_connect(freerdp *instance)
 	remmina_rdp_clipboard_init(rfi);
 	rfi->connected = True;
 
-	ui = g_new0(RemminaPluginRdpUiObject, 1);
-	ui->type = REMMINA_RDP_UI_CONNECTED;
-	remmina_rdp_event_queue_ui_async(gp, ui);
+	ui.type = REMMINA_RDP_UI_CONNECTED;
+	remmina_rdp_event_queue_ui_async(gp, &ui);
 
 	return TRUE;
 }
@@ -960,7 +1001,6 @@ static void remmina_rdp_main_loop(RemminaProtocolWidget *gp)
 	DWORD nCount;
 	DWORD status;
 	HANDLE handles[64];
-	gchar buf[100];
 	rfContext *rfi = GET_PLUGIN_DATA(gp);
 
 
@@ -988,8 +1028,6 @@ static void remmina_rdp_main_loop(RemminaProtocolWidget *gp)
 				fprintf(stderr, "Could not process local keyboard/mouse event queue\n");
 				break;
 			}
-			if (read(rfi->event_pipe[0], buf, sizeof(buf))) {
-			}
 		}
 
 		/* Check if a processed event called freerdp_abort_connect() and exit if true */
@@ -2723,6 +2761,8 @@ static const RemminaProtocolSetting remmina_rdp_advanced_settings[] =
 	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "vc",			    N_("Static virtual channel"),			 FALSE, NULL,		  N_("<channel>[,<options>]")											 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "rdp2tcp",		    N_("TCP redirection"),				 FALSE, NULL,		  N_("/PATH/TO/rdp2tcp")											 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "rdp_reconnect_attempts", N_("Reconnect attempts number"),			 FALSE, NULL,		  N_("The maximum number of reconnect attempts upon an RDP disconnect (default: 20)")				 },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "rdp_reconnect_initial_delay", N_("First reconnect delay (ms)"),		 FALSE, NULL,		  N_("Wait before the first reconnect attempt, doubled at each attempt (default: 500)")				 },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	  "rdp_reconnect_max_delay", N_("Maximum reconnect delay (ms)"),		 FALSE, NULL,		  N_("Upper bound of the wait between reconnect attempts (default: 30000)")					 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "preferipv6",		    N_("Prefer IPv6 AAAA record over IPv4 A record"),	 TRUE,	NULL,		  NULL														 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "shareprinter",	    N_("Share printers"),				 TRUE,	NULL,		  NULL														 },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	  "shareserial",	    N_("Share serial ports"),				 TRUE,	NULL,		  NULL														 },
@@ -51,6 +51,8 @@
 
 #include <winpr/clipboard.h>
 
+#include "rdp_ring.h"
+
 /**
  * FREERDP_CHECK_VERSION:
  * @major: major version (e.g. 2 for version 2.1.0)
@@ -224,21 +226,11 @@ typedef enum {
 	REMMINA_RDP_UI_EVENT_DESTROY_CAIRO_SURFACE
 } RemminaPluginRdpUiEeventType;
 
-typedef struct {
-	gint x, y, w, h;
-} region;
-
 struct remmina_plugin_rdp_ui_object {
 	RemminaPluginRdpUiType	type;
 	gboolean		sync;
 	gboolean		complete;
-	pthread_mutex_t		sync_wait_mutex;
-	pthread_cond_t		sync_wait_cond;
 	union {
-		struct {
-			region *ureg;
-			gint	ninvalid;
-		} reg;
 		struct {
 			rdpContext *			context;
 			rfPointer *			pointer;
@@ -316,6 +308,13 @@ struct rf_context {
 	gboolean		orphaned;
 	int			reconnect_maxattempts;
 	int			reconnect_nattempt;
+	/* Set by GNetworkMonitor to cut short the wait before the next attempt.
+	 * The monitor is watched from the main thread for the whole session */
+	gint			reconnect_network_changed;
+	GNetworkMonitor *	network_monitor;
+	gulong			network_changed_handler;
+	/* Monotonic time of the last successful reconnection, until its first frame */
+	gint64			reconnect_time;
 
 	gboolean		sw_gdi;
 	GtkWidget *		drawing_area;
@@ -338,13 +337,30 @@ struct rf_context {
 	guint			object_id_seq;
 	GHashTable *		object_table;
 
-	GAsyncQueue *		ui_queue;
+	/* UI objects from libfreerdp threads to the main thread */
+	RemminaRdpRing		ui_ring;
+	GQueue *		ui_overflow;
 	pthread_mutex_t		ui_queue_mutex;
+	pthread_mutex_t		ui_sync_mutex;
+	pthread_cond_t		ui_sync_cond;
 	guint			ui_handler;
 
+	/* Damage accumulator. The libfreerdp thread unions invalid rectangles
+	 * into damage, the main thread swaps it out and submits it with a
+	 * single gtk_widget_queue_draw_region(), then returns the emptied
+	 * region through damage_free. */
+	cairo_region_t *	damage;
+	cairo_region_t *	damage_free;
+	cairo_region_t *	damage_scaled;
+	gint			damage_pending;
+
 	GArray *		pressed_keys;
-	GAsyncQueue *		event_queue;
-	gint			event_pipe[2];
+	/* Input events from the main thread to the libfreerdp thread */
+	RemminaRdpRing		event_ring;
+	GQueue *		event_overflow;
+	gint			event_overflow_len;     /* Read by the consumer without event_ring_mutex */
+	pthread_mutex_t		event_ring_mutex;       /* Serializes the producers and the overflow queue */
+	gint			motion_events_merged;
 	HANDLE			event_handle;
 
 	rfClipboard		clipboard;
@@ -365,3 +381,4 @@ BOOL rf_check_fds(RemminaProtocolWidget *gp);
 void rf_object_free(RemminaProtocolWidget *gp, RemminaPluginRdpUiObject *obj);
 
 void remmina_rdp_event_event_push(RemminaProtocolWidget *gp, const RemminaPluginRdpEvent *e);
+gboolean remmina_rdp_event_event_pop(RemminaProtocolWidget *gp, RemminaPluginRdpEvent *event);
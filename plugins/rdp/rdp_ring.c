@@ -0,0 +1,159 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "common/remmina_plugin.h"
+#include "rdp_ring.h"
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+gboolean remmina_rdp_ring_init(RemminaRdpRing *ring, guint capacity, gsize slot_size)
+{
+	TRACE_CALL(__func__);
+	gint flags, i;
+
+	g_return_val_if_fail(capacity > 0 && (capacity & (capacity - 1)) == 0, FALSE);
+
+	ring->slots = g_malloc0(capacity * slot_size);
+	ring->slot_size = slot_size;
+	ring->capacity = capacity;
+	ring->head = 0;
+	ring->tail = 0;
+
+#if defined(__linux__)
+	ring->doorbell[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	ring->doorbell[1] = ring->doorbell[0];
+	if (ring->doorbell[0] >= 0)
+		return TRUE;
+#endif
+	/* No eventfd available, fall back to a pipe */
+	if (pipe(ring->doorbell)) {
+		g_print("Error creating ring doorbell pipe.\n");
+		ring->doorbell[0] = -1;
+		ring->doorbell[1] = -1;
+		g_free(ring->slots);
+		ring->slots = NULL;
+		return FALSE;
+	}
+	for (i = 0; i < 2; i++) {
+		flags = fcntl(ring->doorbell[i], F_GETFL, 0);
+		fcntl(ring->doorbell[i], F_SETFL, flags | O_NONBLOCK);
+	}
+
+	return TRUE;
+}
+
+void remmina_rdp_ring_destroy(RemminaRdpRing *ring)
+{
+	TRACE_CALL(__func__);
+
+	if (ring->doorbell[0] >= 0)
+		close(ring->doorbell[0]);
+	if (ring->doorbell[1] >= 0 && ring->doorbell[1] != ring->doorbell[0])
+		close(ring->doorbell[1]);
+	ring->doorbell[0] = -1;
+	ring->doorbell[1] = -1;
+
+	g_free(ring->slots);
+	ring->slots = NULL;
+}
+
+gint remmina_rdp_ring_get_doorbell_fd(RemminaRdpRing *ring)
+{
+	return ring->doorbell[0];
+}
+
+gpointer remmina_rdp_ring_reserve(RemminaRdpRing *ring)
+{
+	guint head;
+
+	/* Producer side: returns the slot to fill, or NULL when the ring is full */
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	if (ring->tail - head >= ring->capacity)
+		return NULL;
+
+	return ring->slots + (ring->tail & (ring->capacity - 1)) * ring->slot_size;
+}
+
+void remmina_rdp_ring_commit(RemminaRdpRing *ring)
+{
+	guint tail = ring->tail;
+
+	/* Producer side: publish the slot returned by remmina_rdp_ring_reserve().
+	 * Both the store of tail and the load of head are sequentially consistent,
+	 * pairing with remmina_rdp_ring_release(), so either the consumer sees
+	 * the new slot or we see an empty ring and ring the doorbell. */
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == tail)
+		remmina_rdp_ring_ring_doorbell(ring);
+}
+
+gpointer remmina_rdp_ring_peek(RemminaRdpRing *ring)
+{
+	guint tail;
+
+	/* Consumer side: returns the oldest committed slot, or NULL when empty */
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+	if (ring->head == tail)
+		return NULL;
+
+	return ring->slots + (ring->head & (ring->capacity - 1)) * ring->slot_size;
+}
+
+void remmina_rdp_ring_release(RemminaRdpRing *ring)
+{
+	/* Consumer side: give back the slot returned by remmina_rdp_ring_peek() */
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_SEQ_CST);
+}
+
+void remmina_rdp_ring_clear_doorbell(RemminaRdpRing *ring)
+{
+	guint64 buf[8];
+
+	if (ring->doorbell[0] < 0)
+		return;
+	while (read(ring->doorbell[0], buf, sizeof(buf)) > 0) {
+	}
+}
+
+void remmina_rdp_ring_ring_doorbell(RemminaRdpRing *ring)
+{
+	guint64 one = 1;
+
+	if (ring->doorbell[1] < 0)
+		return;
+	/* eventfd requires an 8 bytes write, a pipe takes anything */
+	if (write(ring->doorbell[1], &one, sizeof(one))) {
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Fixed capacity single-producer/single-consumer ring buffer of preallocated
+ * slots. Indexes are free running and only masked when a slot is accessed,
+ * so the capacity must be a power of two.
+ *
+ * The doorbell is a file descriptor (an eventfd on Linux) which becomes
+ * readable only when the producer commits into an empty ring. The consumer
+ * must call remmina_rdp_ring_clear_doorbell() before draining the ring.
+ *
+ * Committed slots are published with release/acquire ordering on the
+ * indexes, so neither side takes a lock. With several producer threads,
+ * the caller must serialize reserve/commit between them.
+ */
+typedef struct remmina_rdp_ring {
+	guint8 *	slots;
+	gsize		slot_size;
+	guint		capacity;
+	guint		head;   /* Next slot to be consumed, written by the consumer only */
+	guint		tail;   /* Next slot to be produced, written by the producer only */
+	gint		doorbell[2];
+} RemminaRdpRing;
+
+gboolean remmina_rdp_ring_init(RemminaRdpRing *ring, guint capacity, gsize slot_size);
+void remmina_rdp_ring_destroy(RemminaRdpRing *ring);
+gint remmina_rdp_ring_get_doorbell_fd(RemminaRdpRing *ring);
+
+gpointer remmina_rdp_ring_reserve(RemminaRdpRing *ring);
+void remmina_rdp_ring_commit(RemminaRdpRing *ring);
+
+gpointer remmina_rdp_ring_peek(RemminaRdpRing *ring);
+void remmina_rdp_ring_release(RemminaRdpRing *ring);
+void remmina_rdp_ring_clear_doorbell(RemminaRdpRing *ring);
+void remmina_rdp_ring_ring_doorbell(RemminaRdpRing *ring);
+
+G_END_DECLS
@@ -138,6 +138,53 @@ remmina_plugin_glibsecret_get_password(RemminaFile *remminafile, const gchar *ke
 	}
 }
 
+gboolean
+remmina_plugin_glibsecret_get_passwords(RemminaFile *remminafile, GHashTable *passwords)
+{
+	TRACE_CALL(__func__);
+#ifdef LIBSECRET_VERSION_0_18
+	GError *r = NULL;
+	const gchar *path;
+	GHashTable *attributes, *item_attributes;
+	GList *items, *l;
+	SecretValue *value;
+	const gchar *key, *text;
+
+	if (!secretservice)
+		return FALSE;
+
+	/* One search returns every key stored for the profile, with the secrets loaded */
+	path = remmina_plugin_service->file_get_path(remminafile);
+	attributes = secret_attributes_build(&remmina_file_secret_schema, "filename", path, NULL);
+	items = secret_service_search_sync(secretservice, &remmina_file_secret_schema, attributes,
+		SECRET_SEARCH_ALL | SECRET_SEARCH_UNLOCK | SECRET_SEARCH_LOAD_SECRETS, NULL, &r);
+	g_hash_table_unref(attributes);
+	if (r != NULL) {
+		REMMINA_PLUGIN_DEBUG("Passwords cannot be searched for file %s: %s\n", path, r->message);
+		g_error_free(r);
+		return FALSE;
+	}
+
+	for (l = items; l; l = l->next) {
+		item_attributes = secret_item_get_attributes(SECRET_ITEM(l->data));
+		key = g_hash_table_lookup(item_attributes, "key");
+		value = secret_item_get_secret(SECRET_ITEM(l->data));
+		if (key && value) {
+			text = secret_value_get_text(value);
+			if (text)
+				g_hash_table_insert(passwords, g_strdup(key), g_strdup(text));
+		}
+		if (value)
+			secret_value_unref(value);
+		g_hash_table_unref(item_attributes);
+	}
+	g_list_free_full(items, g_object_unref);
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
 void remmina_plugin_glibsecret_delete_password(RemminaFile *remminafile, const gchar *key)
 {
 	TRACE_CALL(__func__);
@@ -193,7 +240,8 @@ static RemminaSecretPlugin remmina_plugin_glibsecret =
   remmina_plugin_glibsecret_is_service_available,
   remmina_plugin_glibsecret_store_password,
   remmina_plugin_glibsecret_get_password,
-  remmina_plugin_glibsecret_delete_password
+  remmina_plugin_glibsecret_delete_password,
+  remmina_plugin_glibsecret_get_passwords
 };
 
 G_MODULE_EXPORT gboolean
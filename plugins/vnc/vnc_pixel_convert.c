@@ -0,0 +1,399 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#include "common/remmina_plugin.h"
+#include "vnc_pixel_convert.h"
+
+/* SIMD kernels are only built when enabled with the WITH_SSE2 and WITH_NEON
+ * build options */
+#if defined(WITH_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VNC_PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(WITH_NEON) && defined(__ARM_NEON) && G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define VNC_PIXEL_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+static gint remmina_plugin_vnc_pixel_bits(gint n)
+{
+	gint b = 0;
+
+	while (n) {
+		b++;
+		n >>= 1;
+	}
+	return b ? b : 1;
+}
+
+static inline guchar remmina_plugin_vnc_pixel_expand(const RemminaPluginVncPixelConverter *conv, gint ch, guint32 src_pixel)
+{
+	guchar c;
+	gint r;
+
+	/* Scale the channel up to 8 bits, replicating the most significant bits */
+	c = (guchar)(((src_pixel >> conv->shift[ch]) & conv->max[ch]) << (8 - conv->bits[ch]));
+	for (r = conv->bits[ch]; r < 8; r *= 2)
+		c |= c >> r;
+	return c;
+}
+
+static inline guint32 remmina_plugin_vnc_pixel_to_argb(const RemminaPluginVncPixelConverter *conv, guint32 src_pixel)
+{
+	return 0xff000000 |
+	       (remmina_plugin_vnc_pixel_expand(conv, 0, src_pixel) << 16) |
+	       (remmina_plugin_vnc_pixel_expand(conv, 1, src_pixel) << 8) |
+	       remmina_plugin_vnc_pixel_expand(conv, 2, src_pixel);
+}
+
+static void remmina_plugin_vnc_pixel_row_generic(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint bytesPerPixel = conv->format.bitsPerPixel / 8;
+	guint32 src_pixel;
+	gint ix, i;
+
+	for (ix = 0; ix < w; ix++) {
+		src_pixel = 0;
+		for (i = 0; i < bytesPerPixel; i++)
+			src_pixel += (*src++) << (8 * i);
+		*dest++ = remmina_plugin_vnc_pixel_to_argb(conv, src_pixel);
+	}
+}
+
+static void remmina_plugin_vnc_pixel_row8_lut(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	for (ix = 0; ix < w; ix++)
+		dest[ix] = conv->lut[src[ix]];
+}
+
+static void remmina_plugin_vnc_pixel_row32_scalar(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	gint ix;
+
+	/* Fill in the alpha channel and swap red/blue, the server sends BGRX */
+	for (ix = 0; ix < w; ix++) {
+		dest[ix] = 0xff000000 | (src[2] << 16) | (src[1] << 8) | src[0];
+		src += 4;
+	}
+}
+
+#ifdef VNC_PIXEL_CONVERT_X86
+
+__attribute__((target("sse2")))
+static void remmina_plugin_vnc_pixel_row32_sse2(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	gint ix;
+
+	/* On little endian BGRX is already ARGB once alpha is set */
+	for (ix = 0; ix + 4 <= w; ix += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + ix * 4));
+		_mm_storeu_si128((__m128i *)(dest + ix), _mm_or_si128(v, alpha));
+	}
+	remmina_plugin_vnc_pixel_row32_scalar(conv, dest + ix, src + ix * 4, w - ix);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i remmina_plugin_vnc_pixel_expand_sse2(const RemminaPluginVncPixelConverter *conv, gint ch, __m128i v)
+{
+	const __m128i lowbyte = _mm_set1_epi16(0xff);
+	__m128i c;
+	gint r;
+
+	c = _mm_and_si128(_mm_srl_epi16(v, _mm_cvtsi32_si128(conv->shift[ch])), _mm_set1_epi16(conv->max[ch]));
+	c = _mm_and_si128(_mm_sll_epi16(c, _mm_cvtsi32_si128(8 - conv->bits[ch])), lowbyte);
+	for (r = conv->bits[ch]; r < 8; r *= 2)
+		c = _mm_or_si128(c, _mm_srl_epi16(c, _mm_cvtsi32_si128(r)));
+	return c;
+}
+
+__attribute__((target("sse2")))
+static void remmina_plugin_vnc_pixel_row16_sse2(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	const __m128i alpha = _mm_set1_epi16((short)0xff00);
+	__m128i v, r, g, b, lo, hi;
+	gint ix;
+
+	for (ix = 0; ix + 8 <= w; ix += 8) {
+		v = _mm_loadu_si128((const __m128i *)(src + ix * 2));
+		r = remmina_plugin_vnc_pixel_expand_sse2(conv, 0, v);
+		g = remmina_plugin_vnc_pixel_expand_sse2(conv, 1, v);
+		b = remmina_plugin_vnc_pixel_expand_sse2(conv, 2, v);
+		/* Low half is GB, high half is AR: interleave them into ARGB */
+		lo = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+		hi = _mm_or_si128(alpha, r);
+		_mm_storeu_si128((__m128i *)(dest + ix), _mm_unpacklo_epi16(lo, hi));
+		_mm_storeu_si128((__m128i *)(dest + ix + 4), _mm_unpackhi_epi16(lo, hi));
+	}
+	remmina_plugin_vnc_pixel_row_generic(conv, dest + ix, src + ix * 2, w - ix);
+}
+
+__attribute__((target("avx2")))
+static void remmina_plugin_vnc_pixel_row32_avx2(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+	gint ix;
+
+	for (ix = 0; ix + 8 <= w; ix += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(src + ix * 4));
+		_mm256_storeu_si256((__m256i *)(dest + ix), _mm256_or_si256(v, alpha));
+	}
+	remmina_plugin_vnc_pixel_row32_scalar(conv, dest + ix, src + ix * 4, w - ix);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i remmina_plugin_vnc_pixel_expand_avx2(const RemminaPluginVncPixelConverter *conv, gint ch, __m256i v)
+{
+	const __m256i lowbyte = _mm256_set1_epi16(0xff);
+	__m256i c;
+	gint r;
+
+	c = _mm256_and_si256(_mm256_srl_epi16(v, _mm_cvtsi32_si128(conv->shift[ch])), _mm256_set1_epi16(conv->max[ch]));
+	c = _mm256_and_si256(_mm256_sll_epi16(c, _mm_cvtsi32_si128(8 - conv->bits[ch])), lowbyte);
+	for (r = conv->bits[ch]; r < 8; r *= 2)
+		c = _mm256_or_si256(c, _mm256_srl_epi16(c, _mm_cvtsi32_si128(r)));
+	return c;
+}
+
+__attribute__((target("avx2")))
+static void remmina_plugin_vnc_pixel_row16_avx2(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	const __m256i alpha = _mm256_set1_epi16((short)0xff00);
+	__m256i v, r, g, b, lo, hi;
+	gint ix;
+
+	for (ix = 0; ix + 16 <= w; ix += 16) {
+		v = _mm256_loadu_si256((const __m256i *)(src + ix * 2));
+		r = remmina_plugin_vnc_pixel_expand_avx2(conv, 0, v);
+		g = remmina_plugin_vnc_pixel_expand_avx2(conv, 1, v);
+		b = remmina_plugin_vnc_pixel_expand_avx2(conv, 2, v);
+		/* Unpack works inside 128 bit lanes, reorder the quadwords first
+		 * so the two stores get pixels 0-7 and 8-15 */
+		lo = _mm256_permute4x64_epi64(_mm256_or_si256(_mm256_slli_epi16(g, 8), b), 0xd8);
+		hi = _mm256_permute4x64_epi64(_mm256_or_si256(alpha, r), 0xd8);
+		_mm256_storeu_si256((__m256i *)(dest + ix), _mm256_unpacklo_epi16(lo, hi));
+		_mm256_storeu_si256((__m256i *)(dest + ix + 8), _mm256_unpackhi_epi16(lo, hi));
+	}
+	remmina_plugin_vnc_pixel_row16_sse2(conv, dest + ix, src + ix * 2, w - ix);
+}
+
+#endif /* VNC_PIXEL_CONVERT_X86 */
+
+#ifdef VNC_PIXEL_CONVERT_NEON
+
+static void remmina_plugin_vnc_pixel_row32_neon(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	const uint32x4_t alpha = vdupq_n_u32(0xff000000);
+	gint ix;
+
+	for (ix = 0; ix + 4 <= w; ix += 4)
+		vst1q_u32(dest + ix, vorrq_u32(vld1q_u32((const uint32_t *)(src + ix * 4)), alpha));
+	remmina_plugin_vnc_pixel_row32_scalar(conv, dest + ix, src + ix * 4, w - ix);
+}
+
+static inline uint16x8_t remmina_plugin_vnc_pixel_expand_neon(const RemminaPluginVncPixelConverter *conv, gint ch, uint16x8_t v)
+{
+	uint16x8_t c;
+	gint r;
+
+	c = vandq_u16(vshlq_u16(v, vdupq_n_s16(-conv->shift[ch])), vdupq_n_u16(conv->max[ch]));
+	c = vandq_u16(vshlq_u16(c, vdupq_n_s16(8 - conv->bits[ch])), vdupq_n_u16(0xff));
+	for (r = conv->bits[ch]; r < 8; r *= 2)
+		c = vorrq_u16(c, vshlq_u16(c, vdupq_n_s16(-r)));
+	return c;
+}
+
+static void remmina_plugin_vnc_pixel_row16_neon(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w)
+{
+	const uint16x8_t alpha = vdupq_n_u16(0xff00);
+	uint16x8_t v, r, g, b;
+	uint16x8x2_t argb;
+	gint ix;
+
+	for (ix = 0; ix + 8 <= w; ix += 8) {
+		v = vld1q_u16((const uint16_t *)(src + ix * 2));
+		r = remmina_plugin_vnc_pixel_expand_neon(conv, 0, v);
+		g = remmina_plugin_vnc_pixel_expand_neon(conv, 1, v);
+		b = remmina_plugin_vnc_pixel_expand_neon(conv, 2, v);
+		argb.val[0] = vorrq_u16(vshlq_n_u16(g, 8), b);
+		argb.val[1] = vorrq_u16(alpha, r);
+		vst2q_u16((uint16_t *)(dest + ix), argb);
+	}
+	remmina_plugin_vnc_pixel_row_generic(conv, dest + ix, src + ix * 2, w - ix);
+}
+
+#endif /* VNC_PIXEL_CONVERT_NEON */
+
+typedef struct {
+	const gchar *			name;
+	/* 0 for any number of bits per pixel */
+	gint				bits_per_pixel;
+	RemminaPluginVncPixelRowFunc	convert_row;
+	gboolean			(*cpu_supports)(void);
+} RemminaPluginVncPixelKernel;
+
+#ifdef VNC_PIXEL_CONVERT_X86
+static gboolean remmina_plugin_vnc_pixel_cpu_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+static gboolean remmina_plugin_vnc_pixel_cpu_sse2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+}
+#endif
+
+/* In order of preference */
+static const RemminaPluginVncPixelKernel remmina_plugin_vnc_pixel_kernels[] = {
+#ifdef VNC_PIXEL_CONVERT_X86
+	{ "avx2", 32, remmina_plugin_vnc_pixel_row32_avx2, remmina_plugin_vnc_pixel_cpu_avx2 },
+	{ "sse2", 32, remmina_plugin_vnc_pixel_row32_sse2, remmina_plugin_vnc_pixel_cpu_sse2 },
+	{ "avx2", 16, remmina_plugin_vnc_pixel_row16_avx2, remmina_plugin_vnc_pixel_cpu_avx2 },
+	{ "sse2", 16, remmina_plugin_vnc_pixel_row16_sse2, remmina_plugin_vnc_pixel_cpu_sse2 },
+#endif
+#ifdef VNC_PIXEL_CONVERT_NEON
+	{ "neon", 32, remmina_plugin_vnc_pixel_row32_neon, NULL },
+	{ "neon", 16, remmina_plugin_vnc_pixel_row16_neon, NULL },
+#endif
+	{ "scalar", 32, remmina_plugin_vnc_pixel_row32_scalar, NULL },
+	{ "lut", 8, remmina_plugin_vnc_pixel_row8_lut, NULL },
+	{ "generic", 0, remmina_plugin_vnc_pixel_row_generic, NULL },
+};
+
+static gboolean remmina_plugin_vnc_pixel_kernel_usable(const RemminaPluginVncPixelConverter *conv, const RemminaPluginVncPixelKernel *kernel)
+{
+	gint i;
+
+	if (kernel->bits_per_pixel != 0 && kernel->bits_per_pixel != conv->format.bitsPerPixel)
+		return FALSE;
+	/* The 16bpp SIMD kernels work on little endian 16 bit lanes, with
+	 * channels of 8 bits at most */
+	if (kernel->bits_per_pixel == 16) {
+		if (G_BYTE_ORDER != G_LITTLE_ENDIAN)
+			return FALSE;
+		for (i = 0; i < 3; i++)
+			if (conv->bits[i] > 8)
+				return FALSE;
+	}
+	return kernel->cpu_supports == NULL || kernel->cpu_supports();
+}
+
+/* Prepare the converter for format with the named row kernel, or with the
+ * best one available when kernel is NULL. Returns FALSE when the kernel
+ * was not built, is not supported by the CPU or does not handle format.
+ * Naming the kernel is meant to check and benchmark the kernels */
+gboolean remmina_plugin_vnc_pixel_converter_prepare_kernel(RemminaPluginVncPixelConverter *conv, const rfbPixelFormat *format,
+							   const gchar *kernel)
+{
+	TRACE_CALL(__func__);
+	guint i;
+
+	conv->format = *format;
+	conv->prepared = TRUE;
+
+	conv->shift[0] = format->redShift;
+	conv->shift[1] = format->greenShift;
+	conv->shift[2] = format->blueShift;
+	conv->max[0] = format->redMax;
+	conv->max[1] = format->greenMax;
+	conv->max[2] = format->blueMax;
+	for (i = 0; i < 3; i++)
+		conv->bits[i] = remmina_plugin_vnc_pixel_bits(conv->max[i]);
+
+	if (format->bitsPerPixel == 8)
+		for (i = 0; i < 256; i++)
+			conv->lut[i] = remmina_plugin_vnc_pixel_to_argb(conv, i);
+
+	conv->convert_row = remmina_plugin_vnc_pixel_row_generic;
+	conv->kernel_name = "generic";
+
+	for (i = 0; i < G_N_ELEMENTS(remmina_plugin_vnc_pixel_kernels); i++) {
+		if (kernel && strcmp(kernel, remmina_plugin_vnc_pixel_kernels[i].name) != 0)
+			continue;
+		if (!remmina_plugin_vnc_pixel_kernel_usable(conv, &remmina_plugin_vnc_pixel_kernels[i]))
+			continue;
+		conv->convert_row = remmina_plugin_vnc_pixel_kernels[i].convert_row;
+		conv->kernel_name = remmina_plugin_vnc_pixel_kernels[i].name;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+void remmina_plugin_vnc_pixel_converter_prepare(RemminaPluginVncPixelConverter *conv, const rfbPixelFormat *format)
+{
+	TRACE_CALL(__func__);
+
+	if (conv->prepared && memcmp(&conv->format, format, sizeof(rfbPixelFormat)) == 0)
+		return;
+
+	remmina_plugin_vnc_pixel_converter_prepare_kernel(conv, format, NULL);
+}
+
+void remmina_plugin_vnc_pixel_converter_convert(const RemminaPluginVncPixelConverter *conv, guchar *dest, gint dest_rowstride,
+						const guchar *src, gint src_rowstride, const guchar *mask, gint w, gint h)
+{
+	TRACE_CALL(__func__);
+	guint32 *destptr;
+	gint ix, iy;
+
+	for (iy = 0; iy < h; iy++) {
+		destptr = (guint32 *)(dest + iy * dest_rowstride);
+		conv->convert_row(conv, destptr, src + iy * src_rowstride, w);
+		if (mask) {
+			/* Masked out pixels are fully transparent */
+			for (ix = 0; ix < w; ix++)
+				if (!*mask++)
+					destptr[ix] = 0;
+		}
+	}
+}
+
+gboolean remmina_plugin_vnc_pixel_format_is_native(const rfbPixelFormat *format)
+{
+	TRACE_CALL(__func__);
+
+	/* A cairo RGB24 pixel is a native endian 32 bit word laid out as xRGB */
+	return format->bitsPerPixel == 32 &&
+	       format->trueColour &&
+	       (format->bigEndian ? G_BYTE_ORDER == G_BIG_ENDIAN : G_BYTE_ORDER == G_LITTLE_ENDIAN) &&
+	       format->redShift == 16 && format->greenShift == 8 && format->blueShift == 0 &&
+	       format->redMax == 0xff && format->greenMax == 0xff && format->blueMax == 0xff;
+}
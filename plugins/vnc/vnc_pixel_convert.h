@@ -0,0 +1,75 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <rfb/rfbclient.h>
+
+G_BEGIN_DECLS
+
+typedef struct _RemminaPluginVncPixelConverter RemminaPluginVncPixelConverter;
+
+typedef void (*RemminaPluginVncPixelRowFunc)(const RemminaPluginVncPixelConverter *conv, guint32 *dest, const guchar *src, gint w);
+
+/**
+ * Converts rectangles from the negotiated rfbPixelFormat to cairo
+ * CAIRO_FORMAT_ARGB32. The row kernel (scalar, SSE2, AVX2 or NEON) is
+ * selected at runtime according to the pixel format and the CPU.
+ */
+struct _RemminaPluginVncPixelConverter {
+	rfbPixelFormat			format;
+	gboolean			prepared;
+	RemminaPluginVncPixelRowFunc	convert_row;
+	const gchar *			kernel_name;
+
+	/* Per channel (red, green, blue) parameters */
+	gint				shift[3];
+	gint				max[3];
+	gint				bits[3];
+
+	/* Lookup table used for 8bpp formats */
+	guint32				lut[256];
+};
+
+void remmina_plugin_vnc_pixel_converter_prepare(RemminaPluginVncPixelConverter *conv, const rfbPixelFormat *format);
+gboolean remmina_plugin_vnc_pixel_converter_prepare_kernel(RemminaPluginVncPixelConverter *conv, const rfbPixelFormat *format,
+							   const gchar *kernel);
+void remmina_plugin_vnc_pixel_converter_convert(const RemminaPluginVncPixelConverter *conv, guchar *dest, gint dest_rowstride,
+						const guchar *src, gint src_rowstride, const guchar *mask, gint w, gint h);
+
+/* TRUE when the framebuffer can be copied to a CAIRO_FORMAT_RGB24 surface as is */
+gboolean remmina_plugin_vnc_pixel_format_is_native(const rfbPixelFormat *format);
+
+G_END_DECLS
@@ -48,6 +48,10 @@
 #define REMMINA_PLUGIN_VNC_FEATURE_UNFOCUS                 7
 #define REMMINA_PLUGIN_VNC_FEATURE_TOOL_SENDCTRLALTDEL     8
 
+/* Above this number of damaged rectangles the pending redraw collapses to
+ * their bounding box, to keep region operations cheap */
+#define REMMINA_PLUGIN_VNC_DAMAGE_MAX_RECTS 32
+
 #define GET_PLUGIN_DATA(gp) (RemminaPluginVncData *)g_object_get_data(G_OBJECT(gp), "plugin-data")
 
 static RemminaPluginService *remmina_plugin_service = NULL;
@@ -473,7 +477,7 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 	RemminaProtocolWidget *gp = rfbClientGetClientData(cl, NULL);
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	gint width, height, depth, size;
-	gboolean scale;
+	gboolean scale, native;
 	cairo_surface_t *new_surface, *old_surface;
 
 	width = cl->width;
@@ -481,7 +485,10 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 	depth = cl->format.bitsPerPixel;
 	size = width * height * (depth / 8);
 
-	new_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	/* When the server pixel format already matches cairo, updates are
+	 * copied to an RGB24 surface as they are, without any conversion */
+	native = remmina_plugin_vnc_pixel_format_is_native(&cl->format);
+	new_surface = cairo_image_surface_create(native ? CAIRO_FORMAT_RGB24 : CAIRO_FORMAT_ARGB32, width, height);
 	if (cairo_surface_status(new_surface) != CAIRO_STATUS_SUCCESS)
 		return FALSE;
 	old_surface = gpdata->rgb_buffer;
@@ -498,8 +505,15 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 	gpdata->vnc_buffer = (guchar *)g_malloc(size);
 	cl->frameBuffer = gpdata->vnc_buffer;
 
+	remmina_plugin_vnc_pixel_converter_prepare(&gpdata->pixel_converter, &cl->format);
+
 	UNLOCK_BUFFER(TRUE);
 
+	if (native)
+		REMMINA_PLUGIN_DEBUG("VNC framebuffer is in cairo format, no pixel format conversion");
+	else
+		REMMINA_PLUGIN_DEBUG("Pixel format conversion kernel: %s", gpdata->pixel_converter.kernel_name);
+
 	if (old_surface)
 		cairo_surface_destroy(old_surface);
 
@@ -516,34 +530,23 @@ static rfbBool remmina_plugin_vnc_rfb_allocfb(rfbClient *cl)
 	return TRUE;
 }
 
-static gint remmina_plugin_vnc_bits(gint n)
-{
-	TRACE_CALL(__func__);
-	gint b = 0;
-
-	while (n) {
-		b++;
-		n >>= 1;
-	}
-	return b ? b : 1;
-}
-
 static gboolean remmina_plugin_vnc_queue_draw_area_real(RemminaProtocolWidget *gp)
 {
 	TRACE_CALL(__func__);
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
-	gint x, y, w, h;
+	cairo_region_t *region;
 
 	if (GTK_IS_WIDGET(gp) && gpdata->connected) {
 		LOCK_BUFFER(FALSE);
-		x = gpdata->queuedraw_x;
-		y = gpdata->queuedraw_y;
-		w = gpdata->queuedraw_w;
-		h = gpdata->queuedraw_h;
+		region = gpdata->queuedraw_region;
+		gpdata->queuedraw_region = NULL;
 		gpdata->queuedraw_handler = 0;
 		UNLOCK_BUFFER(FALSE);
 
-		gtk_widget_queue_draw_area(GTK_WIDGET(gp), x, y, w, h);
+		if (region) {
+			gtk_widget_queue_draw_region(GTK_WIDGET(gp), region);
+			cairo_region_destroy(region);
+		}
 	}
 	return FALSE;
 }
@@ -552,25 +555,19 @@ static void remmina_plugin_vnc_queue_draw_area(RemminaProtocolWidget *gp, gint x
 {
 	TRACE_CALL(__func__);
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
-	gint nx2, ny2, ox2, oy2;
+	cairo_rectangle_int_t rect = { x, y, w, h };
 
 	LOCK_BUFFER(TRUE);
-	if (gpdata->queuedraw_handler) {
-		nx2 = x + w;
-		ny2 = y + h;
-		ox2 = gpdata->queuedraw_x + gpdata->queuedraw_w;
-		oy2 = gpdata->queuedraw_y + gpdata->queuedraw_h;
-		gpdata->queuedraw_x = MIN(gpdata->queuedraw_x, x);
-		gpdata->queuedraw_y = MIN(gpdata->queuedraw_y, y);
-		gpdata->queuedraw_w = MAX(ox2, nx2) - gpdata->queuedraw_x;
-		gpdata->queuedraw_h = MAX(oy2, ny2) - gpdata->queuedraw_y;
-	} else {
-		gpdata->queuedraw_x = x;
-		gpdata->queuedraw_y = y;
-		gpdata->queuedraw_w = w;
-		gpdata->queuedraw_h = h;
-		gpdata->queuedraw_handler = IDLE_ADD((GSourceFunc)remmina_plugin_vnc_queue_draw_area_real, gp);
+	if (gpdata->queuedraw_region == NULL)
+		gpdata->queuedraw_region = cairo_region_create();
+	cairo_region_union_rectangle(gpdata->queuedraw_region, &rect);
+	if (cairo_region_num_rectangles(gpdata->queuedraw_region) > REMMINA_PLUGIN_VNC_DAMAGE_MAX_RECTS) {
+		cairo_region_get_extents(gpdata->queuedraw_region, &rect);
+		cairo_region_destroy(gpdata->queuedraw_region);
+		gpdata->queuedraw_region = cairo_region_create_rectangle(&rect);
 	}
+	if (!gpdata->queuedraw_handler)
+		gpdata->queuedraw_handler = IDLE_ADD((GSourceFunc)remmina_plugin_vnc_queue_draw_area_real, gp);
 	UNLOCK_BUFFER(TRUE);
 }
 
@@ -578,87 +575,13 @@ static void remmina_plugin_vnc_rfb_fill_buffer(rfbClient *cl, guchar *dest, gint
 					       gint src_rowstride, guchar *mask, gint w, gint h)
 {
 	TRACE_CALL(__func__);
-	guchar *srcptr;
-	gint bytesPerPixel;
-	guint32 src_pixel;
-	gint ix, iy;
-	gint i;
-	guchar c;
-	gint rs, gs, bs, rm, gm, bm, rl, gl, bl, rr, gr, br;
-	gint r;
-	guint32 *destptr;
-
-	union {
-		struct {
-			guchar a, r, g, b;
-		} colors;
-		guint32 argb;
-	} dst_pixel;
-
-	bytesPerPixel = cl->format.bitsPerPixel / 8;
-	switch (cl->format.bitsPerPixel) {
-	case 32:
-		/* The following codes fill in the Alpha channel swap red/green value */
-		for (iy = 0; iy < h; iy++) {
-			destptr = (guint32 *)(dest + iy * dest_rowstride);
-			srcptr = src + iy * src_rowstride;
-			for (ix = 0; ix < w; ix++) {
-				if (!mask || *mask++) {
-					dst_pixel.colors.a = 0xff;
-					dst_pixel.colors.r = *(srcptr + 2);
-					dst_pixel.colors.g = *(srcptr + 1);
-					dst_pixel.colors.b = *srcptr;
-					*destptr++ = ntohl(dst_pixel.argb);
-				} else {
-					*destptr++ = 0;
-				}
-				srcptr += 4;
-			}
-		}
-		break;
-	default:
-		rm = cl->format.redMax;
-		gm = cl->format.greenMax;
-		bm = cl->format.blueMax;
-		rr = remmina_plugin_vnc_bits(rm);
-		gr = remmina_plugin_vnc_bits(gm);
-		br = remmina_plugin_vnc_bits(bm);
-		rl = 8 - rr;
-		gl = 8 - gr;
-		bl = 8 - br;
-		rs = cl->format.redShift;
-		gs = cl->format.greenShift;
-		bs = cl->format.blueShift;
-		for (iy = 0; iy < h; iy++) {
-			destptr = (guint32 *)(dest + iy * dest_rowstride);
-			srcptr = src + iy * src_rowstride;
-			for (ix = 0; ix < w; ix++) {
-				src_pixel = 0;
-				for (i = 0; i < bytesPerPixel; i++)
-					src_pixel += (*srcptr++) << (8 * i);
-
-				if (!mask || *mask++) {
-					dst_pixel.colors.a = 0xff;
-					c = (guchar)((src_pixel >> rs) & rm) << rl;
-					for (r = rr; r < 8; r *= 2)
-						c |= c >> r;
-					dst_pixel.colors.r = c;
-					c = (guchar)((src_pixel >> gs) & gm) << gl;
-					for (r = gr; r < 8; r *= 2)
-						c |= c >> r;
-					dst_pixel.colors.g = c;
-					c = (guchar)((src_pixel >> bs) & bm) << bl;
-					for (r = br; r < 8; r *= 2)
-						c |= c >> r;
-					dst_pixel.colors.b = c;
-					*destptr++ = ntohl(dst_pixel.argb);
-				} else {
-					*destptr++ = 0;
-				}
-			}
-		}
-		break;
-	}
+	RemminaProtocolWidget *gp = rfbClientGetClientData(cl, NULL);
+	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
+
+	/* Cheap when the pixel format did not change since the last call */
+	remmina_plugin_vnc_pixel_converter_prepare(&gpdata->pixel_converter, &cl->format);
+	remmina_plugin_vnc_pixel_converter_convert(&gpdata->pixel_converter, dest, dest_rowstride,
+						   src, src_rowstride, mask, w, h);
 }
 
 static void remmina_plugin_vnc_rfb_updatefb(rfbClient *cl, int x, int y, int w, int h)
@@ -669,6 +592,8 @@ static void remmina_plugin_vnc_rfb_updatefb(rfbClient *cl, int x, int y, int w,
 	gint bytesPerPixel;
 	gint rowstride;
 	gint width;
+	guchar *dest, *src;
+	gint iy;
 
 	LOCK_BUFFER(TRUE);
 
@@ -676,11 +601,20 @@ static void remmina_plugin_vnc_rfb_updatefb(rfbClient *cl, int x, int y, int w,
 		width = remmina_plugin_service->protocol_plugin_get_width(gp);
 		bytesPerPixel = cl->format.bitsPerPixel / 8;
 		rowstride = cairo_image_surface_get_stride(gpdata->rgb_buffer);
+		dest = cairo_image_surface_get_data(gpdata->rgb_buffer) + y * rowstride + x * 4;
+		src = gpdata->vnc_buffer + ((y * width + x) * bytesPerPixel);
+
+		/* libvncclient decodes into vnc_buffer without holding buffer_mutex,
+		 * the surface drawn by GTK is only written here, under the lock */
 		cairo_surface_flush(gpdata->rgb_buffer);
-		remmina_plugin_vnc_rfb_fill_buffer(cl, cairo_image_surface_get_data(gpdata->rgb_buffer) + y * rowstride + x * 4,
-						   rowstride, gpdata->vnc_buffer + ((y * width + x) * bytesPerPixel), width * bytesPerPixel, NULL,
-						   w, h);
-		cairo_surface_mark_dirty(gpdata->rgb_buffer);
+		if (cairo_image_surface_get_format(gpdata->rgb_buffer) == CAIRO_FORMAT_RGB24 &&
+		    remmina_plugin_vnc_pixel_format_is_native(&cl->format)) {
+			for (iy = 0; iy < h; iy++)
+				memcpy(dest + iy * rowstride, src + iy * width * 4, w * 4);
+		} else {
+			remmina_plugin_vnc_rfb_fill_buffer(cl, dest, rowstride, src, width * bytesPerPixel, NULL, w, h);
+		}
+		cairo_surface_mark_dirty_rectangle(gpdata->rgb_buffer, x, y, w, h);
 	}
 
 	if ((remmina_plugin_service->remmina_protocol_widget_get_current_scale_mode(gp) != REMMINA_PROTOCOL_WIDGET_SCALE_MODE_NONE))
@@ -1713,6 +1647,10 @@ static gboolean remmina_plugin_vnc_close_connection_timeout(RemminaProtocolWidge
 		g_source_remove(gpdata->queuedraw_handler);
 		gpdata->queuedraw_handler = 0;
 	}
+	if (gpdata->queuedraw_region) {
+		cairo_region_destroy(gpdata->queuedraw_region);
+		gpdata->queuedraw_region = NULL;
+	}
 	if (gpdata->listen_sock >= 0)
 		close(gpdata->listen_sock);
 	if (gpdata->client) {
@@ -1835,7 +1773,8 @@ static gboolean remmina_plugin_vnc_on_draw(GtkWidget *widget, cairo_t *context,
 	TRACE_CALL(__func__);
 	RemminaPluginVncData *gpdata = GET_PLUGIN_DATA(gp);
 	cairo_surface_t *surface;
-	gint width, height;
+	cairo_rectangle_list_t *clip;
+	gint width, height, i;
 	GtkAllocation widget_allocation;
 
 	LOCK_BUFFER(FALSE);
@@ -1856,7 +1795,17 @@ static gboolean remmina_plugin_vnc_on_draw(GtkWidget *widget, cairo_t *context,
 			    (double)widget_allocation.height / height);
 	}
 
-	cairo_rectangle(context, 0, 0, width, height);
+	/* Only paint the damaged rectangles GTK clipped us to, falling back to
+	 * the whole surface when the clip is not a plain rectangle list */
+	clip = cairo_copy_clip_rectangle_list(context);
+	if (clip->status == CAIRO_STATUS_SUCCESS) {
+		for (i = 0; i < clip->num_rectangles; i++)
+			cairo_rectangle(context, clip->rectangles[i].x, clip->rectangles[i].y,
+					clip->rectangles[i].width, clip->rectangles[i].height);
+	} else {
+		cairo_rectangle(context, 0, 0, width, height);
+	}
+	cairo_rectangle_list_destroy(clip);
 	cairo_set_source_surface(context, surface, 0, 0);
 	cairo_fill(context);
 
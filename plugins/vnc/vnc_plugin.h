@@ -34,6 +34,8 @@
 
 #pragma once
 
+#include "vnc_pixel_convert.h"
+
 #ifndef __PLUGIN_CONFIG_H
 #define __PLUGIN_CONFIG_H
 
@@ -62,8 +64,10 @@ typedef struct _RemminaPluginVncData {
 	GtkWidget *		drawing_area;
 	guchar *		vnc_buffer;
 	cairo_surface_t *	rgb_buffer;
+	RemminaPluginVncPixelConverter	pixel_converter;
 
-	gint			queuedraw_x, queuedraw_y, queuedraw_w, queuedraw_h;
+	/* Damaged area waiting for the next redraw, protected by buffer_mutex */
+	cairo_region_t *	queuedraw_region;
 	guint			queuedraw_handler;
 
 	gulong			clipboard_handler;
@@ -143,6 +143,9 @@ typedef struct _RemminaSecretPlugin {
 	void (*store_password)(RemminaFile *remminafile, const gchar *key, const gchar *password);
 	gchar * (*get_password)(RemminaFile * remminafile, const gchar *key);
 	void (*delete_password)(RemminaFile *remminafile, const gchar *key);
+	/* Optional: fill passwords with every key -> password stored for the
+	 * profile in a single keyring query. Return FALSE to fall back to get_password() */
+	gboolean (*get_passwords)(RemminaFile *remminafile, GHashTable *passwords);
 } RemminaSecretPlugin;
 
 /* Plugin Service is a struct containing a list of function pointers,
@@ -234,6 +237,7 @@ typedef struct _RemminaPluginService {
 	gboolean (*gtksocket_available)(void);
 	gint (*get_profile_remote_width)(RemminaProtocolWidget *gp);
 	gint (*get_profile_remote_height)(RemminaProtocolWidget *gp);
+	void (*protocol_plugin_keep_tunnel_listening)(RemminaProtocolWidget *gp);
 } RemminaPluginService;
 
 /* "Prototype" of the plugin entry function */
@@ -2073,24 +2073,153 @@ static void rcw_toolbar_duplicate(GtkToolItem *toggle, RemminaConnectionWindow *
 	remmina_exec_command(REMMINA_COMMAND_CONNECT, cnnobj->remmina_file->filename);
 }
 
+/* A screenshot waiting to be encoded and written by a worker thread */
+typedef struct _RemminaScreenshotJob {
+	/* Framebuffer copy given by the plugin, or NULL when pixbuf is set */
+	RemminaPluginScreenshotData	rpsd;
+	GdkPixbuf *			pixbuf;
+	gchar *				filename;
+	gchar *				format;
+	gint				png_compression;
+	/* When to_clipboard is set, the worker also leaves the image in clipboard */
+	gboolean			to_clipboard;
+	GdkPixbuf *			clipboard;
+} RemminaScreenshotJob;
+
+static void rcw_screenshot_job_free(RemminaScreenshotJob *job)
+{
+	TRACE_CALL(__func__);
+	free(job->rpsd.buffer);
+	if (job->pixbuf)
+		g_object_unref(job->pixbuf);
+	if (job->clipboard)
+		g_object_unref(job->clipboard);
+	g_free(job->filename);
+	g_free(job->format);
+	g_free(job);
+}
+
+/* JPEG has no alpha channel, and gdk_pixbuf_save() fails on a pixbuf with one */
+static GdkPixbuf *rcw_screenshot_drop_alpha(GdkPixbuf *pixbuf)
+{
+	TRACE_CALL(__func__);
+	GdkPixbuf *rgb;
+	const guchar *src;
+	guchar *dst;
+	gint width, height, x, y;
+
+	width = gdk_pixbuf_get_width(pixbuf);
+	height = gdk_pixbuf_get_height(pixbuf);
+	rgb = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+	for (y = 0; y < height; y++) {
+		src = gdk_pixbuf_read_pixels(pixbuf) + y * gdk_pixbuf_get_rowstride(pixbuf);
+		dst = gdk_pixbuf_get_pixels(rgb) + y * gdk_pixbuf_get_rowstride(rgb);
+		for (x = 0; x < width; x++, src += 4, dst += 3) {
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+		}
+	}
+
+	return rgb;
+}
+
+static void rcw_screenshot_thread(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+	TRACE_CALL(__func__);
+	RemminaScreenshotJob *job = task_data;
+	cairo_surface_t *srcsurface, *surface;
+	cairo_format_t cairo_format;
+	cairo_t *cr;
+	GdkPixbuf *pixbuf, *rgb;
+	GError *err = NULL;
+	gchar *level;
+	gboolean ret;
+
+	if (job->rpsd.buffer) {
+		if (job->rpsd.bitsPerPixel == 32)
+			cairo_format = CAIRO_FORMAT_ARGB32;
+		else if (job->rpsd.bitsPerPixel == 24)
+			cairo_format = CAIRO_FORMAT_RGB24;
+		else
+			cairo_format = CAIRO_FORMAT_RGB16_565;
+
+		/* Drop the alpha channel, as the plugins do not fill it */
+		srcsurface = cairo_image_surface_create_for_data(job->rpsd.buffer, cairo_format, job->rpsd.width, job->rpsd.height,
+								 cairo_format_stride_for_width(cairo_format, job->rpsd.width));
+		surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, job->rpsd.width, job->rpsd.height);
+		cr = cairo_create(surface);
+		cairo_set_source_surface(cr, srcsurface, 0, 0);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+		cairo_surface_destroy(srcsurface);
+		pixbuf = gdk_pixbuf_get_from_surface(surface, 0, 0, job->rpsd.width, job->rpsd.height);
+		cairo_surface_destroy(surface);
+	} else {
+		pixbuf = g_object_ref(job->pixbuf);
+	}
+
+	/* Only gtk_clipboard_set_image() is left to the main thread */
+	if (job->to_clipboard)
+		job->clipboard = g_object_ref(pixbuf);
+
+	if (g_strcmp0(job->format, "jpeg") == 0 && gdk_pixbuf_get_has_alpha(pixbuf)) {
+		rgb = rcw_screenshot_drop_alpha(pixbuf);
+		g_object_unref(pixbuf);
+		pixbuf = rgb;
+	}
+
+	if (g_strcmp0(job->format, "png") == 0) {
+		level = g_strdup_printf("%d", CLAMP(job->png_compression, 0, 9));
+		ret = gdk_pixbuf_save(pixbuf, job->filename, job->format, &err, "compression", level, NULL);
+		g_free(level);
+	} else {
+		ret = gdk_pixbuf_save(pixbuf, job->filename, job->format, &err, NULL);
+	}
+	g_object_unref(pixbuf);
+
+	if (ret)
+		g_task_return_boolean(task, TRUE);
+	else
+		g_task_return_error(task, err);
+}
+
+static void rcw_screenshot_done(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaScreenshotJob *job = g_task_get_task_data(G_TASK(res));
+	GError *err = NULL;
+
+	/* Transfer the PixBuf in the main clipboard selection */
+	if (job->clipboard)
+		gtk_clipboard_set_image(gtk_clipboard_get(GDK_SELECTION_CLIPBOARD), job->clipboard);
+
+	/* send a desktop notification */
+	if (g_task_propagate_boolean(G_TASK(res), &err)) {
+		remmina_public_send_notification("remmina-screenshot-is-ready-id", _("Screenshot taken"), job->filename);
+	} else {
+		g_warning("Unable to save the screenshot %s: %s", job->filename, err->message);
+		g_error_free(err);
+	}
+}
+
 static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow *cnnwin)
 {
 	TRACE_CALL(__func__);
 
 	GdkPixbuf *screenshot;
 	GdkWindow *active_window;
-	cairo_t *cr;
 	gint width, height;
 	GString *pngstr;
 	gchar *pngname;
+	const gchar *ext;
 	GtkWidget *dialog;
 	RemminaProtocolWidget *gp;
 	RemminaPluginScreenshotData rpsd;
 	RemminaConnectionObject *cnnobj;
-	cairo_surface_t *srcsurface;
-	cairo_format_t cairo_format;
-	cairo_surface_t *surface;
-	int stride;
+	RemminaScreenshotJob *job;
+	GTask *task;
 
 	if (cnnwin->priv->toolbar_is_reconfiguring)
 		return;
@@ -2104,7 +2233,11 @@ static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow
 	gchar *denyclip = remmina_pref_get_value("deny_screenshot_clipboard");
 	REMMINA_DEBUG ("deny_screenshot_clipboard is set to %s", denyclip);
 
-	GtkClipboard *c = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
+	/* Only the capture is done here, the encoding and the writing of the
+	 * image are left to a worker thread, see rcw_screenshot_thread() */
+	job = g_new0(RemminaScreenshotJob, 1);
+	job->to_clipboard = denyclip && g_strcmp0(denyclip, "true");
+
 	// Ask the plugin if it can give us a screenshot
 	if (remmina_protocol_widget_plugin_screenshot(gp, &rpsd)) {
 		// Good, we have a screenshot from the plugin !
@@ -2112,31 +2245,8 @@ static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow
 		REMMINA_DEBUG("Screenshot from plugin: w=%d h=%d bpp=%d bytespp=%d\n",
 				   rpsd.width, rpsd.height, rpsd.bitsPerPixel, rpsd.bytesPerPixel);
 
-		width = rpsd.width;
-		height = rpsd.height;
-
-		if (rpsd.bitsPerPixel == 32)
-			cairo_format = CAIRO_FORMAT_ARGB32;
-		else if (rpsd.bitsPerPixel == 24)
-			cairo_format = CAIRO_FORMAT_RGB24;
-		else
-			cairo_format = CAIRO_FORMAT_RGB16_565;
-
-		stride = cairo_format_stride_for_width(cairo_format, width);
-
-		srcsurface = cairo_image_surface_create_for_data(rpsd.buffer, cairo_format, width, height, stride);
-		// Transfer the PixBuf in the main clipboard selection
-		if (denyclip && (g_strcmp0 (denyclip, "true")))
-			gtk_clipboard_set_image(c, gdk_pixbuf_get_from_surface(
-							srcsurface, 0, 0, width, height));
-		surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
-		cr = cairo_create(surface);
-		cairo_set_source_surface(cr, srcsurface, 0, 0);
-		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
-		cairo_paint(cr);
-		cairo_surface_destroy(srcsurface);
-
-		free(rpsd.buffer);
+		/* The buffer is a copy of the framebuffer, the job owns it now */
+		job->rpsd = rpsd;
 	} else {
 		// The plugin is not releasing us a screenshot, just try to catch one via GTK
 
@@ -2157,30 +2267,28 @@ static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow
 		height = gdk_window_get_height(active_window);
 
 		screenshot = gdk_pixbuf_get_from_window(active_window, 0, 0, width, height);
-		if (screenshot == NULL)
+		if (screenshot == NULL) {
 			g_print("gdk_pixbuf_get_from_window failed\n");
+			g_date_time_unref(date);
+			rcw_screenshot_job_free(job);
+			return;
+		}
 
-		// Transfer the PixBuf in the main clipboard selection
-		if (denyclip && (g_strcmp0 (denyclip, "true")))
-			gtk_clipboard_set_image(c, screenshot);
-		// Prepare the destination Cairo surface.
-		surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
-		cr = cairo_create(surface);
-
-		// Copy the source pixbuf to the surface and paint it.
-		gdk_cairo_set_source_pixbuf(cr, screenshot, 0, 0);
-		cairo_paint(cr);
-
-		// Deallocate screenshot pixbuf
-		g_object_unref(screenshot);
+		job->pixbuf = screenshot;
 	}
 
 	//home/antenore/Pictures/remmina_%p_%h_%Y  %m %d-%H%M%S.png pngname
 	//home/antenore/Pictures/remmina_st_  _2018 9 24-151958.240374.png
 
-	pngstr = g_string_new(g_strdup_printf("%s/%s.png",
+	job->format = g_strdup(remmina_pref.screenshot_format && remmina_pref.screenshot_format[0] ?
+			       remmina_pref.screenshot_format : "png");
+	ext = g_strcmp0(job->format, "jpeg") == 0 ? "jpg" : job->format;
+	job->png_compression = remmina_pref.screenshot_png_compression;
+
+	pngstr = g_string_new(g_strdup_printf("%s/%s.%s",
 					      remmina_pref.screenshot_path,
-					      remmina_pref.screenshot_name));
+					      remmina_pref.screenshot_name,
+					      ext));
 	remmina_utils_string_replace_all(pngstr, "%p",
 					 remmina_file_get_string(cnnobj->remmina_file, "name"));
 	remmina_utils_string_replace_all(pngstr, "%h",
@@ -2199,16 +2307,12 @@ static void rcw_toolbar_screenshot(GtkToolItem *toggle, RemminaConnectionWindow
 					 g_strdup_printf("%02d", g_date_time_get_second(date)));
 	g_date_time_unref(date);
 	pngname = g_string_free(pngstr, FALSE);
+	job->filename = pngname;
 
-	cairo_surface_write_to_png(surface, pngname);
-
-	/* send a desktop notification */
-	if (g_file_test(pngname, G_FILE_TEST_EXISTS))
-		remmina_public_send_notification("remmina-screenshot-is-ready-id", _("Screenshot taken"), pngname);
-
-	//Clean up and return.
-	cairo_destroy(cr);
-	cairo_surface_destroy(surface);
+	task = g_task_new(NULL, NULL, rcw_screenshot_done, NULL);
+	g_task_set_task_data(task, job, (GDestroyNotify)rcw_screenshot_job_free);
+	g_task_run_in_thread(task, rcw_screenshot_thread);
+	g_object_unref(task);
 }
 
 static void rcw_toolbar_minimize(GtkToolItem *toggle, RemminaConnectionWindow *cnnwin)
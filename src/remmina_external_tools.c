@@ -112,6 +112,7 @@ static gboolean remmina_external_tools_launcher(const gchar* filename, const gch
 	remminafile = remmina_file_load(filename);
 	if (!remminafile)
 		return FALSE;
+	remmina_file_load_secrets(remminafile);
 	GHashTableIter iter;
 	const gchar *key, *value;
 	g_hash_table_iter_init(&iter, remminafile->settings);
@@ -70,6 +70,10 @@
 
 static struct timespec times[2];
 
+/* Serializes the replacement of RemminaFile snapshots with the writes to
+ * the settings, which plugin threads do too */
+static GMutex remmina_file_snapshot_mutex;
+
 static RemminaFile *
 remmina_file_new_empty(void)
 {
@@ -334,8 +338,7 @@ remmina_file_load(const gchar *filename)
 	gchar *key;
 	gchar *resolution_str;
 	gint i;
-	gchar *s, *sec;
-	RemminaProtocolPlugin *protocol_plugin;
+	gchar *s;
 	RemminaSecretPlugin *secret_plugin;
 	gboolean secret_service_available;
 	int w, h;
@@ -354,14 +357,8 @@ remmina_file_load(const gchar *filename)
 
 		remminafile = remmina_file_new_empty();
 
-		protocol_plugin = NULL;
-
-		/* Identify the protocol plugin and get pointers to its RemminaProtocolSetting structs */
+		/* The encrypted settings of the protocol are known without opening its plugin */
 		proto = g_key_file_get_string(gkeyfile, KEYFILE_GROUP_REMMINA, "protocol", NULL);
-		if (proto) {
-			protocol_plugin = (RemminaProtocolPlugin *)remmina_plugin_manager_get_plugin(REMMINA_PLUGIN_TYPE_PROTOCOL, proto);
-			g_free(proto);
-		}
 
 		secret_plugin = remmina_plugin_manager_get_secret_plugin();
 		secret_service_available = secret_plugin && secret_plugin->is_service_available();
@@ -372,17 +369,16 @@ remmina_file_load(const gchar *filename)
 
 			for (i = 0; keys[i]; i++) {
 				key = keys[i];
-				if (protocol_plugin && remmina_plugin_manager_is_encrypted_setting(protocol_plugin, key)) {
+				if (remmina_plugin_manager_is_encrypted_protocol_setting(proto, key)) {
 					s = g_key_file_get_string(gkeyfile, KEYFILE_GROUP_REMMINA, key, NULL);
 					if (g_strcmp0(s, ".") == 0) {
+						remmina_file_set_string(remminafile, key, s);
 						if (secret_service_available) {
-							sec = secret_plugin->get_password(remminafile, key);
-							remmina_file_set_string(remminafile, key, sec);
-							/* Annotate in spsettings that this value comes from secret_plugin */
+							/* Annotate in spsettings that this value comes from secret_plugin.
+							 * The keyring is queried only when the value is actually needed,
+							 * see remmina_file_load_secrets() */
 							g_hash_table_insert(remminafile->spsettings, g_strdup(key), NULL);
-							g_free(sec);
-						} else {
-							remmina_file_set_string(remminafile, key, s);
+							remminafile->secrets_pending = TRUE;
 						}
 					} else {
 						remmina_file_set_string_ref(remminafile, key, remmina_crypt_decrypt(s));
@@ -411,6 +407,7 @@ remmina_file_load(const gchar *filename)
 
 		}
 		g_strfreev(keys);
+		g_free(proto);
 	} else {
 		REMMINA_DEBUG ("Unable to load remmina profile file %s: cannot find key name= in section remmina.\n", filename);
 		remminafile = NULL;
@@ -421,6 +418,109 @@ remmina_file_load(const gchar *filename)
 	return remminafile;
 }
 
+/* Plugin threads get the settings from a snapshot published by the main
+ * thread. A change of the settings drops the snapshot: plugin threads ask
+ * the main thread again, which publishes a new one on the next read.
+ * Snapshot keys and values are interned in snapshot_strings, so the strings
+ * handed out to plugin threads outlive their snapshot, and a value is
+ * stored once however many snapshots used it */
+static const gchar *
+remmina_file_intern_snapshot_string(RemminaFile *remminafile, const gchar *str)
+{
+	gchar *interned;
+
+	interned = g_hash_table_lookup(remminafile->snapshot_strings, str);
+	if (!interned) {
+		interned = g_strdup(str);
+		g_hash_table_add(remminafile->snapshot_strings, interned);
+	}
+	return interned;
+}
+
+void
+remmina_file_publish_settings(RemminaFile *remminafile)
+{
+	TRACE_CALL(__func__);
+	GHashTable *snapshot, *old;
+	GHashTableIter iter;
+	const gchar *key, *value;
+
+	remminafile->publish_settings = TRUE;
+
+	/* Hold the lock while walking the settings, a plugin thread writing one
+	 * meanwhile would invalidate the iterator. Its write then either is in
+	 * the new snapshot or drops it after it is installed */
+	g_mutex_lock(&remmina_file_snapshot_mutex);
+
+	if (!remminafile->snapshot_strings)
+		remminafile->snapshot_strings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	snapshot = g_hash_table_new(g_str_hash, g_str_equal);
+	g_hash_table_iter_init(&iter, remminafile->settings);
+	while (g_hash_table_iter_next(&iter, (gpointer *)&key, (gpointer *)&value))
+		g_hash_table_insert(snapshot,
+				    (gpointer)remmina_file_intern_snapshot_string(remminafile, key),
+				    (gpointer)remmina_file_intern_snapshot_string(remminafile, value));
+
+	old = remminafile->snapshot;
+	remminafile->snapshot = snapshot;
+	g_mutex_unlock(&remmina_file_snapshot_mutex);
+
+	if (old)
+		g_hash_table_unref(old);
+}
+
+/* Look a setting up in the published snapshot, from a plugin thread.
+ * Returns FALSE when there is no snapshot to read */
+static gboolean
+remmina_file_lookup_snapshot(RemminaFile *remminafile, const gchar *setting, const gchar **value)
+{
+	gboolean found;
+
+	g_mutex_lock(&remmina_file_snapshot_mutex);
+	found = remminafile->snapshot != NULL;
+	if (found)
+		*value = g_hash_table_lookup(remminafile->snapshot, setting);
+	g_mutex_unlock(&remmina_file_snapshot_mutex);
+
+	return found;
+}
+
+/* Value of a setting as seen by the calling thread */
+static const gchar *
+remmina_file_lookup(RemminaFile *remminafile, const gchar *setting)
+{
+	const gchar *value;
+
+	if (!remmina_masterthread_exec_is_main_thread() &&
+	    remmina_file_lookup_snapshot(remminafile, setting, &value))
+		return value;
+	g_mutex_lock(&remmina_file_snapshot_mutex);
+	value = g_hash_table_lookup(remminafile->settings, setting);
+	g_mutex_unlock(&remmina_file_snapshot_mutex);
+	return value;
+}
+
+/* Store a setting, taking ownership of value, and drop the snapshot when
+ * the value changed. Writing the same value again, e.g. the window size,
+ * keeps the snapshot */
+static void
+remmina_file_store(RemminaFile *remminafile, const gchar *setting, gchar *value)
+{
+	GHashTable *old = NULL;
+
+	g_mutex_lock(&remmina_file_snapshot_mutex);
+	if (g_strcmp0(g_hash_table_lookup(remminafile->settings, setting), value) != 0) {
+		old = remminafile->snapshot;
+		remminafile->snapshot = NULL;
+	}
+	g_hash_table_insert(remminafile->settings, g_strdup(setting), value);
+	g_mutex_unlock(&remmina_file_snapshot_mutex);
+
+	if (old)
+		g_hash_table_unref(old);
+}
+
 void remmina_file_set_string(RemminaFile *remminafile, const gchar *setting, const gchar *value)
 {
 	TRACE_CALL(__func__);
@@ -440,10 +540,62 @@ void remmina_file_set_string_ref(RemminaFile *remminafile, const gchar *setting,
 			remmina_main_show_warning_dialog(message);
 			return;
 		}
-		g_hash_table_insert(remminafile->settings, g_strdup(setting), value);
 	} else {
-		g_hash_table_insert(remminafile->settings, g_strdup(setting), g_strdup(""));
+		value = g_strdup("");
 	}
+	remmina_file_store(remminafile, setting, value);
+}
+
+void remmina_file_load_secrets(RemminaFile *remminafile)
+{
+	TRACE_CALL(__func__);
+	RemminaSecretPlugin *secret_plugin;
+	GHashTable *passwords;
+	GHashTableIter iter;
+	const gchar *key, *value;
+	gchar *sec;
+
+	/* The keyring and the settings are only touched from the main thread,
+	 * see remmina_protocol_widget_open_connection_real() */
+	if (!remminafile->secrets_pending || !remmina_masterthread_exec_is_main_thread())
+		return;
+
+	secret_plugin = remmina_plugin_manager_get_secret_plugin();
+	if (!secret_plugin || !secret_plugin->is_service_available()) {
+		remminafile->secrets_pending = FALSE;
+		return;
+	}
+
+	/* Ask for all the passwords of the profile at once when the plugin
+	 * supports it, instead of one keyring round trip per setting */
+	passwords = NULL;
+	if (secret_plugin->get_passwords) {
+		passwords = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+		if (!secret_plugin->get_passwords(remminafile, passwords)) {
+			g_hash_table_destroy(passwords);
+			passwords = NULL;
+		}
+	}
+
+	g_hash_table_iter_init(&iter, remminafile->spsettings);
+	while (g_hash_table_iter_next(&iter, (gpointer *)&key, NULL)) {
+		value = g_hash_table_lookup(remminafile->settings, key);
+		/* Already replaced by the user or by the code */
+		if (g_strcmp0(value, ".") != 0)
+			continue;
+		if (passwords)
+			sec = g_strdup(g_hash_table_lookup(passwords, key));
+		else
+			sec = secret_plugin->get_password(remminafile, key);
+		remmina_file_set_string(remminafile, key, sec);
+		g_free(sec);
+	}
+
+	if (passwords)
+		g_hash_table_destroy(passwords);
+
+	/* Only now, a reader seeing the flag cleared must not get a placeholder */
+	remminafile->secrets_pending = FALSE;
 }
 
 const gchar *
@@ -452,10 +604,17 @@ remmina_file_get_string(RemminaFile *remminafile, const gchar *setting)
 	TRACE_CALL(__func__);
 	gchar *value;
 	const gchar *message;
+	const gchar *published;
 
 	/* Returned value is a pointer to the string stored on the hash table,
 	 * please do not free it or the hash table will contain invalid pointer */
 	if (!remmina_masterthread_exec_is_main_thread()) {
+		/* "." may be a secret not fetched yet, the main thread knows */
+		if (strcmp(setting, "resolution") != 0 &&
+		    remmina_file_lookup_snapshot(remminafile, setting, &published) &&
+		    g_strcmp0(published, ".") != 0)
+			return published && published[0] ? published : NULL;
+
 		/* Allow the execution of this function from a non main thread
 		 * (plugins needs it to have user credentials)*/
 		RemminaMTExecData *d;
@@ -478,6 +637,13 @@ remmina_file_get_string(RemminaFile *remminafile, const gchar *setting)
 	}
 
 	value = (gchar *)g_hash_table_lookup(remminafile->settings, setting);
+	if (remminafile->secrets_pending && g_strcmp0(value, ".") == 0 &&
+	    g_hash_table_contains(remminafile->spsettings, setting)) {
+		remmina_file_load_secrets(remminafile);
+		value = (gchar *)g_hash_table_lookup(remminafile->settings, setting);
+	}
+	if (remminafile->publish_settings && remminafile->snapshot == NULL)
+		remmina_file_publish_settings(remminafile);
 	return value && value[0] ? value : NULL;
 }
 
@@ -519,16 +685,19 @@ gchar *remmina_file_format_properties(RemminaFile *remminafile, const gchar *set
 void remmina_file_set_int(RemminaFile *remminafile, const gchar *setting, gint value)
 {
 	TRACE_CALL(__func__);
-	g_hash_table_insert(remminafile->settings, g_strdup(setting), g_strdup_printf("%i", value));
+	gchar *str;
+
+	str = g_strdup_printf("%i", value);
+	remmina_file_store(remminafile, setting, str);
 }
 
 gint remmina_file_get_int(RemminaFile *remminafile, const gchar *setting, gint default_value)
 {
 	TRACE_CALL(__func__);
-	gchar *value;
+	const gchar *value;
 	gint r;
 
-	value = g_hash_table_lookup(remminafile->settings, setting);
+	value = remmina_file_lookup(remminafile, setting);
 	r = value == NULL ? default_value : (value[0] == 't' ? TRUE : atoi(value));
 	// TOO verbose: REMMINA_DEBUG ("Integer value is: %d", r);
 	return r;
@@ -541,9 +710,9 @@ gdouble remmina_file_get_double(RemminaFile *remminafile,
 							   gdouble default_value)
 {
 	TRACE_CALL(__func__);
-	gchar *value;
+	const gchar *value;
 
-	value = g_hash_table_lookup(remminafile->settings, setting);
+	value = remmina_file_lookup(remminafile, setting);
 	if (!value)
 		return default_value;
 
@@ -584,6 +753,10 @@ void remmina_file_free(RemminaFile *remminafile)
 	g_free(remminafile->filename);
 	g_hash_table_destroy(remminafile->settings);
 	g_hash_table_destroy(remminafile->spsettings);
+	if (remminafile->snapshot)
+		g_hash_table_unref(remminafile->snapshot);
+	if (remminafile->snapshot_strings)
+		g_hash_table_destroy(remminafile->snapshot_strings);
 	g_free(remminafile);
 }
 
@@ -593,7 +766,6 @@ void remmina_file_save(RemminaFile *remminafile)
 	TRACE_CALL(__func__);
 	RemminaSecretPlugin *secret_plugin;
 	gboolean secret_service_available;
-	RemminaProtocolPlugin *protocol_plugin;
 	GHashTableIter iter;
 	const gchar *key, *value;
 	gchar *s, *proto, *content;
@@ -611,21 +783,19 @@ void remmina_file_save(RemminaFile *remminafile)
 	REMMINA_DEBUG ("Saving profile");
 	/* get disablepasswordstoring */
 	nopasswdsave = remmina_file_get_int(remminafile, "disablepasswordstoring", 0);
-	/* Identify the protocol plugin and get pointers to its RemminaProtocolSetting structs */
+	/* Moving the secrets out of the keyring needs their values */
+	if (nopasswdsave)
+		remmina_file_load_secrets(remminafile);
 	proto = (gchar *)g_hash_table_lookup(remminafile->settings, "protocol");
-	if (proto) {
-		protocol_plugin = (RemminaProtocolPlugin *)remmina_plugin_manager_get_plugin(REMMINA_PLUGIN_TYPE_PROTOCOL, proto);
-	} else {
+	if (!proto)
 		g_warning("Saving settings for unknown protocol, because remminafile has non proto key\n");
-		protocol_plugin = NULL;
-	}
 
 	secret_plugin = remmina_plugin_manager_get_secret_plugin();
 	secret_service_available = secret_plugin && secret_plugin->is_service_available();
 
 	g_hash_table_iter_init(&iter, remminafile->settings);
 	while (g_hash_table_iter_next(&iter, (gpointer *)&key, (gpointer *)&value)) {
-		if (remmina_plugin_manager_is_encrypted_setting(protocol_plugin, key)) {
+		if (remmina_plugin_manager_is_encrypted_protocol_setting(proto, key)) {
 			if (remminafile->filename && g_strcmp0(remminafile->filename, remmina_pref_file)) {
 				if (secret_service_available && nopasswdsave == 0) {
 					REMMINA_DEBUG ("We have a secret and disablepasswordstoring=0");
@@ -684,6 +854,7 @@ void remmina_file_save(RemminaFile *remminafile)
 	g_free(content);
 	g_key_file_free(gkeyfile);
 
+	remmina_file_manager_index_invalidate(remminafile->filename);
 	remmina_main_update_file_datetime(remminafile);
 }
 
@@ -713,6 +884,9 @@ remmina_file_dup(RemminaFile *remminafile)
 	GHashTableIter iter;
 	const gchar *key, *value;
 
+	/* The copy does not know which values come from the keyring */
+	remmina_file_load_secrets(remminafile);
+
 	dupfile = remmina_file_new_empty();
 	dupfile->filename = g_strdup(remminafile->filename);
 
@@ -727,14 +901,14 @@ const gchar *
 remmina_file_get_icon_name(RemminaFile *remminafile)
 {
 	TRACE_CALL(__func__);
-	RemminaProtocolPlugin *plugin;
+	const gchar *icon_name;
 
-	plugin = (RemminaProtocolPlugin *)remmina_plugin_manager_get_plugin(REMMINA_PLUGIN_TYPE_PROTOCOL,
-									    remmina_file_get_string(remminafile, "protocol"));
-	if (!plugin)
+	icon_name = remmina_plugin_manager_get_protocol_icon_name(remmina_file_get_string(remminafile, "protocol"),
+								  remmina_file_get_int(remminafile, "ssh_tunnel_enabled", FALSE));
+	if (!icon_name)
 		return g_strconcat (REMMINA_APP_ID, "-symbolic", NULL);
 
-	return remmina_file_get_int(remminafile, "ssh_tunnel_enabled", FALSE) ? plugin->icon_name_ssh : plugin->icon_name;
+	return icon_name;
 }
 
 RemminaFile *
@@ -761,6 +935,7 @@ void remmina_file_delete(const gchar *filename)
 		remmina_file_free(remminafile);
 	}
 	g_unlink(filename);
+	remmina_file_manager_index_invalidate(filename);
 }
 
 void remmina_file_unsave_passwords(RemminaFile *remminafile)
@@ -881,6 +1056,7 @@ remmina_file_touch(RemminaFile *remminafile)
 		times[1] = st.st_mtim;
 		if (utimensat(AT_FDCWD, remminafile->filename, times, 0) < 0)
 			REMMINA_DEBUG("utimensat %s:", remminafile->filename);
+		remmina_file_manager_index_invalidate(remminafile->filename);
 		return;
 	}
 
@@ -45,6 +45,14 @@ struct _RemminaFile {
 	GHashTable *	settings;
 	GHashTable *	spsettings;
 	gboolean	prevent_saving;
+	/* Secret plugin values listed in spsettings are not fetched yet */
+	gboolean	secrets_pending;
+	/* Read only copy of settings for the plugin threads, NULL when settings
+	 * changed since it was published. See remmina_file_publish_settings() */
+	GHashTable *	snapshot;
+	gboolean	publish_settings;
+	/* Strings of all the snapshots, kept until the file is freed */
+	GHashTable *	snapshot_strings;
 };
 
 /**
@@ -84,6 +92,10 @@ void remmina_file_set_string(RemminaFile *remminafile, const gchar *setting, con
 void remmina_file_set_string_ref(RemminaFile *remminafile, const gchar *setting, gchar *value);
 const gchar *remmina_file_get_string(RemminaFile *remminafile, const gchar *setting);
 gchar *remmina_file_get_secret(RemminaFile *remminafile, const gchar *setting);
+/* Fetch from the secret plugin the passwords deferred by remmina_file_load() */
+void remmina_file_load_secrets(RemminaFile *remminafile);
+/* Let plugin threads read settings without a main thread round trip. Main thread only */
+void remmina_file_publish_settings(RemminaFile *remminafile);
 gchar *remmina_file_format_properties(RemminaFile *remminafile, const gchar *setting);
 void remmina_file_set_int(RemminaFile *remminafile, const gchar *setting, gint value);
 gint remmina_file_get_int(RemminaFile *remminafile, const gchar *setting, gint default_value);
@@ -37,7 +37,9 @@
 #include "config.h"
 
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
 #include <string.h>
+#include <time.h>
 
 #include "remmina_public.h"
 #include "remmina_pref.h"
@@ -148,6 +150,291 @@ void remmina_file_manager_init(void)
 		g_free(remminadir), remminadir = NULL;
 }
 
+/* ------------------------ Profile index ------------------------ */
+
+/* File in the cache directory where the index survives restarts */
+#define REMMINA_FILE_INDEX_NAME "profiles.index"
+
+/* Index of the data directory, filename -> RemminaFileIndexEntry. Main thread only */
+static GHashTable *index_entries;
+static gchar *index_dir;
+static GFileMonitor *index_monitor;
+/* The data directory must be listed again */
+static gboolean index_dirty = TRUE;
+
+/* Profiles changed since the last update, filled from any thread */
+G_LOCK_DEFINE_STATIC(index_stale);
+static GHashTable *index_stale;
+
+static void remmina_file_manager_index_entry_free(RemminaFileIndexEntry *entry)
+{
+	TRACE_CALL(__func__);
+	g_free(entry->filename);
+	g_free(entry->name);
+	g_free(entry->group);
+	g_free(entry->server);
+	g_free(entry->protocol);
+	g_free(entry->datetime);
+	g_free(entry);
+}
+
+/* Same format as remmina_file_get_datetime() */
+static gchar *remmina_file_manager_index_format_datetime(guint64 mtime)
+{
+	TRACE_CALL(__func__);
+	time_t t = (time_t)mtime;
+	char time_string[256];
+
+	strftime(time_string, sizeof(time_string), "%F - %T", localtime(&t));
+	return g_locale_to_utf8(time_string, -1, NULL, NULL, NULL);
+}
+
+static RemminaFileIndexEntry *remmina_file_manager_index_entry_new(const gchar *filename, GStatBuf *st)
+{
+	TRACE_CALL(__func__);
+	RemminaFileIndexEntry *entry;
+	RemminaFile *remminafile;
+
+	remminafile = remmina_file_load(filename);
+	if (!remminafile)
+		return NULL;
+
+	entry = g_new0(RemminaFileIndexEntry, 1);
+	entry->filename = g_strdup(filename);
+	entry->name = g_strdup(remmina_file_get_string(remminafile, "name"));
+	entry->group = g_strdup(remmina_file_get_string(remminafile, "group"));
+	entry->server = g_strdup(remmina_file_get_string(remminafile, "server"));
+	entry->protocol = g_strdup(remmina_file_get_string(remminafile, "protocol"));
+	entry->ssh_tunnel_enabled = remmina_file_get_int(remminafile, "ssh_tunnel_enabled", FALSE);
+	entry->mtime = st->st_mtime;
+	entry->size = st->st_size;
+	entry->datetime = remmina_file_manager_index_format_datetime(entry->mtime);
+	remmina_file_free(remminafile);
+
+	return entry;
+}
+
+static gchar *remmina_file_manager_index_cache_path(void)
+{
+	TRACE_CALL(__func__);
+	return g_build_path("/", g_get_user_cache_dir(), "remmina", REMMINA_FILE_INDEX_NAME, NULL);
+}
+
+static void remmina_file_manager_index_load_cache(void)
+{
+	TRACE_CALL(__func__);
+	RemminaFileIndexEntry *entry;
+	GKeyFile *gkeyfile;
+	gchar **groups;
+	gchar *path;
+	gint i;
+
+	path = remmina_file_manager_index_cache_path();
+	gkeyfile = g_key_file_new();
+	if (g_key_file_load_from_file(gkeyfile, path, G_KEY_FILE_NONE, NULL)) {
+		groups = g_key_file_get_groups(gkeyfile, NULL);
+		for (i = 0; groups[i]; i++) {
+			if (!g_str_has_prefix(groups[i], index_dir))
+				continue;
+			entry = g_new0(RemminaFileIndexEntry, 1);
+			entry->filename = g_strdup(groups[i]);
+			entry->name = g_key_file_get_string(gkeyfile, groups[i], "name", NULL);
+			entry->group = g_key_file_get_string(gkeyfile, groups[i], "group", NULL);
+			entry->server = g_key_file_get_string(gkeyfile, groups[i], "server", NULL);
+			entry->protocol = g_key_file_get_string(gkeyfile, groups[i], "protocol", NULL);
+			entry->ssh_tunnel_enabled = g_key_file_get_boolean(gkeyfile, groups[i], "ssh_tunnel_enabled", NULL);
+			entry->mtime = g_key_file_get_uint64(gkeyfile, groups[i], "mtime", NULL);
+			entry->size = g_key_file_get_uint64(gkeyfile, groups[i], "size", NULL);
+			entry->datetime = remmina_file_manager_index_format_datetime(entry->mtime);
+			g_hash_table_replace(index_entries, entry->filename, entry);
+		}
+		g_strfreev(groups);
+	}
+	g_key_file_free(gkeyfile);
+	g_free(path);
+}
+
+static void remmina_file_manager_index_set_string(GKeyFile *gkeyfile, const gchar *group, const gchar *key, const gchar *value)
+{
+	TRACE_CALL(__func__);
+	if (value)
+		g_key_file_set_string(gkeyfile, group, key, value);
+}
+
+static void remmina_file_manager_index_save_cache(void)
+{
+	TRACE_CALL(__func__);
+	RemminaFileIndexEntry *entry;
+	GHashTableIter iter;
+	GKeyFile *gkeyfile;
+	gchar *path;
+
+	gkeyfile = g_key_file_new();
+	g_hash_table_iter_init(&iter, index_entries);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry)) {
+		remmina_file_manager_index_set_string(gkeyfile, entry->filename, "name", entry->name);
+		remmina_file_manager_index_set_string(gkeyfile, entry->filename, "group", entry->group);
+		remmina_file_manager_index_set_string(gkeyfile, entry->filename, "server", entry->server);
+		remmina_file_manager_index_set_string(gkeyfile, entry->filename, "protocol", entry->protocol);
+		g_key_file_set_boolean(gkeyfile, entry->filename, "ssh_tunnel_enabled", entry->ssh_tunnel_enabled);
+		g_key_file_set_uint64(gkeyfile, entry->filename, "mtime", entry->mtime);
+		g_key_file_set_uint64(gkeyfile, entry->filename, "size", entry->size);
+	}
+	path = remmina_file_manager_index_cache_path();
+	if (!g_key_file_save_to_file(gkeyfile, path, NULL))
+		g_debug("Could not save the profile index to %s", path);
+	g_free(path);
+	g_key_file_free(gkeyfile);
+}
+
+void remmina_file_manager_index_invalidate(const gchar *filename)
+{
+	TRACE_CALL(__func__);
+	G_LOCK(index_stale);
+	if (!index_stale)
+		index_stale = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_hash_table_add(index_stale, g_strdup(filename));
+	G_UNLOCK(index_stale);
+}
+
+static void remmina_file_manager_index_on_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+						  GFileMonitorEvent event_type, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	gchar *path;
+
+	if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+		return;
+	path = g_file_get_path(file);
+	if (path && g_str_has_suffix(path, ".remmina"))
+		remmina_file_manager_index_invalidate(path);
+	g_free(path);
+	index_dirty = TRUE;
+}
+
+/* Start over with the data directory datadir */
+static void remmina_file_manager_index_reset(const gchar *datadir)
+{
+	TRACE_CALL(__func__);
+	GFile *gfile;
+
+	if (index_monitor) {
+		g_file_monitor_cancel(index_monitor);
+		g_object_unref(index_monitor);
+		index_monitor = NULL;
+	}
+	if (index_entries)
+		g_hash_table_destroy(index_entries);
+	g_free(index_dir);
+
+	index_dir = g_strdup(datadir);
+	index_entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+					      (GDestroyNotify)remmina_file_manager_index_entry_free);
+	remmina_file_manager_index_load_cache();
+
+	/* Without a monitor the directory is listed on each update */
+	gfile = g_file_new_for_path(datadir);
+	index_monitor = g_file_monitor_directory(gfile, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref(gfile);
+	if (index_monitor)
+		g_signal_connect(index_monitor, "changed", G_CALLBACK(remmina_file_manager_index_on_changed), NULL);
+	index_dirty = TRUE;
+}
+
+static gboolean remmina_file_manager_index_prune(gpointer key, gpointer value, gpointer seen)
+{
+	return !g_hash_table_contains((GHashTable *)seen, key);
+}
+
+/* Bring the index up to date, parsing only the profiles that changed */
+static void remmina_file_manager_index_update(void)
+{
+	TRACE_CALL(__func__);
+	RemminaFileIndexEntry *entry;
+	gchar filename[MAX_PATH_LEN];
+	GHashTable *stale, *seen;
+	GHashTableIter iter;
+	const gchar *name;
+	gchar *datadir;
+	gboolean changed = FALSE;
+	GStatBuf st;
+	GDir *dir;
+
+	datadir = remmina_file_get_datadir();
+	if (g_strcmp0(datadir, index_dir) != 0)
+		remmina_file_manager_index_reset(datadir);
+
+	G_LOCK(index_stale);
+	stale = index_stale;
+	index_stale = NULL;
+	G_UNLOCK(index_stale);
+	if (stale) {
+		g_hash_table_iter_init(&iter, stale);
+		while (g_hash_table_iter_next(&iter, (gpointer *)&name, NULL))
+			changed |= g_hash_table_remove(index_entries, name);
+		g_hash_table_destroy(stale);
+		index_dirty = TRUE;
+	}
+
+	if (!index_dirty && index_monitor) {
+		g_free(datadir);
+		return;
+	}
+
+	dir = g_dir_open(datadir, 0, NULL);
+	if (dir) {
+		seen = g_hash_table_new(g_str_hash, g_str_equal);
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			if (!g_str_has_suffix(name, ".remmina"))
+				continue;
+			g_snprintf(filename, MAX_PATH_LEN, "%s/%s", datadir, name);
+			if (g_stat(filename, &st) < 0)
+				continue;
+			entry = g_hash_table_lookup(index_entries, filename);
+			if (!entry || entry->mtime != (guint64)st.st_mtime || entry->size != (guint64)st.st_size) {
+				entry = remmina_file_manager_index_entry_new(filename, &st);
+				if (!entry) {
+					changed |= g_hash_table_remove(index_entries, filename);
+					continue;
+				}
+				g_hash_table_replace(index_entries, entry->filename, entry);
+				changed = TRUE;
+			}
+			g_hash_table_add(seen, entry->filename);
+		}
+		g_dir_close(dir);
+		if (g_hash_table_foreach_remove(index_entries, remmina_file_manager_index_prune, seen) > 0)
+			changed = TRUE;
+		g_hash_table_destroy(seen);
+	}
+	index_dirty = FALSE;
+
+	if (changed)
+		remmina_file_manager_index_save_cache();
+	g_free(datadir);
+}
+
+gint remmina_file_manager_iterate_index(GFunc func, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaFileIndexEntry *entry;
+	GHashTableIter iter;
+	gint items_count = 0;
+
+	remmina_file_manager_index_update();
+
+	g_hash_table_iter_init(&iter, index_entries);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry)) {
+		/* Same as remmina_file_get_icon_name(), plugins may come and go */
+		entry->icon_name = remmina_plugin_manager_get_protocol_icon_name(entry->protocol, entry->ssh_tunnel_enabled);
+		if (!entry->icon_name)
+			entry->icon_name = REMMINA_APP_ID "-symbolic";
+		(*func)(entry, user_data);
+		items_count++;
+	}
+	return items_count;
+}
+
 gint remmina_file_manager_iterate(GFunc func, gpointer user_data)
 {
 	TRACE_CALL(__func__);
@@ -183,39 +470,22 @@ gint remmina_file_manager_iterate(GFunc func, gpointer user_data)
 gchar *remmina_file_manager_get_groups(void)
 {
 	TRACE_CALL(__func__);
-	gchar filename[MAX_PATH_LEN];
-	GDir *dir;
-	const gchar *name;
-	RemminaFile *remminafile;
+	RemminaFileIndexEntry *entry;
 	RemminaStringArray *array;
-	const gchar *group;
+	GHashTableIter iter;
 	gchar *groups;
-	gchar *remmina_data_dir;
-
-	remmina_data_dir = remmina_file_get_datadir();
-	array = remmina_string_array_new();
 
-	dir = g_dir_open(remmina_data_dir, 0, NULL);
+	remmina_file_manager_index_update();
 
-	if (dir == NULL)
-		return 0;
-	while ((name = g_dir_read_name(dir)) != NULL) {
-		if (!g_str_has_suffix(name, ".remmina"))
-			continue;
-		g_snprintf(filename, MAX_PATH_LEN, "%s/%s", remmina_data_dir, name);
-		remminafile = remmina_file_load(filename);
-		if (remminafile) {
-			group = remmina_file_get_string(remminafile, "group");
-			if (group && remmina_string_array_find(array, group) < 0)
-				remmina_string_array_add(array, group);
-			remmina_file_free(remminafile);
-		}
+	array = remmina_string_array_new();
+	g_hash_table_iter_init(&iter, index_entries);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry)) {
+		if (entry->group && remmina_string_array_find(array, entry->group) < 0)
+			remmina_string_array_add(array, entry->group);
 	}
-	g_dir_close(dir);
 	remmina_string_array_sort(array);
 	groups = remmina_string_array_to_string(array);
 	remmina_string_array_free(array);
-	g_free(remmina_data_dir);
 	return groups;
 }
 
@@ -276,33 +546,17 @@ static void remmina_file_manager_add_group(GNode *node, const gchar *group)
 GNode *remmina_file_manager_get_group_tree(void)
 {
 	TRACE_CALL(__func__);
-	gchar filename[MAX_PATH_LEN];
-	GDir *dir;
-	g_autofree gchar *datadir = NULL;
-	const gchar *name;
-	RemminaFile *remminafile;
-	const gchar *group;
+	RemminaFileIndexEntry *entry;
+	GHashTableIter iter;
 	GNode *root;
 
 	root = g_node_new(NULL);
 
-	datadir = g_strdup(remmina_file_get_datadir());
-	dir = g_dir_open(datadir, 0, NULL);
+	remmina_file_manager_index_update();
 
-	if (dir == NULL)
-		return root;
-	while ((name = g_dir_read_name(dir)) != NULL) {
-		if (!g_str_has_suffix(name, ".remmina"))
-			continue;
-		g_snprintf(filename, MAX_PATH_LEN, "%s/%s", datadir, name);
-		remminafile = remmina_file_load(filename);
-		if (remminafile) {
-			group = remmina_file_get_string(remminafile, "group");
-			remmina_file_manager_add_group(root, group);
-			remmina_file_free(remminafile);
-		}
-	}
-	g_dir_close(dir);
+	g_hash_table_iter_init(&iter, index_entries);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry))
+		remmina_file_manager_add_group(root, entry->group);
 	return root;
 }
 
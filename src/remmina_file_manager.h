@@ -45,11 +45,33 @@ typedef struct _RemminaGroupData {
 	gchar * datetime;
 } RemminaGroupData;
 
+/* List columns of a profile, kept in the profile index. Only valid during
+ * the remmina_file_manager_iterate_index() callback */
+typedef struct _RemminaFileIndexEntry {
+	gchar *		filename;
+	gchar *		name;
+	gchar *		group;
+	gchar *		server;
+	gchar *		protocol;
+	const gchar *	icon_name;
+	/* Last modification, which is also the last time the profile was used */
+	gchar *		datetime;
+
+	gboolean	ssh_tunnel_enabled;
+	guint64		mtime;
+	guint64		size;
+} RemminaFileIndexEntry;
+
 /* Initialize */
 gchar *remmina_file_get_datadir(void);
 void remmina_file_manager_init(void);
 /* Iterate all .remmina connections in the home directory */
 gint remmina_file_manager_iterate(GFunc func, gpointer user_data);
+/* Iterate the profile index, func gets a RemminaFileIndexEntry. Only the
+ * profiles changed since the previous call are parsed again */
+gint remmina_file_manager_iterate_index(GFunc func, gpointer user_data);
+/* Tell the index that a profile was written or deleted, can be called from any thread */
+void remmina_file_manager_index_invalidate(const gchar *filename);
 /* Get a list of groups */
 gchar *remmina_file_manager_get_groups(void);
 GNode *remmina_file_manager_get_group_tree(void);
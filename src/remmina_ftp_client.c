@@ -152,6 +152,28 @@ struct _RemminaFTPClientPriv {
 	gboolean sensitive;
 	gboolean overwrite_all;
 	gboolean resume_all;
+
+	/* Highest task id handed out by remmina_ftp_client_take_new_tasks() */
+	gint last_taskid;
+
+	/* Progress records of the running tasks, refreshed by progress_timer */
+	GSList *progress_list;
+	guint progress_timer;
+};
+
+/* Refresh rate of the progress shown in the task list */
+#define REMMINA_FTP_CLIENT_PROGRESS_INTERVAL 100
+
+struct _RemminaFTPTaskProgress {
+	/* One reference for the task, one for the progress list */
+	gint ref_count;
+	/* Written by the transfer thread, read by the timer */
+	guint64 size;
+	guint64 donesize;
+	/* Main thread only */
+	GtkTreeRowReference *rowref;
+	guint64 shown_size;
+	guint64 shown_donesize;
 };
 
 static gint remmina_ftp_client_taskid = 1;
@@ -180,10 +202,74 @@ static void remmina_ftp_client_class_init(RemminaFTPClientClass *klass)
 		remmina_marshal_BOOLEAN__INT_STRING, G_TYPE_BOOLEAN, 2, G_TYPE_INT, G_TYPE_STRING);
 }
 
+static void remmina_ftp_client_progress_unref(RemminaFTPTaskProgress *progress)
+{
+	TRACE_CALL(__func__);
+	if (g_atomic_int_dec_and_test(&progress->ref_count))
+		g_free(progress);
+}
+
+/* Called on the main thread when the record leaves the progress list */
+static void remmina_ftp_client_progress_drop(RemminaFTPTaskProgress *progress)
+{
+	TRACE_CALL(__func__);
+	gtk_tree_row_reference_free(progress->rowref);
+	progress->rowref = NULL;
+	remmina_ftp_client_progress_unref(progress);
+}
+
+static gboolean remmina_ftp_client_progress_timer(RemminaFTPClient *client)
+{
+	TRACE_CALL(__func__);
+	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*)client->priv;
+	RemminaFTPTaskProgress *progress;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	GSList *l, *next;
+	guint64 size, donesize;
+	gboolean done;
+
+	for (l = priv->progress_list; l; l = next) {
+		next = l->next;
+		progress = (RemminaFTPTaskProgress*)l->data;
+
+		/* Only the list still holds the record once the task has been freed */
+		done = g_atomic_int_get(&progress->ref_count) == 1;
+		size = __atomic_load_n(&progress->size, __ATOMIC_RELAXED);
+		donesize = __atomic_load_n(&progress->donesize, __ATOMIC_RELAXED);
+
+		if (size != progress->shown_size || donesize != progress->shown_donesize) {
+			path = gtk_tree_row_reference_get_path(progress->rowref);
+			if (path) {
+				gtk_tree_model_get_iter(priv->task_list_model, &iter, path);
+				gtk_tree_path_free(path);
+				gtk_list_store_set(GTK_LIST_STORE(priv->task_list_model), &iter,
+					REMMINA_FTP_TASK_COLUMN_SIZE, (gfloat)size,
+					REMMINA_FTP_TASK_COLUMN_DONESIZE, (gfloat)donesize, -1);
+			}
+			progress->shown_size = size;
+			progress->shown_donesize = donesize;
+		}
+
+		if (done) {
+			priv->progress_list = g_slist_delete_link(priv->progress_list, l);
+			remmina_ftp_client_progress_drop(progress);
+		}
+	}
+
+	if (priv->progress_list)
+		return G_SOURCE_CONTINUE;
+	priv->progress_timer = 0;
+	return G_SOURCE_REMOVE;
+}
+
 static void remmina_ftp_client_destroy(RemminaFTPClient *client, gpointer data)
 {
 	TRACE_CALL(__func__);
 	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*)client->priv;
+	if (priv->progress_timer)
+		g_source_remove(priv->progress_timer);
+	g_slist_free_full(priv->progress_list, (GDestroyNotify)remmina_ftp_client_progress_drop);
 	g_free(priv->current_directory);
 	g_free(priv->working_directory);
 	g_free(priv);
@@ -1151,49 +1237,67 @@ remmina_ftp_client_get_dir(RemminaFTPClient *client)
 	return g_strdup(priv->current_directory);
 }
 
-RemminaFTPTask*
-remmina_ftp_client_get_waiting_task(RemminaFTPClient *client)
+/* Build the task of a row and start tracking its progress */
+static RemminaFTPTask* remmina_ftp_client_task_new_from_iter(RemminaFTPClient *client, GtkTreeIter *iter)
 {
 	TRACE_CALL(__func__);
 	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*)client->priv;
 	GtkTreePath *path;
-	GtkTreeIter iter;
-	RemminaFTPTask task;
+	RemminaFTPTask *task;
+
+	task = g_new0(RemminaFTPTask, 1);
+	gtk_tree_model_get(priv->task_list_model, iter, REMMINA_FTP_TASK_COLUMN_TYPE, &task->type,
+		REMMINA_FTP_TASK_COLUMN_NAME, &task->name, REMMINA_FTP_TASK_COLUMN_SIZE, &task->size,
+		REMMINA_FTP_TASK_COLUMN_TASKID, &task->taskid, REMMINA_FTP_TASK_COLUMN_TASKTYPE, &task->tasktype,
+		REMMINA_FTP_TASK_COLUMN_REMOTEDIR, &task->remotedir, REMMINA_FTP_TASK_COLUMN_LOCALDIR,
+		&task->localdir, REMMINA_FTP_TASK_COLUMN_STATUS, &task->status, REMMINA_FTP_TASK_COLUMN_DONESIZE,
+		&task->donesize, REMMINA_FTP_TASK_COLUMN_TOOLTIP, &task->tooltip, -1);
+
+	path = gtk_tree_model_get_path(priv->task_list_model, iter);
+	task->rowref = gtk_tree_row_reference_new(priv->task_list_model, path);
+	gtk_tree_path_free(path);
 
-	if ( !remmina_masterthread_exec_is_main_thread() ) {
-		/* Allow the execution of this function from a non main thread */
-		RemminaMTExecData *d;
-		RemminaFTPTask* retval;
-		d = (RemminaMTExecData*)g_malloc( sizeof(RemminaMTExecData) );
-		d->func = FUNC_FTP_CLIENT_GET_WAITING_TASK;
-		d->p.ftp_client_get_waiting_task.client = client;
-		remmina_masterthread_exec_and_wait(d);
-		retval = d->p.ftp_client_get_waiting_task.retval;
-		g_free(d);
-		return retval;
-	}
+	task->progress = g_new0(RemminaFTPTaskProgress, 1);
+	task->progress->ref_count = 2;
+	task->progress->rowref = gtk_tree_row_reference_copy(task->rowref);
+	task->progress->size = task->progress->shown_size = (guint64)task->size;
+	task->progress->donesize = task->progress->shown_donesize = (guint64)task->donesize;
+	priv->progress_list = g_slist_prepend(priv->progress_list, task->progress);
+	if (!priv->progress_timer)
+		priv->progress_timer = g_timeout_add(REMMINA_FTP_CLIENT_PROGRESS_INTERVAL,
+			(GSourceFunc)remmina_ftp_client_progress_timer, client);
+
+	return task;
+}
+
+GList*
+remmina_ftp_client_take_new_tasks(RemminaFTPClient *client)
+{
+	TRACE_CALL(__func__);
+	RemminaFTPClientPriv *priv = (RemminaFTPClientPriv*)client->priv;
+	GtkTreeIter iter;
+	GList *tasks = NULL;
+	gint n, taskid, status, last_taskid;
 
-	if (!gtk_tree_model_get_iter_first(priv->task_list_model, &iter))
+	/* New tasks are appended with growing ids: walk back from the end
+	 * of the list down to the last task already handed out */
+	n = gtk_tree_model_iter_n_children(priv->task_list_model, NULL);
+	if (n == 0 || !gtk_tree_model_iter_nth_child(priv->task_list_model, &iter, NULL, n - 1))
 		return NULL;
 
-	while (1) {
-		gtk_tree_model_get(priv->task_list_model, &iter, REMMINA_FTP_TASK_COLUMN_TYPE, &task.type,
-			REMMINA_FTP_TASK_COLUMN_NAME, &task.name, REMMINA_FTP_TASK_COLUMN_SIZE, &task.size,
-			REMMINA_FTP_TASK_COLUMN_TASKID, &task.taskid, REMMINA_FTP_TASK_COLUMN_TASKTYPE, &task.tasktype,
-			REMMINA_FTP_TASK_COLUMN_REMOTEDIR, &task.remotedir, REMMINA_FTP_TASK_COLUMN_LOCALDIR,
-			&task.localdir, REMMINA_FTP_TASK_COLUMN_STATUS, &task.status, REMMINA_FTP_TASK_COLUMN_DONESIZE,
-			&task.donesize, REMMINA_FTP_TASK_COLUMN_TOOLTIP, &task.tooltip, -1);
-		if (task.status == REMMINA_FTP_TASK_STATUS_WAIT) {
-			path = gtk_tree_model_get_path(priv->task_list_model, &iter);
-			task.rowref = gtk_tree_row_reference_new(priv->task_list_model, path);
-			gtk_tree_path_free(path);
-			return (RemminaFTPTask*)g_memdup(&task, sizeof(RemminaFTPTask));
-		}
-		if (!gtk_tree_model_iter_next(priv->task_list_model, &iter))
+	last_taskid = priv->last_taskid;
+	do {
+		gtk_tree_model_get(priv->task_list_model, &iter, REMMINA_FTP_TASK_COLUMN_TASKID, &taskid,
+			REMMINA_FTP_TASK_COLUMN_STATUS, &status, -1);
+		if (taskid <= priv->last_taskid)
 			break;
-	}
+		last_taskid = MAX(last_taskid, taskid);
+		if (status == REMMINA_FTP_TASK_STATUS_WAIT)
+			tasks = g_list_prepend(tasks, remmina_ftp_client_task_new_from_iter(client, &iter));
+	} while (gtk_tree_model_iter_previous(priv->task_list_model, &iter));
+	priv->last_taskid = last_taskid;
 
-	return NULL;
+	return tasks;
 }
 
 void remmina_ftp_client_update_task(RemminaFTPClient *client, RemminaFTPTask* task)
@@ -1225,6 +1329,21 @@ void remmina_ftp_client_update_task(RemminaFTPClient *client, RemminaFTPTask* ta
 	gtk_tree_path_free(path);
 	gtk_list_store_set(store, &iter, REMMINA_FTP_TASK_COLUMN_SIZE, task->size, REMMINA_FTP_TASK_COLUMN_STATUS, task->status,
 		REMMINA_FTP_TASK_COLUMN_DONESIZE, task->donesize, REMMINA_FTP_TASK_COLUMN_TOOLTIP, task->tooltip, -1);
+	if (task->progress) {
+		/* The row is up to date, the timer has nothing to refresh */
+		remmina_ftp_client_set_task_progress(task);
+		task->progress->shown_size = (guint64)task->size;
+		task->progress->shown_donesize = (guint64)task->donesize;
+	}
+}
+
+void remmina_ftp_client_set_task_progress(RemminaFTPTask *task)
+{
+	TRACE_CALL(__func__);
+	if (!task->progress)
+		return;
+	__atomic_store_n(&task->progress->size, (guint64)task->size, __ATOMIC_RELAXED);
+	__atomic_store_n(&task->progress->donesize, (guint64)task->donesize, __ATOMIC_RELAXED);
 }
 
 void remmina_ftp_task_free(RemminaFTPTask *task)
@@ -1235,6 +1354,8 @@ void remmina_ftp_task_free(RemminaFTPTask *task)
 		g_free(task->remotedir);
 		g_free(task->localdir);
 		g_free(task->tooltip);
+		if (task->progress)
+			remmina_ftp_client_progress_unref(task->progress);
 		g_free(task);
 	}
 }
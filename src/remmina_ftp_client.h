@@ -106,6 +106,10 @@ enum {
 	REMMINA_FTP_TASK_N_COLUMNS
 };
 
+/* Transfer progress of a running task, published by the transfer thread
+ * without locking and copied into the task list by a main thread timer */
+typedef struct _RemminaFTPTaskProgress RemminaFTPTaskProgress;
+
 typedef struct _RemminaFTPTask {
 	/* Read-only */
 	gint			type;
@@ -115,11 +119,14 @@ typedef struct _RemminaFTPTask {
 	gchar *			remotedir;
 	gchar *			localdir;
 	GtkTreeRowReference *	rowref;
+	RemminaFTPTaskProgress *progress;
 	/* Updatable */
 	gfloat			size;
 	gint			status;
 	gfloat			donesize;
 	gchar *			tooltip;
+	/* Set from the main thread to stop the transfer */
+	gint			cancelled;
 } RemminaFTPTask;
 
 GtkWidget *remmina_ftp_client_new(void);
@@ -135,10 +142,12 @@ void remmina_ftp_client_add_file(RemminaFTPClient *client, ...);
 void remmina_ftp_client_set_dir(RemminaFTPClient *client, const gchar *dir);
 /* Get the current directory as newly allocated string */
 gchar *remmina_ftp_client_get_dir(RemminaFTPClient *client);
-/* Get the next waiting task */
-RemminaFTPTask *remmina_ftp_client_get_waiting_task(RemminaFTPClient *client);
+/* Hand out, in order, the waiting tasks added since the previous call. Main thread only */
+GList *remmina_ftp_client_take_new_tasks(RemminaFTPClient *client);
 /* Update the task */
 void remmina_ftp_client_update_task(RemminaFTPClient *client, RemminaFTPTask *task);
+/* Publish task->size and task->donesize, can be called from any thread without blocking */
+void remmina_ftp_client_set_task_progress(RemminaFTPTask *task);
 /* Free the RemminaFTPTask object */
 void remmina_ftp_task_free(RemminaFTPTask *task);
 /* Get/Set Set overwrite_all status */
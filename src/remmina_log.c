@@ -36,6 +36,7 @@
 
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
+#include <string.h>
 #include "remmina_public.h"
 #include "remmina_log.h"
 #include "remmina_stats_sender.h"
@@ -151,31 +152,148 @@ gboolean remmina_log_running(void)
 	return (log_window != NULL);
 }
 
-static gboolean remmina_log_scroll_to_end(gpointer data)
+/* Lines for the log window are queued from any thread in a bounded ring and
+ * appended to the GtkTextBuffer in batches, by a single idle on the main loop.
+ * Producers never take a lock: each slot carries a sequence number telling
+ * whether it is free for position pos (== pos), or filled (== pos + 1) */
+#define REMMINA_LOG_RING_SIZE 4096	/* Power of two */
+
+typedef struct _RemminaLogRingSlot {
+	guint	sequence;
+	gchar * line;
+} RemminaLogRingSlot;
+
+static RemminaLogRingSlot log_ring[REMMINA_LOG_RING_SIZE];
+static guint log_ring_head;		/* Next position to fill */
+static guint log_ring_tail;		/* Next position to flush, main thread only */
+static guint log_ring_dropped;
+static gint log_flush_scheduled;
+
+static void remmina_log_ring_init(void)
+{
+	TRACE_CALL(__func__);
+	static gsize initialized = 0;
+	guint i;
+
+	if (g_once_init_enter(&initialized)) {
+		for (i = 0; i < REMMINA_LOG_RING_SIZE; i++)
+			__atomic_store_n(&log_ring[i].sequence, i, __ATOMIC_RELAXED);
+		g_once_init_leave(&initialized, 1);
+	}
+}
+
+static gboolean remmina_log_ring_push(gchar *line)
+{
+	TRACE_CALL(__func__);
+	RemminaLogRingSlot *slot;
+	guint pos, seq;
+	gint diff;
+
+	remmina_log_ring_init();
+
+	pos = __atomic_load_n(&log_ring_head, __ATOMIC_RELAXED);
+	for (;;) {
+		slot = &log_ring[pos & (REMMINA_LOG_RING_SIZE - 1)];
+		seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		diff = (gint)(seq - pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&log_ring_head, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			/* Full, the main loop is not keeping up */
+			return FALSE;
+		} else {
+			pos = __atomic_load_n(&log_ring_head, __ATOMIC_RELAXED);
+		}
+	}
+	slot->line = line;
+	__atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+	return TRUE;
+}
+
+static gchar *remmina_log_ring_pop(void)
+{
+	TRACE_CALL(__func__);
+	RemminaLogRingSlot *slot;
+	gchar *line;
+
+	slot = &log_ring[log_ring_tail & (REMMINA_LOG_RING_SIZE - 1)];
+	if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != log_ring_tail + 1)
+		return NULL;
+	line = slot->line;
+	slot->line = NULL;
+	__atomic_store_n(&slot->sequence, log_ring_tail + REMMINA_LOG_RING_SIZE, __ATOMIC_RELEASE);
+	log_ring_tail++;
+	return line;
+}
+
+static gboolean remmina_log_flush(gpointer data)
 {
 	TRACE_CALL(__func__);
 	GtkTextIter iter;
+	GString *text;
+	gchar *line;
+	guint dropped;
 
-	if (log_window) {
+	/* Lines pushed from now on need another flush */
+	__atomic_store_n(&log_flush_scheduled, 0, __ATOMIC_SEQ_CST);
+
+	text = g_string_new(NULL);
+	while ((line = remmina_log_ring_pop()) != NULL) {
+		g_string_append(text, line);
+		g_free(line);
+	}
+	dropped = __atomic_exchange_n(&log_ring_dropped, 0, __ATOMIC_RELAXED);
+	if (dropped > 0)
+		g_string_append_printf(text, "(LOG) - %u lines dropped\n", dropped);
+
+	if (log_window && text->len > 0) {
+		gtk_text_buffer_get_end_iter(REMMINA_LOG_WINDOW(log_window)->log_buffer, &iter);
+		gtk_text_buffer_insert(REMMINA_LOG_WINDOW(log_window)->log_buffer, &iter, text->str, text->len);
 		gtk_text_buffer_get_end_iter(REMMINA_LOG_WINDOW(log_window)->log_buffer, &iter);
 		gtk_text_view_scroll_to_iter(GTK_TEXT_VIEW(REMMINA_LOG_WINDOW(log_window)->log_view), &iter, 0.0, FALSE, 0.0,
 			0.0);
 	}
+	g_string_free(text, TRUE);
 	return FALSE;
 }
 
-static gboolean remmina_log_print_real(gpointer data)
+/* Queue a line for the log window, taking ownership of it */
+static void remmina_log_append(gchar *line)
 {
 	TRACE_CALL(__func__);
-	GtkTextIter iter;
 
-	if (log_window) {
-		gtk_text_buffer_get_end_iter(REMMINA_LOG_WINDOW(log_window)->log_buffer, &iter);
-		gtk_text_buffer_insert(REMMINA_LOG_WINDOW(log_window)->log_buffer, &iter, (const gchar*)data, -1);
-		IDLE_ADD(remmina_log_scroll_to_end, NULL);
+	if (!remmina_log_ring_push(line)) {
+		__atomic_add_fetch(&log_ring_dropped, 1, __ATOMIC_RELAXED);
+		g_free(line);
 	}
-	g_free(data);
-	return FALSE;
+	if (__atomic_exchange_n(&log_flush_scheduled, 1, __ATOMIC_SEQ_CST) == 0)
+		IDLE_ADD(remmina_log_flush, NULL);
+}
+
+/* Whether a message of this level goes anywhere. Checked before formatting
+ * it, so that disabled debug messages cost nothing */
+static gboolean remmina_log_enabled(GLogLevelFlags log_level)
+{
+	TRACE_CALL(__func__);
+#if !GLIB_CHECK_VERSION(2, 68, 0)
+	static gsize debug_enabled = 0;
+	const gchar *domains;
+#endif
+
+	if (log_window)
+		return TRUE;
+#if GLIB_CHECK_VERSION(2, 68, 0)
+	return !g_log_writer_default_would_drop(log_level, G_LOG_DOMAIN);
+#else
+	if (log_level & ~(G_LOG_LEVEL_INFO | G_LOG_LEVEL_DEBUG))
+		return TRUE;
+	if (g_once_init_enter(&debug_enabled)) {
+		domains = g_getenv("G_MESSAGES_DEBUG");
+		g_once_init_leave(&debug_enabled, domains && strstr(domains, "all") ? 2 : 1);
+	}
+	return debug_enabled == 2;
+#endif
 }
 
 // Only prints into Remmina's own debug window. (Not stdout!)
@@ -186,13 +304,16 @@ void remmina_log_print(const gchar *text)
 	if (!log_window)
 		return;
 
-	IDLE_ADD(remmina_log_print_real, g_strdup(text));
+	remmina_log_append(g_strdup(text));
 }
 
 void _remmina_info(const gchar *fmt, ...)
 {
 	TRACE_CALL(__func__);
 
+	if (!remmina_log_enabled(G_LOG_LEVEL_INFO))
+		return;
+
 	va_list args;
 	g_autofree gchar *text;
 	va_start(args, fmt);
@@ -202,15 +323,11 @@ void _remmina_info(const gchar *fmt, ...)
 	// always appends newline
 	g_info ("%s", text);
 
-	g_autofree gchar *buf_tmp = g_strconcat(text, "\n", NULL);
-	/* freed in remmina_log_print_real */
-	gchar *bufn = g_strconcat("(INFO) - ", buf_tmp, NULL);
-
 	if (!log_window) {
-		free(bufn);
 		return;
 	}
-	IDLE_ADD(remmina_log_print_real, bufn);
+
+	remmina_log_append(g_strconcat("(INFO) - ", text, "\n", NULL));
 }
 
 void _remmina_message(const gchar *fmt, ...)
@@ -230,11 +347,7 @@ void _remmina_message(const gchar *fmt, ...)
 		return;
 	}
 
-	g_autofree gchar *buf_tmp = g_strconcat(text, "\n", NULL);
-	/* freed in remmina_log_print_real */
-	gchar *bufn = g_strconcat("(MESSAGE) - ", buf_tmp, NULL);
-
-	IDLE_ADD(remmina_log_print_real, bufn);
+	remmina_log_append(g_strconcat("(MESSAGE) - ", text, "\n", NULL));
 }
 
 /**
@@ -246,6 +359,9 @@ void _remmina_debug(const gchar *fun, const gchar *fmt, ...)
 {
 	TRACE_CALL(__func__);
 
+	if (!remmina_log_enabled(G_LOG_LEVEL_DEBUG))
+		return;
+
 	va_list args;
 	gchar *text;
 	va_start(args, fmt);
@@ -262,11 +378,7 @@ void _remmina_debug(const gchar *fun, const gchar *fmt, ...)
 		return;
 	}
 
-	g_autofree gchar *buf_tmp = g_strconcat(buf, "\n", NULL);
-	/* freed in remmina_log_print_real */
-	gchar *bufn = g_strconcat("(DEBUG) - ", buf_tmp, NULL);
-
-	IDLE_ADD(remmina_log_print_real, bufn);
+	remmina_log_append(g_strconcat("(DEBUG) - ", buf, "\n", NULL));
 }
 
 void _remmina_warning(const gchar *fun, const gchar *fmt, ...)
@@ -289,11 +401,7 @@ void _remmina_warning(const gchar *fun, const gchar *fmt, ...)
 		return;
 	}
 
-	g_autofree gchar *buf_tmp = g_strconcat(buf, "\n", NULL);
-	/* freed in remmina_log_print_real */
-	gchar *bufn = g_strconcat("(WARN) - ", buf_tmp, NULL);
-
-	IDLE_ADD(remmina_log_print_real, bufn);
+	remmina_log_append(g_strconcat("(WARN) - ", buf, "\n", NULL));
 }
 
 // !!! Calling this function will crash Remmina !!!
@@ -318,11 +426,7 @@ void _remmina_error(const gchar *fun, const gchar *fmt, ...)
 		return;
 	}
 
-	g_autofree gchar *buf_tmp = g_strconcat(buf, "\n", NULL);
-	/* freed in remmina_log_print_real */
-	gchar *bufn = g_strconcat("(ERROR) - ", buf_tmp, NULL);
-
-	IDLE_ADD(remmina_log_print_real, bufn);
+	remmina_log_append(g_strconcat("(ERROR) - ", buf, "\n", NULL));
 }
 
 void _remmina_critical(const gchar *fun, const gchar *fmt, ...)
@@ -345,11 +449,7 @@ void _remmina_critical(const gchar *fun, const gchar *fmt, ...)
 		return;
 	}
 
-	g_autofree gchar *buf_tmp = g_strconcat(buf, "\n", NULL);
-	/* freed in remmina_log_print_real */
-	gchar *bufn = g_strconcat("(CRIT) - ", buf_tmp, NULL);
-
-	IDLE_ADD(remmina_log_print_real, bufn);
+	remmina_log_append(g_strconcat("(CRIT) - ", buf, "\n", NULL));
 }
 
 // Only prints into Remmina's own debug window. (Not stdout!)
@@ -366,5 +466,5 @@ void remmina_log_printf(const gchar *fmt, ...)
 	text = g_strdup_vprintf(fmt, args);
 	va_end(args);
 
-	IDLE_ADD(remmina_log_print_real, text);
+	remmina_log_append(text);
 }
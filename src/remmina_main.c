@@ -75,6 +75,8 @@ enum {
 	PLUGIN_COLUMN,
 	DATE_COLUMN,
 	FILENAME_COLUMN,
+	/* Lowercase name, group, server, plugin and date, owned by RemminaMainFileRow */
+	SEARCH_COLUMN,
 	N_COLUMNS
 };
 
@@ -196,11 +198,16 @@ void remmina_main_destroy()
 		g_object_unref(remminamain->builder);
 		remmina_string_array_free(remminamain->priv->expanded_group);
 		remminamain->priv->expanded_group = NULL;
+		g_hash_table_destroy(remminamain->priv->file_rows);
+		g_hash_table_destroy(remminamain->priv->group_rows);
+		if (remminamain->priv->file_model_sort)
+			g_object_unref(G_OBJECT(remminamain->priv->file_model_sort));
 		if (remminamain->priv->file_model)
 			g_object_unref(G_OBJECT(remminamain->priv->file_model));
 		g_object_unref(G_OBJECT(remminamain->priv->file_model_filter));
 		g_free(remminamain->priv->selected_filename);
 		g_free(remminamain->priv->selected_name);
+		g_free(remminamain->priv->search_text);
 		g_free(remminamain->priv);
 		g_free(remminamain);
 		remminamain = NULL;
@@ -346,62 +353,243 @@ static gboolean remmina_main_selection_func(GtkTreeSelection *selection, GtkTree
 	return TRUE;
 }
 
-static void remmina_main_load_file_list_callback(RemminaFile *remminafile, gpointer user_data)
+/* A profile row of file_model */
+typedef struct _RemminaMainFileRow {
+	GtkTreeRowReference *	rowref;
+	/* What the row shows, to skip the unchanged profiles */
+	guint64			mtime;
+	guint64			size;
+	const gchar *		icon_name;
+	gchar *			search_key;
+} RemminaMainFileRow;
+
+static void remmina_main_file_row_free(RemminaMainFileRow *row)
 {
 	TRACE_CALL(__func__);
-	GtkTreeIter iter;
-	GtkListStore *store;
-	store = GTK_LIST_STORE(user_data);
-	gchar *datetime;
-
-	datetime = remmina_file_get_datetime(remminafile);
-	gtk_list_store_append(store, &iter);
-	gtk_list_store_set(store, &iter,
-			   PROTOCOL_COLUMN, remmina_file_get_icon_name(remminafile),
-			   NAME_COLUMN, remmina_file_get_string(remminafile, "name"),
-			   GROUP_COLUMN, remmina_file_get_string(remminafile, "group"),
-			   SERVER_COLUMN, remmina_file_get_string(remminafile, "server"),
-			   PLUGIN_COLUMN, remmina_file_get_string(remminafile, "protocol"),
-			   DATE_COLUMN, datetime,
-			   FILENAME_COLUMN, remmina_file_get_filename(remminafile),
-			   -1);
-	g_free(datetime);
+	gtk_tree_row_reference_free(row->rowref);
+	g_free(row->search_key);
+	g_free(row);
+}
+
+/* The fields matched by the quick search, one per line so that a match
+ * never spans two of them */
+static gchar *remmina_main_file_row_search_key(RemminaFileIndexEntry *entry)
+{
+	TRACE_CALL(__func__);
+	gchar *key, *p;
+
+	key = g_strjoin("\n",
+			entry->name ? entry->name : "",
+			entry->group ? entry->group : "",
+			entry->server ? entry->server : "",
+			entry->protocol ? entry->protocol : "",
+			entry->datetime ? entry->datetime : "",
+			NULL);
+	for (p = key; *p; p++)
+		*p = g_ascii_tolower(*p);
+	return key;
+}
+
+static gboolean remmina_main_file_model_get_iter(GtkTreeRowReference *rowref, GtkTreeIter *iter)
+{
+	TRACE_CALL(__func__);
+	GtkTreePath *path;
+	gboolean ret;
+
+	path = gtk_tree_row_reference_get_path(rowref);
+	if (!path)
+		return FALSE;
+	ret = gtk_tree_model_get_iter(remminamain->priv->file_model, iter, path);
+	gtk_tree_path_free(path);
+	return ret;
 }
 
-static gboolean remmina_main_load_file_tree_traverse(GNode *node, GtkTreeStore *store, GtkTreeIter *parent)
+static void remmina_main_file_model_remove(GtkTreeIter *iter)
 {
 	TRACE_CALL(__func__);
-	GtkTreeIter *iter;
-	RemminaGroupData *data;
-	GNode *child;
+	if (GTK_IS_TREE_STORE(remminamain->priv->file_model))
+		gtk_tree_store_remove(GTK_TREE_STORE(remminamain->priv->file_model), iter);
+	else
+		gtk_list_store_remove(GTK_LIST_STORE(remminamain->priv->file_model), iter);
+}
 
-	iter = NULL;
-	if (node->data) {
-		data = (RemminaGroupData *)node->data;
-		iter = g_new0(GtkTreeIter, 1);
-		gtk_tree_store_append(store, iter, parent);
-		gtk_tree_store_set(store, iter,
-				   PROTOCOL_COLUMN, "folder-symbolic",
-				   NAME_COLUMN, data->name,
-				   GROUP_COLUMN, data->group,
-				   DATE_COLUMN, data->datetime,
-				   FILENAME_COLUMN, NULL,
+static GtkTreeRowReference *remmina_main_file_model_new_rowref(GtkTreeIter *iter)
+{
+	TRACE_CALL(__func__);
+	GtkTreeRowReference *rowref;
+	GtkTreePath *path;
+
+	path = gtk_tree_model_get_path(remminamain->priv->file_model, iter);
+	rowref = gtk_tree_row_reference_new(remminamain->priv->file_model, path);
+	gtk_tree_path_free(path);
+	return rowref;
+}
+
+/* Row of a group in tree mode, created with its parents when missing */
+static gboolean remmina_main_file_model_get_group(const gchar *group, GtkTreeIter *iter)
+{
+	TRACE_CALL(__func__);
+	GtkTreeStore *store = GTK_TREE_STORE(remminamain->priv->file_model);
+	GtkTreeRowReference *rowref;
+	GtkTreeIter parent;
+	gboolean has_parent;
+	const gchar *name;
+	gchar *parent_group;
+
+	if (group == NULL || group[0] == '\0')
+		return FALSE;
+
+	rowref = g_hash_table_lookup(remminamain->priv->group_rows, group);
+	if (rowref && remmina_main_file_model_get_iter(rowref, iter))
+		return TRUE;
+
+	name = strrchr(group, '/');
+	if (name) {
+		parent_group = g_strndup(group, name - group);
+		has_parent = remmina_main_file_model_get_group(parent_group, &parent);
+		g_free(parent_group);
+		name++;
+	} else {
+		has_parent = FALSE;
+		name = group;
+	}
+
+	gtk_tree_store_append(store, iter, has_parent ? &parent : NULL);
+	gtk_tree_store_set(store, iter,
+			   PROTOCOL_COLUMN, "folder-symbolic",
+			   NAME_COLUMN, name,
+			   GROUP_COLUMN, group,
+			   DATE_COLUMN, NULL,
+			   FILENAME_COLUMN, NULL,
+			   SEARCH_COLUMN, NULL,
+			   -1);
+	g_hash_table_replace(remminamain->priv->group_rows, g_strdup(group), remmina_main_file_model_new_rowref(iter));
+	return TRUE;
+}
+
+static void remmina_main_file_model_set(GtkTreeIter *iter, RemminaFileIndexEntry *entry, const gchar *search_key)
+{
+	TRACE_CALL(__func__);
+	if (GTK_IS_TREE_STORE(remminamain->priv->file_model))
+		gtk_tree_store_set(GTK_TREE_STORE(remminamain->priv->file_model), iter,
+				   PROTOCOL_COLUMN, entry->icon_name,
+				   NAME_COLUMN, entry->name,
+				   GROUP_COLUMN, entry->group,
+				   SERVER_COLUMN, entry->server,
+				   PLUGIN_COLUMN, entry->protocol,
+				   DATE_COLUMN, entry->datetime,
+				   FILENAME_COLUMN, entry->filename,
+				   SEARCH_COLUMN, search_key,
 				   -1);
+	else
+		gtk_list_store_set(GTK_LIST_STORE(remminamain->priv->file_model), iter,
+				   PROTOCOL_COLUMN, entry->icon_name,
+				   NAME_COLUMN, entry->name,
+				   GROUP_COLUMN, entry->group,
+				   SERVER_COLUMN, entry->server,
+				   PLUGIN_COLUMN, entry->protocol,
+				   DATE_COLUMN, entry->datetime,
+				   FILENAME_COLUMN, entry->filename,
+				   SEARCH_COLUMN, search_key,
+				   -1);
+}
+
+/* Add or refresh the row of one profile, seen collects the profiles still present */
+static void remmina_main_file_model_update_callback(RemminaFileIndexEntry *entry, GHashTable *seen)
+{
+	TRACE_CALL(__func__);
+	GtkTreeIter iter, parent;
+	RemminaMainFileRow *row;
+	gboolean tree, has_parent;
+	gchar *group, *search_key;
+
+	g_hash_table_add(seen, entry->filename);
+
+	tree = GTK_IS_TREE_STORE(remminamain->priv->file_model);
+	row = g_hash_table_lookup(remminamain->priv->file_rows, entry->filename);
+	if (row && remmina_main_file_model_get_iter(row->rowref, &iter)) {
+		if (row->mtime == entry->mtime && row->size == entry->size && row->icon_name == entry->icon_name)
+			return;
+		if (tree) {
+			/* A profile moved to another group is added again under the new one */
+			gtk_tree_model_get(remminamain->priv->file_model, &iter, GROUP_COLUMN, &group, -1);
+			if (g_strcmp0(group, entry->group) != 0) {
+				remmina_main_file_model_remove(&iter);
+				row = NULL;
+			}
+			g_free(group);
+		}
+	} else {
+		row = NULL;
 	}
-	for (child = g_node_first_child(node); child; child = g_node_next_sibling(child))
-		remmina_main_load_file_tree_traverse(child, store, iter);
-	g_free(iter);
-	return FALSE;
+
+	if (!row) {
+		if (tree) {
+			has_parent = remmina_main_file_model_get_group(entry->group, &parent);
+			gtk_tree_store_append(GTK_TREE_STORE(remminamain->priv->file_model), &iter, has_parent ? &parent : NULL);
+		} else {
+			gtk_list_store_append(GTK_LIST_STORE(remminamain->priv->file_model), &iter);
+		}
+		row = g_new0(RemminaMainFileRow, 1);
+		row->rowref = remmina_main_file_model_new_rowref(&iter);
+		g_hash_table_replace(remminamain->priv->file_rows, g_strdup(entry->filename), row);
+	}
+
+	search_key = remmina_main_file_row_search_key(entry);
+	remmina_main_file_model_set(&iter, entry, search_key);
+	g_free(row->search_key);
+	row->search_key = search_key;
+	row->mtime = entry->mtime;
+	row->size = entry->size;
+	row->icon_name = entry->icon_name;
 }
 
-static void remmina_main_load_file_tree_group(GtkTreeStore *store)
+static gboolean remmina_main_file_model_prune_file(gchar *filename, RemminaMainFileRow *row, GHashTable *seen)
 {
 	TRACE_CALL(__func__);
-	GNode *root;
+	GtkTreeIter iter;
 
-	root = remmina_file_manager_get_group_tree();
-	remmina_main_load_file_tree_traverse(root, store, NULL);
-	remmina_file_manager_free_group_tree(root);
+	if (g_hash_table_contains(seen, filename))
+		return FALSE;
+	if (remmina_main_file_model_get_iter(row->rowref, &iter))
+		remmina_main_file_model_remove(&iter);
+	return TRUE;
+}
+
+static gboolean remmina_main_file_model_prune_group(gchar *group, GtkTreeRowReference *rowref, gboolean *removed)
+{
+	TRACE_CALL(__func__);
+	GtkTreeIter iter;
+
+	if (!remmina_main_file_model_get_iter(rowref, &iter))
+		return TRUE;
+	if (gtk_tree_model_iter_has_child(remminamain->priv->file_model, &iter))
+		return FALSE;
+	remmina_main_file_model_remove(&iter);
+	*removed = TRUE;
+	return TRUE;
+}
+
+/* Apply the changes of the profile index to file_model, returns the number of profiles */
+static gint remmina_main_file_model_update(void)
+{
+	TRACE_CALL(__func__);
+	GHashTable *seen;
+	gboolean removed;
+	gint items_count;
+
+	seen = g_hash_table_new(g_str_hash, g_str_equal);
+	items_count = remmina_file_manager_iterate_index((GFunc)remmina_main_file_model_update_callback, seen);
+	g_hash_table_foreach_remove(remminamain->priv->file_rows, (GHRFunc)remmina_main_file_model_prune_file, seen);
+	g_hash_table_destroy(seen);
+
+	/* Drop the groups left empty, one level at a time */
+	do {
+		removed = FALSE;
+		g_hash_table_foreach_remove(remminamain->priv->group_rows, (GHRFunc)remmina_main_file_model_prune_group, &removed);
+	} while (removed);
+
+	return items_count;
 }
 
 static void remmina_main_expand_group_traverse(GtkTreeIter *iter)
@@ -442,63 +630,6 @@ static void remmina_main_expand_group(void)
 		remmina_main_expand_group_traverse(&iter);
 }
 
-static gboolean remmina_main_load_file_tree_find(GtkTreeModel *tree, GtkTreeIter *iter, const gchar *match_group)
-{
-	TRACE_CALL(__func__);
-	gboolean ret, match;
-	gchar *group, *filename;
-	GtkTreeIter child;
-
-	match = FALSE;
-	ret = TRUE;
-	while (ret) {
-		gtk_tree_model_get(tree, iter, GROUP_COLUMN, &group, FILENAME_COLUMN, &filename, -1);
-		match = (filename == NULL && g_strcmp0(group, match_group) == 0);
-		g_free(group);
-		g_free(filename);
-		if (match)
-			break;
-		if (gtk_tree_model_iter_children(tree, &child, iter)) {
-			match = remmina_main_load_file_tree_find(tree, &child, match_group);
-			if (match) {
-				memcpy(iter, &child, sizeof(GtkTreeIter));
-				break;
-			}
-		}
-		ret = gtk_tree_model_iter_next(tree, iter);
-	}
-	return match;
-}
-
-static void remmina_main_load_file_tree_callback(RemminaFile *remminafile, gpointer user_data)
-{
-	TRACE_CALL(__func__);
-	GtkTreeIter iter, child;
-	GtkTreeStore *store;
-	gboolean found;
-	gchar *datetime;
-
-	store = GTK_TREE_STORE(user_data);
-
-	found = FALSE;
-	if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(store), &iter))
-		found = remmina_main_load_file_tree_find(GTK_TREE_MODEL(store), &iter,
-							 remmina_file_get_string(remminafile, "group"));
-
-	datetime = remmina_file_get_datetime(remminafile);
-	gtk_tree_store_append(store, &child, (found ? &iter : NULL));
-	gtk_tree_store_set(store, &child,
-			   PROTOCOL_COLUMN, remmina_file_get_icon_name(remminafile),
-			   NAME_COLUMN, remmina_file_get_string(remminafile, "name"),
-			   GROUP_COLUMN, remmina_file_get_string(remminafile, "group"),
-			   SERVER_COLUMN, remmina_file_get_string(remminafile, "server"),
-			   PLUGIN_COLUMN, remmina_file_get_string(remminafile, "protocol"),
-			   DATE_COLUMN, datetime,
-			   FILENAME_COLUMN, remmina_file_get_filename(remminafile),
-			   -1);
-	g_free(datetime);
-}
-
 static void remmina_main_file_model_on_sort(GtkTreeSortable *sortable, gpointer user_data)
 {
 	TRACE_CALL(__func__);
@@ -514,47 +645,18 @@ static void remmina_main_file_model_on_sort(GtkTreeSortable *sortable, gpointer
 static gboolean remmina_main_filter_visible_func(GtkTreeModel *model, GtkTreeIter *iter, gpointer user_data)
 {
 	TRACE_CALL(__func__);
-	gchar *text;
-	gchar *protocol, *name, *group, *server, *plugin, *date, *s;
-	gboolean result = TRUE;
+	const gchar *text = remminamain->priv->search_text;
+	const gchar *search_key;
 
-	text = g_ascii_strdown(gtk_entry_get_text(remminamain->entry_quick_connect_server), -1);
-	if (text && text[0]) {
-		gtk_tree_model_get(model, iter,
-				   PROTOCOL_COLUMN, &protocol,
-				   NAME_COLUMN, &name,
-				   GROUP_COLUMN, &group,
-				   SERVER_COLUMN, &server,
-				   PLUGIN_COLUMN, &plugin,
-				   DATE_COLUMN, &date,
-				   -1);
-		if (g_strcmp0(protocol, "folder-symbolic") != 0) {
-			s = g_ascii_strdown(name ? name : "", -1);
-			g_free(name);
-			name = s;
-			s = g_ascii_strdown(group ? group : "", -1);
-			g_free(group);
-			group = s;
-			s = g_ascii_strdown(server ? server : "", -1);
-			g_free(server);
-			server = s;
-			s = g_ascii_strdown(plugin ? plugin : "", -1);
-			g_free(plugin);
-			plugin = s;
-			s = g_ascii_strdown(date ? date : "", -1);
-			g_free(date);
-			date = s;
-			result = (strstr(name, text) || strstr(group, text) || strstr(server, text) || strstr(plugin, text) || strstr(date, text));
-		}
-		g_free(protocol);
-		g_free(name);
-		g_free(group);
-		g_free(server);
-		g_free(plugin);
-		g_free(date);
-	}
-	g_free(text);
-	return result;
+	if (!text || !text[0])
+		return TRUE;
+
+	/* A pointer column, nothing is copied or allocated per row */
+	gtk_tree_model_get(model, iter, SEARCH_COLUMN, &search_key, -1);
+	/* Folders have no search key and stay visible */
+	if (!search_key)
+		return TRUE;
+	return strstr(search_key, text) != NULL;
 }
 
 static void remmina_main_select_file(const gchar *filename)
@@ -594,9 +696,7 @@ static void remmina_main_load_files()
 	gint view_file_mode;
 	char *save_selected_filename;
 	GtkTreeModel *newmodel;
-
-	save_selected_filename = g_strdup(remminamain->priv->selected_filename);
-	remmina_main_save_expanded_group();
+	gboolean rebuild;
 
 	view_file_mode = remmina_pref.view_file_mode;
 	if (remminamain->priv->override_view_file_mode_to_list)
@@ -612,51 +712,71 @@ static void remmina_main_load_files()
 		break;
 	}
 
-	switch (view_file_mode) {
-	case REMMINA_VIEW_FILE_TREE:
-		/* Create new GtkTreeStore model */
-		newmodel = GTK_TREE_MODEL(gtk_tree_store_new(7, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING));
-		/* Hide the Group column in the tree view mode */
-		gtk_tree_view_column_set_visible(remminamain->column_files_list_group, FALSE);
-		/* Load groups first */
-		remmina_main_load_file_tree_group(GTK_TREE_STORE(newmodel));
-		/* Load files list */
-		items_count = remmina_file_manager_iterate((GFunc)remmina_main_load_file_tree_callback, (gpointer)newmodel);
-		break;
+	/* The model is only rebuilt when the view mode changes, otherwise the
+	 * changed rows are updated in place, keeping selection, expanded groups
+	 * and scroll position */
+	if (view_file_mode == REMMINA_VIEW_FILE_TREE)
+		rebuild = !GTK_IS_TREE_STORE(remminamain->priv->file_model);
+	else
+		rebuild = !GTK_IS_LIST_STORE(remminamain->priv->file_model);
 
-	case REMMINA_VIEW_FILE_LIST:
-	default:
-		/* Create new GtkListStore model */
-		newmodel = GTK_TREE_MODEL(gtk_list_store_new(7, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING));
-		/* Show the Group column in the list view mode */
-		gtk_tree_view_column_set_visible(remminamain->column_files_list_group, TRUE);
-		/* Load files list */
-		items_count = remmina_file_manager_iterate((GFunc)remmina_main_load_file_list_callback, (gpointer)newmodel);
-		break;
-	}
+	if (!rebuild) {
+		items_count = remmina_main_file_model_update();
+	} else {
+		save_selected_filename = g_strdup(remminamain->priv->selected_filename);
+		remmina_main_save_expanded_group();
+
+		switch (view_file_mode) {
+		case REMMINA_VIEW_FILE_TREE:
+			/* Create new GtkTreeStore model */
+			newmodel = GTK_TREE_MODEL(gtk_tree_store_new(N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER));
+			/* Hide the Group column in the tree view mode */
+			gtk_tree_view_column_set_visible(remminamain->column_files_list_group, FALSE);
+			break;
 
-	/* Unset old model */
-	gtk_tree_view_set_model(remminamain->tree_files_list, NULL);
-
-	/* Destroy the old model and save the new one */
-	remminamain->priv->file_model = newmodel;
-
-	/* Create a sorted filtered model based on newmodel and apply it to the TreeView */
-	remminamain->priv->file_model_filter = gtk_tree_model_filter_new(remminamain->priv->file_model, NULL);
-	gtk_tree_model_filter_set_visible_func(GTK_TREE_MODEL_FILTER(remminamain->priv->file_model_filter),
-					       (GtkTreeModelFilterVisibleFunc)remmina_main_filter_visible_func, NULL, NULL);
-	remminamain->priv->file_model_sort = gtk_tree_model_sort_new_with_model(remminamain->priv->file_model_filter);
-	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(remminamain->priv->file_model_sort),
-					     remmina_pref.main_sort_column_id,
-					     remmina_pref.main_sort_order);
-	gtk_tree_view_set_model(remminamain->tree_files_list, remminamain->priv->file_model_sort);
-	g_signal_connect(G_OBJECT(remminamain->priv->file_model_sort), "sort-column-changed",
-			 G_CALLBACK(remmina_main_file_model_on_sort), NULL);
-	remmina_main_expand_group();
-	/* Select the file previously selected */
-	if (save_selected_filename) {
-		remmina_main_select_file(save_selected_filename);
-		g_free(save_selected_filename);
+		case REMMINA_VIEW_FILE_LIST:
+		default:
+			/* Create new GtkListStore model */
+			newmodel = GTK_TREE_MODEL(gtk_list_store_new(N_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER));
+			/* Show the Group column in the list view mode */
+			gtk_tree_view_column_set_visible(remminamain->column_files_list_group, TRUE);
+			break;
+		}
+
+		/* Unset old model */
+		gtk_tree_view_set_model(remminamain->tree_files_list, NULL);
+
+		/* Destroy the old model and save the new one */
+		g_hash_table_remove_all(remminamain->priv->file_rows);
+		g_hash_table_remove_all(remminamain->priv->group_rows);
+		if (remminamain->priv->file_model_sort)
+			g_object_unref(G_OBJECT(remminamain->priv->file_model_sort));
+		if (remminamain->priv->file_model_filter)
+			g_object_unref(G_OBJECT(remminamain->priv->file_model_filter));
+		if (remminamain->priv->file_model)
+			g_object_unref(G_OBJECT(remminamain->priv->file_model));
+		remminamain->priv->file_model = newmodel;
+
+		/* Load files list */
+		items_count = remmina_main_file_model_update();
+
+		/* Create a sorted filtered model based on newmodel and apply it to the TreeView */
+		remminamain->priv->file_model_filter = gtk_tree_model_filter_new(remminamain->priv->file_model, NULL);
+		gtk_tree_model_filter_set_visible_func(GTK_TREE_MODEL_FILTER(remminamain->priv->file_model_filter),
+						       (GtkTreeModelFilterVisibleFunc)remmina_main_filter_visible_func, NULL, NULL);
+		remminamain->priv->file_model_sort = gtk_tree_model_sort_new_with_model(remminamain->priv->file_model_filter);
+		gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(remminamain->priv->file_model_sort),
+						     remmina_pref.main_sort_column_id,
+						     remmina_pref.main_sort_order);
+		gtk_tree_view_set_model(remminamain->tree_files_list, remminamain->priv->file_model_sort);
+		g_signal_connect(G_OBJECT(remminamain->priv->file_model_sort), "sort-column-changed",
+				 G_CALLBACK(remmina_main_file_model_on_sort), NULL);
+		remmina_main_expand_group();
+		/* Select the file previously selected */
+		if (save_selected_filename) {
+			remmina_main_select_file(save_selected_filename);
+			g_free(save_selected_filename);
+		}
 	}
 	/* Show in the status bar the total number of connections found */
 	g_snprintf(buf, sizeof(buf), ngettext("Total %i item.", "Total %i items.", items_count), items_count);
@@ -1272,6 +1392,10 @@ void remmina_main_quick_search_on_icon_press(GtkEntry *entry, GtkEntryIconPositi
 void remmina_main_quick_search_on_changed(GtkEditable *editable, gpointer user_data)
 {
 	TRACE_CALL(__func__);
+	/* Lowercased once here instead of once per row in the filter */
+	g_free(remminamain->priv->search_text);
+	remminamain->priv->search_text = g_ascii_strdown(gtk_entry_get_text(remminamain->entry_quick_connect_server), -1);
+
 	/* If a search text was input then temporary set the file mode to list */
 	if (gtk_entry_get_text_length(remminamain->entry_quick_connect_server)) {
 		if (GTK_IS_TREE_STORE(remminamain->priv->file_model)) {
@@ -1360,7 +1484,7 @@ static void remmina_main_init(void)
 	qcp_idx = qcp_actidx = 0;
 	for (i = 0; i < sizeof(quick_connect_plugin_list) / sizeof(quick_connect_plugin_list[0]); i++) {
 		name = quick_connect_plugin_list[i];
-		if (remmina_plugin_manager_get_plugin(REMMINA_PLUGIN_TYPE_PROTOCOL, name)) {
+		if (remmina_plugin_manager_has_plugin(REMMINA_PLUGIN_TYPE_PROTOCOL, name)) {
 			gtk_combo_box_text_append(remminamain->combo_quick_connect_protocol, name, name);
 			if (remmina_pref.last_quickconnect_protocol != NULL && strcmp(name, remmina_pref.last_quickconnect_protocol) == 0)
 				qcp_actidx = qcp_idx;
@@ -1413,6 +1537,10 @@ GtkWidget *remmina_main_new(void)
 
 	remminamain = g_new0(RemminaMain, 1);
 	remminamain->priv = g_new0(RemminaMainPriv, 1);
+	remminamain->priv->file_rows = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+							     (GDestroyNotify)remmina_main_file_row_free);
+	remminamain->priv->group_rows = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+							      (GDestroyNotify)gtk_tree_row_reference_free);
 	/* Assign UI widgets to the private members */
 	remminamain->builder = remmina_public_gtk_builder_new_from_resource ("/org/remmina/Remmina/src/../data/ui/remmina_main.glade");
 	remminamain->window = GTK_WINDOW(RM_GET_OBJECT("RemminaMain"));
@@ -79,6 +79,9 @@ struct _RemminaMainPriv {
 	GtkTreeModel *		file_model;
 	GtkTreeModel *		file_model_filter;
 	GtkTreeModel *		file_model_sort;
+	/* Rows of file_model by profile filename and by group path (tree mode) */
+	GHashTable *		file_rows;
+	GHashTable *		group_rows;
 
 	gboolean		initialized;
 
@@ -86,6 +89,8 @@ struct _RemminaMainPriv {
 	gchar *			selected_name;
 	gboolean		override_view_file_mode_to_list;
 	RemminaStringArray *	expanded_group;
+	/* Lowercase quick search text */
+	gchar *			search_text;
 };
 
 G_BEGIN_DECLS
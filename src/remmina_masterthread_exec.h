@@ -43,7 +43,7 @@
 typedef struct remmina_masterthread_exec_data {
 	enum { FUNC_GTK_LABEL_SET_TEXT,
 	       FUNC_INIT_SAVE_CRED, FUNC_CHAT_RECEIVE, FUNC_FILE_GET_STRING,
-	       FUNC_FTP_CLIENT_UPDATE_TASK, FUNC_FTP_CLIENT_GET_WAITING_TASK,
+	       FUNC_FTP_CLIENT_UPDATE_TASK,
 	       FUNC_SFTP_CLIENT_CONFIRM_RESUME,
 	       FUNC_PROTOCOLWIDGET_EMIT_SIGNAL,
 	       FUNC_PROTOCOLWIDGET_MPPROGRESS,
@@ -73,10 +73,6 @@ typedef struct remmina_masterthread_exec_data {
 			RemminaFTPClient *	client;
 			RemminaFTPTask *	task;
 		} ftp_client_update_task;
-		struct {
-			RemminaFTPClient *	client;
-			RemminaFTPTask *	retval;
-		} ftp_client_get_waiting_task;
 		struct {
 			RemminaProtocolWidget * gp;
 			const gchar *		signal_name;
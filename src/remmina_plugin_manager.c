@@ -41,6 +41,7 @@
 #include <glib/gi18n.h>
 #include <gmodule.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 #include <string.h>
 
 #include <gdk/gdkx.h>
@@ -69,6 +70,38 @@ static GHashTable *encrypted_settings_cache = NULL;
 /* There can be only one secret plugin loaded */
 static RemminaSecretPlugin *remmina_secret_plugin = NULL;
 
+/* File in the cache directory describing the plugins of each module, so that
+ * the modules can be opened only when one of their plugins is first used */
+#define REMMINA_PLUGIN_MANIFEST_NAME "plugins.manifest"
+#define REMMINA_PLUGIN_MANIFEST_GROUP "remmina"
+
+typedef struct _RemminaPluginManifestEntry {
+	RemminaPluginType	type;
+	gchar *			name;
+	gchar *			description;
+	gchar *			domain;
+	gchar *			version;
+	/* Interned, they outlive the entry */
+	const gchar *		icon_name;
+	const gchar *		icon_name_ssh;
+	gint *			features;
+	gsize			num_features;
+	gchar *			module;
+} RemminaPluginManifestEntry;
+
+static GKeyFile *plugin_manifest = NULL;
+static gboolean plugin_manifest_dirty = FALSE;
+
+/* Module being opened for the first time, its plugins are recorded in the manifest */
+static const gchar *loading_module = NULL;
+
+/* RemminaPluginManifestEntry of the plugins whose module is not opened yet */
+static GPtrArray *deferred_plugins = NULL;
+
+#ifdef WITH_PYTHONLIBS
+static gboolean python_initialized = FALSE;
+#endif
+
 static const gchar *remmina_plugin_type_name[] =
 { N_("Protocol"), N_("Entry"), N_("File"), N_("Tool"), N_("Preference"), N_("Secret"), NULL };
 
@@ -135,6 +168,64 @@ static void init_settings_cache(RemminaPlugin *plugin)
 
 }
 
+static void remmina_plugin_manager_manifest_set_string(const gchar *group, const gchar *key, gint n, const gchar *value)
+{
+	TRACE_CALL(__func__);
+	gchar k[64];
+
+	if (value) {
+		g_snprintf(k, sizeof(k), "%s_%d", key, n);
+		g_key_file_set_string(plugin_manifest, group, k, value);
+	}
+}
+
+/* Append the description of a plugin registered by loading_module to the manifest */
+static void remmina_plugin_manager_manifest_add(const gchar *module, RemminaPlugin *plugin)
+{
+	TRACE_CALL(__func__);
+	RemminaProtocolPlugin *protocol_plugin;
+	const RemminaProtocolFeature *feature;
+	GHashTable *pht;
+	GArray *features;
+	gchar **settings;
+	guint num_settings;
+	gchar k[64];
+	gint n, ftype;
+
+	n = g_key_file_get_integer(plugin_manifest, module, "plugins", NULL);
+	g_snprintf(k, sizeof(k), "type_%d", n);
+	g_key_file_set_integer(plugin_manifest, module, k, plugin->type);
+	remmina_plugin_manager_manifest_set_string(module, "name", n, plugin->name);
+	remmina_plugin_manager_manifest_set_string(module, "description", n, plugin->description);
+	remmina_plugin_manager_manifest_set_string(module, "domain", n, plugin->domain);
+	remmina_plugin_manager_manifest_set_string(module, "version", n, plugin->version);
+
+	if (plugin->type == REMMINA_PLUGIN_TYPE_PROTOCOL) {
+		protocol_plugin = (RemminaProtocolPlugin *)plugin;
+		remmina_plugin_manager_manifest_set_string(module, "icon_name", n, protocol_plugin->icon_name);
+		remmina_plugin_manager_manifest_set_string(module, "icon_name_ssh", n, protocol_plugin->icon_name_ssh);
+
+		features = g_array_new(FALSE, FALSE, sizeof(gint));
+		for (feature = protocol_plugin->features; feature && feature->type; feature++) {
+			ftype = feature->type;
+			g_array_append_val(features, ftype);
+		}
+		g_snprintf(k, sizeof(k), "features_%d", n);
+		g_key_file_set_integer_list(plugin_manifest, module, k, (gint *)features->data, features->len);
+		g_array_free(features, TRUE);
+
+		if (encrypted_settings_cache && (pht = g_hash_table_lookup(encrypted_settings_cache, plugin->name))) {
+			settings = (gchar **)g_hash_table_get_keys_as_array(pht, &num_settings);
+			g_snprintf(k, sizeof(k), "encrypted_settings_%d", n);
+			g_key_file_set_string_list(plugin_manifest, module, k, (const gchar * const *)settings, num_settings);
+			g_free(settings);
+		}
+	}
+
+	g_key_file_set_integer(plugin_manifest, module, "plugins", n + 1);
+	plugin_manifest_dirty = TRUE;
+}
+
 static gboolean remmina_plugin_manager_register_plugin(RemminaPlugin *plugin)
 {
 	TRACE_CALL(__func__);
@@ -145,6 +236,8 @@ static gboolean remmina_plugin_manager_register_plugin(RemminaPlugin *plugin)
 			((RemminaSecretPlugin*)plugin)->init_order);
 	}
 	init_settings_cache(plugin);
+	if (loading_module)
+		remmina_plugin_manager_manifest_add(loading_module, plugin);
 
 	g_ptr_array_add(remmina_plugin_table, plugin);
 	g_ptr_array_sort(remmina_plugin_table, (GCompareFunc)remmina_plugin_manager_compare_func);
@@ -255,7 +348,8 @@ RemminaPluginService remmina_plugin_manager_service =
 	remmina_masterthread_exec_is_main_thread,
 	remmina_gtksocket_available,
 	remmina_protocol_widget_get_profile_remote_width,
-	remmina_protocol_widget_get_profile_remote_height
+	remmina_protocol_widget_get_profile_remote_height,
+	remmina_protocol_widget_keep_tunnel_listening
 };
 
 const char *get_filename_ext(const char *filename) {
@@ -265,21 +359,205 @@ const char *get_filename_ext(const char *filename) {
     return dot + 1;
 }
 
-static void remmina_plugin_manager_load_plugin(const gchar *name)
+static gboolean remmina_plugin_manager_load_plugin(const gchar *name)
 {
 	const char* ext = get_filename_ext(name);
 
 	if (g_str_equal(G_MODULE_SUFFIX, ext)) {
-		remmina_plugin_native_load(&remmina_plugin_manager_service, name);
+		return remmina_plugin_native_load(&remmina_plugin_manager_service, name);
 	} else if (g_str_equal("py", ext)) {
 #ifdef WITH_PYTHONLIBS
-		remmina_plugin_python_load(&remmina_plugin_manager_service, name);
+		/* The interpreter is started only when there is a Python plugin to run */
+		if (!python_initialized) {
+			remmina_plugin_python_init();
+			python_initialized = TRUE;
+		}
+		return remmina_plugin_python_load(&remmina_plugin_manager_service, name);
 #else
 		REMMINA_DEBUG("Python support not compiled, cannot load Python plugins");
 #endif
 	} else {
 		g_print("%s: Skip unsupported file type '%s'\n", name, ext);
 	}
+	return FALSE;
+}
+
+static gchar *remmina_plugin_manager_manifest_path(void)
+{
+	TRACE_CALL(__func__);
+	return g_build_path("/", g_get_user_cache_dir(), "remmina", REMMINA_PLUGIN_MANIFEST_NAME, NULL);
+}
+
+static void remmina_plugin_manager_manifest_save(void)
+{
+	TRACE_CALL(__func__);
+	gchar *path;
+
+	path = remmina_plugin_manager_manifest_path();
+	if (!g_key_file_save_to_file(plugin_manifest, path, NULL))
+		g_debug("Could not save the plugin manifest to %s", path);
+	g_free(path);
+	plugin_manifest_dirty = FALSE;
+}
+
+static void remmina_plugin_manager_manifest_entry_free(RemminaPluginManifestEntry *entry)
+{
+	TRACE_CALL(__func__);
+	g_free(entry->name);
+	g_free(entry->description);
+	g_free(entry->domain);
+	g_free(entry->version);
+	g_free(entry->features);
+	g_free(entry->module);
+	g_free(entry);
+}
+
+static gchar *remmina_plugin_manager_manifest_get_string(const gchar *group, const gchar *key, gint n)
+{
+	TRACE_CALL(__func__);
+	gchar k[64];
+
+	g_snprintf(k, sizeof(k), "%s_%d", key, n);
+	return g_key_file_get_string(plugin_manifest, group, k, NULL);
+}
+
+/* Only plugins which are used after a user action can wait for their module:
+ * secret plugins are initialized at startup, entry and tool plugins are
+ * needed to handle the command line and to build the menus */
+static gboolean remmina_plugin_manager_type_can_defer(RemminaPluginType type)
+{
+	TRACE_CALL(__func__);
+	return type == REMMINA_PLUGIN_TYPE_PROTOCOL || type == REMMINA_PLUGIN_TYPE_FILE || type == REMMINA_PLUGIN_TYPE_PREF;
+}
+
+/* Register the plugins of a module from the manifest, without opening it.
+ * Returns FALSE when the module must be opened now */
+static gboolean remmina_plugin_manager_manifest_defer(const gchar *module, GStatBuf *st)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginManifestEntry *entry;
+	GHashTable *pht;
+	gchar **settings;
+	gchar *s, k[64];
+	gint i, j, n;
+
+	if (!g_key_file_has_group(plugin_manifest, module))
+		return FALSE;
+	if (g_key_file_get_uint64(plugin_manifest, module, "mtime", NULL) != (guint64)st->st_mtime ||
+	    g_key_file_get_uint64(plugin_manifest, module, "size", NULL) != (guint64)st->st_size)
+		return FALSE;
+
+	n = g_key_file_get_integer(plugin_manifest, module, "plugins", NULL);
+	for (i = 0; i < n; i++) {
+		g_snprintf(k, sizeof(k), "type_%d", i);
+		if (!remmina_plugin_manager_type_can_defer(g_key_file_get_integer(plugin_manifest, module, k, NULL)))
+			return FALSE;
+	}
+
+	for (i = 0; i < n; i++) {
+		entry = g_new0(RemminaPluginManifestEntry, 1);
+		g_snprintf(k, sizeof(k), "type_%d", i);
+		entry->type = g_key_file_get_integer(plugin_manifest, module, k, NULL);
+		entry->name = remmina_plugin_manager_manifest_get_string(module, "name", i);
+		entry->description = remmina_plugin_manager_manifest_get_string(module, "description", i);
+		entry->domain = remmina_plugin_manager_manifest_get_string(module, "domain", i);
+		entry->version = remmina_plugin_manager_manifest_get_string(module, "version", i);
+		entry->module = g_strdup(module);
+
+		if (entry->type == REMMINA_PLUGIN_TYPE_PROTOCOL) {
+			s = remmina_plugin_manager_manifest_get_string(module, "icon_name", i);
+			entry->icon_name = g_intern_string(s);
+			g_free(s);
+			s = remmina_plugin_manager_manifest_get_string(module, "icon_name_ssh", i);
+			entry->icon_name_ssh = g_intern_string(s);
+			g_free(s);
+			g_snprintf(k, sizeof(k), "features_%d", i);
+			entry->features = g_key_file_get_integer_list(plugin_manifest, module, k, &entry->num_features, NULL);
+
+			/* Profiles must know which settings go to the keyring before the module is opened */
+			if (encrypted_settings_cache == NULL)
+				encrypted_settings_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, htdestroy);
+			if (!(pht = g_hash_table_lookup(encrypted_settings_cache, entry->name))) {
+				pht = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+				g_hash_table_insert(encrypted_settings_cache, g_strdup(entry->name), pht);
+			}
+			g_snprintf(k, sizeof(k), "encrypted_settings_%d", i);
+			settings = g_key_file_get_string_list(plugin_manifest, module, k, NULL, NULL);
+			for (j = 0; settings && settings[j]; j++)
+				g_hash_table_insert(pht, g_strdup(settings[j]), (gpointer)TRUE);
+			g_strfreev(settings);
+		}
+
+		g_ptr_array_add(deferred_plugins, entry);
+	}
+
+	return TRUE;
+}
+
+/* Open a module at startup and record its plugins in the manifest */
+static void remmina_plugin_manager_load_module(const gchar *module, GStatBuf *st)
+{
+	TRACE_CALL(__func__);
+
+	g_key_file_remove_group(plugin_manifest, module, NULL);
+	plugin_manifest_dirty = TRUE;
+
+	loading_module = module;
+	if (remmina_plugin_manager_load_plugin(module) && st) {
+		g_key_file_set_uint64(plugin_manifest, module, "mtime", st->st_mtime);
+		g_key_file_set_uint64(plugin_manifest, module, "size", st->st_size);
+	} else {
+		/* Try again at the next start */
+		g_key_file_remove_group(plugin_manifest, module, NULL);
+	}
+	loading_module = NULL;
+}
+
+static RemminaPluginManifestEntry *remmina_plugin_manager_get_deferred(RemminaPluginType type, const gchar *name)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginManifestEntry *entry;
+	guint i;
+
+	if (deferred_plugins == NULL)
+		return NULL;
+
+	for (i = 0; i < deferred_plugins->len; i++) {
+		entry = (RemminaPluginManifestEntry *)g_ptr_array_index(deferred_plugins, i);
+		if (entry->type == type && (name == NULL || g_strcmp0(entry->name, name) == 0))
+			return entry;
+	}
+	return NULL;
+}
+
+/* Open the modules of the deferred plugins of the given type, or only
+ * the one of the named plugin */
+static void remmina_plugin_manager_load_deferred(RemminaPluginType type, const gchar *name)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginManifestEntry *entry;
+	gchar *module;
+	guint i;
+
+	while ((entry = remmina_plugin_manager_get_deferred(type, name)) != NULL) {
+		module = g_strdup(entry->module);
+		/* All the plugins of the module are registered now, by the module itself */
+		i = 0;
+		while (i < deferred_plugins->len) {
+			entry = (RemminaPluginManifestEntry *)g_ptr_array_index(deferred_plugins, i);
+			if (g_strcmp0(entry->module, module) == 0)
+				g_ptr_array_remove_index(deferred_plugins, i);
+			else
+				i++;
+		}
+		REMMINA_DEBUG("Opening the plugin module %s on first use", module);
+		if (!remmina_plugin_manager_load_plugin(module)) {
+			/* Do not defer it again, its failure will be reported at startup */
+			g_key_file_remove_group(plugin_manifest, module, NULL);
+			remmina_plugin_manager_manifest_save();
+		}
+		g_free(module);
+	}
 }
 
 static gint compare_secret_plugin_init_order(gconstpointer a, gconstpointer b)
@@ -301,7 +579,10 @@ void remmina_plugin_manager_init()
 	TRACE_CALL(__func__);
 	GDir *dir;
 	const gchar *name, *ptr;
-	gchar *fullpath;
+	gchar *fullpath, *path, *version;
+	gchar **groups;
+	GHashTable *modules;
+	GStatBuf st;
 	RemminaPlugin *plugin;
 	RemminaSecretPlugin *sp;
 	int i;
@@ -309,20 +590,36 @@ void remmina_plugin_manager_init()
 	GSList *sple;
 
 	remmina_plugin_table = g_ptr_array_new();
-#ifdef WITH_PYTHONLIBS
-	remmina_plugin_python_init();
-#endif
+	deferred_plugins = g_ptr_array_new_with_free_func((GDestroyNotify)remmina_plugin_manager_manifest_entry_free);
 
 	if (!g_module_supported()) {
 		g_print("Dynamic loading of plugins is not supported on this platform!\n");
 		return;
 	}
 
+	/* A manifest written by another version of Remmina may describe plugins differently */
+	plugin_manifest = g_key_file_new();
+	path = remmina_plugin_manager_manifest_path();
+	if (g_key_file_load_from_file(plugin_manifest, path, G_KEY_FILE_NONE, NULL)) {
+		version = g_key_file_get_string(plugin_manifest, REMMINA_PLUGIN_MANIFEST_GROUP, "version", NULL);
+		if (g_strcmp0(version, VERSION) != 0) {
+			g_key_file_free(plugin_manifest);
+			plugin_manifest = g_key_file_new();
+		}
+		g_free(version);
+	}
+	g_free(path);
+	if (!g_key_file_has_group(plugin_manifest, REMMINA_PLUGIN_MANIFEST_GROUP)) {
+		g_key_file_set_string(plugin_manifest, REMMINA_PLUGIN_MANIFEST_GROUP, "version", VERSION);
+		plugin_manifest_dirty = TRUE;
+	}
+
 	g_print("Load modules from %s\n", REMMINA_RUNTIME_PLUGINDIR);
 	dir = g_dir_open(REMMINA_RUNTIME_PLUGINDIR, 0, NULL);
 
 	if (dir == NULL)
 		return;
+	modules = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 	while ((name = g_dir_read_name(dir)) != NULL) {
 		if ((ptr = strrchr(name, '.')) == NULL)
 			continue;
@@ -330,11 +627,28 @@ void remmina_plugin_manager_init()
 		if (!remmina_plugin_manager_loader_supported(ptr))
 			continue;
 		fullpath = g_strdup_printf(REMMINA_RUNTIME_PLUGINDIR "/%s", name);
-		remmina_plugin_manager_load_plugin(fullpath);
-		g_free(fullpath);
+		if (g_stat(fullpath, &st) != 0)
+			remmina_plugin_manager_load_module(fullpath, NULL);
+		else if (!remmina_plugin_manager_manifest_defer(fullpath, &st))
+			remmina_plugin_manager_load_module(fullpath, &st);
+		g_hash_table_add(modules, fullpath);
 	}
 	g_dir_close(dir);
 
+	/* Forget the modules which have been removed */
+	groups = g_key_file_get_groups(plugin_manifest, NULL);
+	for (i = 0; groups[i]; i++) {
+		if (g_strcmp0(groups[i], REMMINA_PLUGIN_MANIFEST_GROUP) != 0 && !g_hash_table_contains(modules, groups[i])) {
+			g_key_file_remove_group(plugin_manifest, groups[i], NULL);
+			plugin_manifest_dirty = TRUE;
+		}
+	}
+	g_strfreev(groups);
+	g_hash_table_destroy(modules);
+
+	if (plugin_manifest_dirty)
+		remmina_plugin_manager_manifest_save();
+
 	/* Now all secret plugins needs to initialize, following their init_order.
 	 * The 1st plugin which will initialize correctly will be
 	 * the default remmina_secret_plugin */
@@ -370,7 +684,7 @@ gboolean remmina_plugin_manager_loader_supported(const char *filetype) {
 	return g_str_equal("py", filetype) || g_str_equal(G_MODULE_SUFFIX, filetype);
 }
 
-RemminaPlugin* remmina_plugin_manager_get_plugin(RemminaPluginType type, const gchar *name)
+static RemminaPlugin* remmina_plugin_manager_lookup_plugin(RemminaPluginType type, const gchar *name)
 {
 	TRACE_CALL(__func__);
 	RemminaPlugin *plugin;
@@ -385,6 +699,40 @@ RemminaPlugin* remmina_plugin_manager_get_plugin(RemminaPluginType type, const g
 	return NULL;
 }
 
+RemminaPlugin* remmina_plugin_manager_get_plugin(RemminaPluginType type, const gchar *name)
+{
+	TRACE_CALL(__func__);
+	RemminaPlugin *plugin;
+
+	plugin = remmina_plugin_manager_lookup_plugin(type, name);
+	if (plugin == NULL && remmina_plugin_manager_get_deferred(type, name)) {
+		remmina_plugin_manager_load_deferred(type, name);
+		plugin = remmina_plugin_manager_lookup_plugin(type, name);
+	}
+	return plugin;
+}
+
+gboolean remmina_plugin_manager_has_plugin(RemminaPluginType type, const gchar *name)
+{
+	TRACE_CALL(__func__);
+	return remmina_plugin_manager_lookup_plugin(type, name) || remmina_plugin_manager_get_deferred(type, name);
+}
+
+const gchar *remmina_plugin_manager_get_protocol_icon_name(const gchar *name, gboolean ssh_tunnel)
+{
+	TRACE_CALL(__func__);
+	RemminaProtocolPlugin *plugin;
+	RemminaPluginManifestEntry *entry;
+
+	plugin = (RemminaProtocolPlugin *)remmina_plugin_manager_lookup_plugin(REMMINA_PLUGIN_TYPE_PROTOCOL, name);
+	if (plugin)
+		return g_intern_string(ssh_tunnel ? plugin->icon_name_ssh : plugin->icon_name);
+	entry = remmina_plugin_manager_get_deferred(REMMINA_PLUGIN_TYPE_PROTOCOL, name);
+	if (entry)
+		return ssh_tunnel ? entry->icon_name_ssh : entry->icon_name;
+	return NULL;
+}
+
 const gchar *remmina_plugin_manager_get_canonical_setting_name(const RemminaProtocolSetting* setting)
 {
 	if (setting->name == NULL) {
@@ -405,6 +753,8 @@ void remmina_plugin_manager_for_each_plugin(RemminaPluginType type, RemminaPlugi
 	RemminaPlugin *plugin;
 	gint i;
 
+	remmina_plugin_manager_load_deferred(type, NULL);
+
 	for (i = 0; i < remmina_plugin_table->len; i++) {
 		plugin = (RemminaPlugin*)g_ptr_array_index(remmina_plugin_table, i);
 		if (plugin->type == type) {
@@ -430,11 +780,23 @@ static gboolean remmina_plugin_manager_show_for_each_stdout(RemminaPlugin *plugi
 	return FALSE;
 }
 
+static gboolean remmina_plugin_manager_show_deferred_for_each_stdout(RemminaPluginManifestEntry *entry)
+{
+	TRACE_CALL(__func__);
+
+	g_print("%-20s%-16s%-64s%-10s\n", entry->name,
+		_(remmina_plugin_type_name[entry->type]),
+		g_dgettext(entry->domain, entry->description),
+		entry->version);
+	return FALSE;
+}
+
 void remmina_plugin_manager_show_stdout()
 {
 	TRACE_CALL(__func__);
 	g_print("%-20s%-16s%-64s%-10s\n", "NAME", "TYPE", "DESCRIPTION", "PLUGIN AND LIBRARY VERSION");
 	g_ptr_array_foreach(remmina_plugin_table, (GFunc)remmina_plugin_manager_show_for_each_stdout, NULL);
+	g_ptr_array_foreach(deferred_plugins, (GFunc)remmina_plugin_manager_show_deferred_for_each_stdout, NULL);
 }
 
 static gboolean remmina_plugin_manager_show_for_each(RemminaPlugin *plugin, GtkListStore *store)
@@ -448,6 +810,17 @@ static gboolean remmina_plugin_manager_show_for_each(RemminaPlugin *plugin, GtkL
 	return FALSE;
 }
 
+static gboolean remmina_plugin_manager_show_deferred_for_each(RemminaPluginManifestEntry *entry, GtkListStore *store)
+{
+	TRACE_CALL(__func__);
+	GtkTreeIter iter;
+
+	gtk_list_store_append(store, &iter);
+	gtk_list_store_set(store, &iter, 0, entry->name, 1, _(remmina_plugin_type_name[entry->type]), 2,
+		g_dgettext(entry->domain, entry->description), 3, entry->version, -1);
+	return FALSE;
+}
+
 void remmina_plugin_manager_show(GtkWindow *parent)
 {
 	TRACE_CALL(__func__);
@@ -473,6 +846,7 @@ void remmina_plugin_manager_show(GtkWindow *parent)
 
 	store = gtk_list_store_new(4, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
 	g_ptr_array_foreach(remmina_plugin_table, (GFunc)remmina_plugin_manager_show_for_each, store);
+	g_ptr_array_foreach(deferred_plugins, (GFunc)remmina_plugin_manager_show_deferred_for_each, store);
 	gtk_tree_view_set_model(GTK_TREE_VIEW(tree), GTK_TREE_MODEL(store));
 
 	renderer = gtk_cell_renderer_text_new();
@@ -508,6 +882,8 @@ RemminaFilePlugin* remmina_plugin_manager_get_import_file_handler(const gchar *f
 	RemminaFilePlugin *plugin;
 	gint i;
 
+	remmina_plugin_manager_load_deferred(REMMINA_PLUGIN_TYPE_FILE, NULL);
+
 	for (i = 0; i < remmina_plugin_table->len; i++) {
 		plugin = (RemminaFilePlugin*)g_ptr_array_index(remmina_plugin_table, i);
 
@@ -527,6 +903,8 @@ RemminaFilePlugin* remmina_plugin_manager_get_export_file_handler(RemminaFile *r
 	RemminaFilePlugin *plugin;
 	gint i;
 
+	remmina_plugin_manager_load_deferred(REMMINA_PLUGIN_TYPE_FILE, NULL);
+
 	for (i = 0; i < remmina_plugin_table->len; i++) {
 		plugin = (RemminaFilePlugin*)g_ptr_array_index(remmina_plugin_table, i);
 		if (plugin->type != REMMINA_PLUGIN_TYPE_FILE)
@@ -549,10 +927,18 @@ gboolean remmina_plugin_manager_query_feature_by_type(RemminaPluginType ptype, c
 	TRACE_CALL(__func__);
 	const RemminaProtocolFeature *feature;
 	RemminaProtocolPlugin* plugin;
+	RemminaPluginManifestEntry *entry;
+	gsize i;
 
-	plugin = (RemminaProtocolPlugin*)remmina_plugin_manager_get_plugin(ptype, name);
+	plugin = (RemminaProtocolPlugin*)remmina_plugin_manager_lookup_plugin(ptype, name);
 
 	if (plugin == NULL) {
+		/* Answer from the manifest, no need to open the module for this */
+		entry = remmina_plugin_manager_get_deferred(ptype, name);
+		for (i = 0; entry && i < entry->num_features; i++) {
+			if (entry->features[i] == ftype)
+				return TRUE;
+		}
 		return FALSE;
 	}
 
@@ -564,14 +950,20 @@ gboolean remmina_plugin_manager_query_feature_by_type(RemminaPluginType ptype, c
 }
 
 gboolean remmina_plugin_manager_is_encrypted_setting(RemminaProtocolPlugin *pp, const char *setting)
+{
+	TRACE_CALL(__func__);
+	return remmina_plugin_manager_is_encrypted_protocol_setting(pp->name, setting);
+}
+
+gboolean remmina_plugin_manager_is_encrypted_protocol_setting(const gchar *protocol, const char *setting)
 {
 	TRACE_CALL(__func__);
 	GHashTable *pht;
 
-	if (encrypted_settings_cache == NULL)
+	if (encrypted_settings_cache == NULL || protocol == NULL)
 		return FALSE;
 
-	if (!(pht = g_hash_table_lookup(encrypted_settings_cache, pp->name)))
+	if (!(pht = g_hash_table_lookup(encrypted_settings_cache, protocol)))
 		return FALSE;
 
 	if (!g_hash_table_lookup(pht, setting))
@@ -43,7 +43,11 @@ G_BEGIN_DECLS
 typedef gboolean (*RemminaPluginFunc)(gchar *name, RemminaPlugin *plugin, gpointer data);
 
 void remmina_plugin_manager_init(void);
+/* Opens the module of the plugin if it was deferred at startup */
 RemminaPlugin *remmina_plugin_manager_get_plugin(RemminaPluginType type, const gchar *name);
+/* Like remmina_plugin_manager_get_plugin() != NULL, without opening any module */
+gboolean remmina_plugin_manager_has_plugin(RemminaPluginType type, const gchar *name);
+const gchar *remmina_plugin_manager_get_protocol_icon_name(const gchar *name, gboolean ssh_tunnel);
 gboolean remmina_plugin_manager_query_feature_by_type(RemminaPluginType ptype, const gchar *name, RemminaProtocolFeatureType ftype);
 void remmina_plugin_manager_for_each_plugin(RemminaPluginType type, RemminaPluginFunc func, gpointer data);
 void remmina_plugin_manager_show(GtkWindow *parent);
@@ -54,6 +58,7 @@ RemminaFilePlugin *remmina_plugin_manager_get_export_file_handler(RemminaFile *r
 RemminaSecretPlugin *remmina_plugin_manager_get_secret_plugin(void);
 const gchar *remmina_plugin_manager_get_canonical_setting_name(const RemminaProtocolSetting *setting);
 gboolean remmina_plugin_manager_is_encrypted_setting(RemminaProtocolPlugin *pp, const char *setting);
+gboolean remmina_plugin_manager_is_encrypted_protocol_setting(const gchar *protocol, const char *setting);
 gboolean remmina_gtksocket_available();
 
 extern RemminaPluginService remmina_plugin_manager_service;
@@ -478,6 +478,59 @@ void remmina_pref_init(void)
 	else
 		remmina_pref.ssh_tcp_usrtimeout = SSH_SOCKET_TCP_USER_TIMEOUT;
 
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "sftp_requests_in_flight", NULL))
+		remmina_pref.sftp_requests_in_flight = g_key_file_get_integer(gkeyfile, "remmina_pref", "sftp_requests_in_flight", NULL);
+	else
+		remmina_pref.sftp_requests_in_flight = SFTP_DEFAULT_REQUESTS_IN_FLIGHT;
+
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "sftp_parallel_transfers", NULL))
+		remmina_pref.sftp_parallel_transfers = g_key_file_get_integer(gkeyfile, "remmina_pref", "sftp_parallel_transfers", NULL);
+	else
+		remmina_pref.sftp_parallel_transfers = SFTP_DEFAULT_PARALLEL_TRANSFERS;
+
+	/* KiB/s for all the transfers of an SFTP client, 0 means no limit */
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "sftp_bandwidth_limit", NULL))
+		remmina_pref.sftp_bandwidth_limit = g_key_file_get_integer(gkeyfile, "remmina_pref", "sftp_bandwidth_limit", NULL);
+	else
+		remmina_pref.sftp_bandwidth_limit = 0;
+
+	/* Seconds an idle shared SSH connection is kept open, 0 disables the sharing */
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "ssh_session_pool_timeout", NULL))
+		remmina_pref.ssh_session_pool_timeout = g_key_file_get_integer(gkeyfile, "remmina_pref", "ssh_session_pool_timeout", NULL);
+	else
+		remmina_pref.ssh_session_pool_timeout = 60;
+
+	/* Seconds an SSH tunnel keeps listening once its last connection is gone,
+	 * only for plugins asking for it. 0 closes the listener once connected */
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "ssh_tunnel_linger", NULL))
+		remmina_pref.ssh_tunnel_linger = g_key_file_get_integer(gkeyfile, "remmina_pref", "ssh_tunnel_linger", NULL);
+	else
+		remmina_pref.ssh_tunnel_linger = 60;
+
+	/* MiB of SSH session log before it is rotated, 0 means no rotation */
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "ssh_session_log_max_size", NULL))
+		remmina_pref.ssh_session_log_max_size = g_key_file_get_integer(gkeyfile, "remmina_pref", "ssh_session_log_max_size", NULL);
+	else
+		remmina_pref.ssh_session_log_max_size = 0;
+
+	/* Rotated SSH session logs kept */
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "ssh_session_log_rotate", NULL))
+		remmina_pref.ssh_session_log_rotate = g_key_file_get_integer(gkeyfile, "remmina_pref", "ssh_session_log_rotate", NULL);
+	else
+		remmina_pref.ssh_session_log_rotate = 5;
+
+	/* gdk-pixbuf saver used for screenshots: "png", or "jpeg" which is faster */
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "screenshot_format", NULL))
+		remmina_pref.screenshot_format = g_key_file_get_string(gkeyfile, "remmina_pref", "screenshot_format", NULL);
+	else
+		remmina_pref.screenshot_format = g_strdup("png");
+
+	/* zlib level from 0 (fastest) to 9 (smallest) */
+	if (g_key_file_has_key(gkeyfile, "remmina_pref", "screenshot_png_compression", NULL))
+		remmina_pref.screenshot_png_compression = g_key_file_get_integer(gkeyfile, "remmina_pref", "screenshot_png_compression", NULL);
+	else
+		remmina_pref.screenshot_png_compression = 6;
+
 	if (g_key_file_has_key(gkeyfile, "remmina_pref", "applet_new_ontop", NULL))
 		remmina_pref.applet_new_ontop = g_key_file_get_boolean(gkeyfile, "remmina_pref", "applet_new_ontop", NULL);
 	else
@@ -814,6 +867,15 @@ gboolean remmina_pref_save(void)
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_tcp_keepintvl", remmina_pref.ssh_tcp_keepintvl);
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_tcp_keepcnt", remmina_pref.ssh_tcp_keepcnt);
 	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_tcp_usrtimeout", remmina_pref.ssh_tcp_usrtimeout);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "sftp_requests_in_flight", remmina_pref.sftp_requests_in_flight);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "sftp_parallel_transfers", remmina_pref.sftp_parallel_transfers);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "sftp_bandwidth_limit", remmina_pref.sftp_bandwidth_limit);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_session_pool_timeout", remmina_pref.ssh_session_pool_timeout);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_tunnel_linger", remmina_pref.ssh_tunnel_linger);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_session_log_max_size", remmina_pref.ssh_session_log_max_size);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "ssh_session_log_rotate", remmina_pref.ssh_session_log_rotate);
+	g_key_file_set_string(gkeyfile, "remmina_pref", "screenshot_format", remmina_pref.screenshot_format);
+	g_key_file_set_integer(gkeyfile, "remmina_pref", "screenshot_png_compression", remmina_pref.screenshot_png_compression);
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "applet_new_ontop", remmina_pref.applet_new_ontop);
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "applet_hide_count", remmina_pref.applet_hide_count);
 	g_key_file_set_boolean(gkeyfile, "remmina_pref", "applet_enable_avahi", remmina_pref.applet_enable_avahi);
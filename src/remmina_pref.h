@@ -150,6 +150,16 @@ typedef struct _RemminaPref {
 	gint			ssh_tcp_keepintvl;
 	gint			ssh_tcp_keepcnt;
 	gint			ssh_tcp_usrtimeout;
+	/* Not in RemminaPrefDialog */
+	gint			sftp_requests_in_flight;
+	gint			sftp_parallel_transfers;
+	gint			sftp_bandwidth_limit;
+	gint			ssh_session_pool_timeout;
+	gint			ssh_tunnel_linger;
+	gint			ssh_session_log_max_size;
+	gint			ssh_session_log_rotate;
+	const gchar *		screenshot_format;
+	gint			screenshot_png_compression;
 	/* In RemminaPrefDialog keyboard tab */
 	guint			hostkey;
 	guint			shortcutkey_fullscreen;
@@ -230,6 +240,10 @@ typedef struct _RemminaPref {
 #define SSH_SOCKET_TCP_KEEPINTVL 10
 #define SSH_SOCKET_TCP_KEEPCNT 3
 #define SSH_SOCKET_TCP_USER_TIMEOUT 60000 // 60 seconds
+#define SFTP_DEFAULT_REQUESTS_IN_FLIGHT 16
+#define SFTP_MAX_REQUESTS_IN_FLIGHT 64
+#define SFTP_DEFAULT_PARALLEL_TRANSFERS 3
+#define SFTP_MAX_PARALLEL_TRANSFERS 8
 
 extern const gchar *default_resolutions;
 extern gchar *remmina_pref_file;
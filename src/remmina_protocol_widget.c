@@ -75,6 +75,8 @@ struct _RemminaProtocolWidgetPriv {
 	 * the 1st one is the "main" tunnel, other tunnels are used for example in sftp commands */
 	GPtrArray *		ssh_tunnels;
 	RemminaTunnelInitFunc	init_func;
+	/* The plugin asked to keep direct tunnels listening for its reconnects */
+	gboolean		keep_tunnel_listening;
 
 	GtkWidget *		chat_window;
 
@@ -254,6 +256,12 @@ void remmina_protocol_widget_open_connection_real(gpointer data)
 
 	gp->priv->closed = FALSE;
 
+	/* Fetch the secrets still in the keyring now, on the main thread, so
+	 * the plugin threads never find a placeholder instead of a password */
+	remmina_file_load_secrets(gp->priv->remmina_file);
+	/* The plugin threads read the settings without waiting for the main loop */
+	remmina_file_publish_settings(gp->priv->remmina_file);
+
 	plugin = gp->priv->plugin;
 	plugin->init(gp);
 
@@ -1075,6 +1083,7 @@ gchar *remmina_protocol_widget_start_direct_tunnel(RemminaProtocolWidget *gp, gi
 	gchar *msg;
 	RemminaMessagePanel *mp;
 	RemminaSSHTunnel *tunnel;
+	guint i;
 
 	if (!remmina_file_get_int(gp->priv->remmina_file, "ssh_tunnel_enabled", FALSE)) {
 		dest = g_strdup_printf("[%s]:%i", srv_host, srv_port);
@@ -1083,6 +1092,25 @@ gchar *remmina_protocol_widget_start_direct_tunnel(RemminaProtocolWidget *gp, gi
 		return dest;
 	}
 
+	if (remmina_file_get_int(gp->priv->remmina_file, "ssh_tunnel_loopback", FALSE)) {
+		g_free(srv_host);
+		g_free(ssh_tunnel_host);
+		ssh_tunnel_host = NULL;
+		srv_host = g_strdup("127.0.0.1");
+	}
+
+	/* A lingering tunnel to the same destination is reused, e.g. on reconnect,
+	 * as long as its SSH transport still answers */
+	for (i = 0; i < gp->priv->ssh_tunnels->len; i++) {
+		tunnel = (RemminaSSHTunnel *)gp->priv->ssh_tunnels->pdata[i];
+		if (tunnel->linger > 0 && remmina_ssh_tunnel_listening(tunnel, srv_host, srv_port)) {
+			REMMINA_DEBUG ("Reusing the tunnel listening on local port %d", tunnel->localport);
+			g_free(srv_host);
+			g_free(ssh_tunnel_host);
+			return g_strdup_printf("127.0.0.1:%i", tunnel->localport);
+		}
+	}
+
 	tunnel = remmina_protocol_widget_init_tunnel(gp);
 	if (!tunnel) {
 		g_free(srv_host);
@@ -1097,12 +1125,8 @@ gchar *remmina_protocol_widget_start_direct_tunnel(RemminaProtocolWidget *gp, gi
 	mp = remmina_protocol_widget_mpprogress(gp->cnnobj, msg, cancel_start_direct_tunnel_cb, NULL);
 	g_free(msg);
 
-	if (remmina_file_get_int(gp->priv->remmina_file, "ssh_tunnel_loopback", FALSE)) {
-		g_free(srv_host);
-		g_free(ssh_tunnel_host);
-		ssh_tunnel_host = NULL;
-		srv_host = g_strdup("127.0.0.1");
-	}
+	if (gp->priv->keep_tunnel_listening)
+		tunnel->linger = remmina_pref.ssh_tunnel_linger;
 
 	REMMINA_DEBUG ("Starting tunnel to: %s, port: %d", ssh_tunnel_host, ssh_tunnel_port);
 	if (!remmina_ssh_tunnel_open(tunnel, srv_host, srv_port, remmina_pref.sshtunnel_port)) {
@@ -1122,7 +1146,7 @@ gchar *remmina_protocol_widget_start_direct_tunnel(RemminaProtocolWidget *gp, gi
 
 	g_ptr_array_add(gp->priv->ssh_tunnels, tunnel);
 
-	return g_strdup_printf("127.0.0.1:%i", remmina_pref.sshtunnel_port);
+	return g_strdup_printf("127.0.0.1:%i", tunnel->localport);
 
 #else
 
@@ -1361,6 +1385,15 @@ gint remmina_protocol_widget_get_profile_remote_height(RemminaProtocolWidget *gp
 	return gp->priv->profile_remote_height;
 }
 
+void remmina_protocol_widget_keep_tunnel_listening(RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	/* Direct tunnels opened from now on keep listening for
+	 * remmina_pref.ssh_tunnel_linger seconds after the connection is
+	 * established or dropped, so the plugin can reconnect through them */
+	gp->priv->keep_tunnel_listening = TRUE;
+}
+
 
 gint remmina_protocol_widget_get_width(RemminaProtocolWidget *gp)
 {
@@ -46,11 +46,13 @@
 #include <pthread.h>
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
+#include <poll.h>
 #endif
 #include "remmina_public.h"
 #include "remmina_pref.h"
 #include "remmina_ssh.h"
 #include "remmina_sftp_client.h"
+#include "remmina_sftp_pipeline.h"
 #include "remmina_sftp_plugin.h"
 #include "remmina_masterthread_exec.h"
 #include "remmina/remmina_trace_calls.h"
@@ -84,7 +86,10 @@ remmina_sftp_client_class_init(RemminaSFTPClientClass *klass)
 static gboolean remmina_sftp_client_refresh(RemminaSFTPClient *client);
 
 #define THREAD_CHECK_EXIT \
-	(!client->taskid || client->thread_abort)
+	(client->thread_abort || g_atomic_int_get(&task->cancelled))
+
+/* Milliseconds a worker waits on the socket for a reply before trying again */
+#define SFTP_REPLY_POLL_TIMEOUT 100
 
 
 
@@ -118,6 +123,22 @@ remmina_sftp_client_thread_set_error(RemminaSFTPClient *client, RemminaFTPTask *
 	remmina_sftp_client_thread_update_task(client, task);
 }
 
+/* Same as remmina_sftp_client_thread_set_error() for a failed libssh call on
+ * path, the error is read from the session shared with the other workers */
+static void
+remmina_sftp_client_thread_set_ssh_error(RemminaSFTPClient *client, RemminaSFTP *sftp, RemminaFTPTask *task,
+					 const gchar *error_format, const gchar *path)
+{
+	TRACE_CALL(__func__);
+	gchar *error;
+
+	remmina_sftp_lock(sftp);
+	error = g_strdup(ssh_get_error(REMMINA_SSH(sftp)->session));
+	remmina_sftp_unlock(sftp);
+	remmina_sftp_client_thread_set_error(client, task, error_format, path, error);
+	g_free(error);
+}
+
 static void
 remmina_sftp_client_thread_set_finish(RemminaSFTPClient *client, RemminaFTPTask *task)
 {
@@ -129,18 +150,29 @@ remmina_sftp_client_thread_set_finish(RemminaSFTPClient *client, RemminaFTPTask
 	remmina_sftp_client_thread_update_task(client, task);
 }
 
+/* Take the next task from the queue. Without one, or when leave is set, the
+ * worker leaves the pool and the last one out gets the folder to refresh */
 static RemminaFTPTask *
-remmina_sftp_client_thread_get_task(RemminaSFTPClient *client)
+remmina_sftp_client_thread_get_task(RemminaSFTPClient *client, gboolean leave, gchar **refreshdir)
 {
 	TRACE_CALL(__func__);
-	RemminaFTPTask *task;
-
-	if (client->thread_abort) return NULL;
+	RemminaFTPTask *task = NULL;
 
-	task = remmina_ftp_client_get_waiting_task(REMMINA_FTP_CLIENT(client));
+	pthread_mutex_lock(&client->queue_mutex);
+	if (!leave && !client->thread_abort)
+		task = g_queue_pop_head(&client->queue);
 	if (task) {
-		client->taskid = task->taskid;
+		client->running = g_list_prepend(client->running, task);
+	} else {
+		client->num_workers--;
+		if (client->num_workers == 0) {
+			*refreshdir = client->refreshdir;
+			client->refreshdir = NULL;
+		}
+	}
+	pthread_mutex_unlock(&client->queue_mutex);
 
+	if (task) {
 		task->status = REMMINA_FTP_TASK_STATUS_RUN;
 		remmina_ftp_client_update_task(REMMINA_FTP_CLIENT(client), task);
 	}
@@ -148,6 +180,359 @@ remmina_sftp_client_thread_get_task(RemminaSFTPClient *client)
 	return task;
 }
 
+static void
+remmina_sftp_client_thread_put_task(RemminaSFTPClient *client, RemminaFTPTask *task)
+{
+	TRACE_CALL(__func__);
+	pthread_mutex_lock(&client->queue_mutex);
+	client->running = g_list_remove(client->running, task);
+	pthread_mutex_unlock(&client->queue_mutex);
+
+	remmina_ftp_task_free(task);
+}
+
+/* Hold the worker back as long as the transfers of this client go beyond
+ * the sftp_bandwidth_limit preference */
+static void
+remmina_sftp_client_thread_throttle(RemminaSFTPClient *client, RemminaFTPTask *task, size_t len)
+{
+	TRACE_CALL(__func__);
+	gint64 now, wait;
+
+	if (remmina_pref.sftp_bandwidth_limit <= 0)
+		return;
+
+	pthread_mutex_lock(&client->queue_mutex);
+	now = g_get_monotonic_time();
+	if (client->bandwidth_next < now)
+		client->bandwidth_next = now;
+	client->bandwidth_next += (gint64)len * G_USEC_PER_SEC / ((gint64)remmina_pref.sftp_bandwidth_limit * 1024);
+	wait = client->bandwidth_next - now;
+	pthread_mutex_unlock(&client->queue_mutex);
+
+	/* Sleep in small steps to notice a cancel */
+	while (wait > 0 && !THREAD_CHECK_EXIT) {
+		g_usleep(MIN(wait, G_USEC_PER_SEC / 10));
+		wait -= G_USEC_PER_SEC / 10;
+	}
+}
+
+/* The workers share one SSH session, see remmina_sftp_client_thread_main(),
+ * which may also carry the browser and other sessions to the same account,
+ * so every libssh call holds the session lock */
+static void
+remmina_sftp_client_thread_close(RemminaSFTP *sftp, sftp_file remote_file)
+{
+	TRACE_CALL(__func__);
+	remmina_sftp_lock(sftp);
+	sftp_close(remote_file);
+	remmina_sftp_unlock(sftp);
+}
+
+static sftp_attributes
+remmina_sftp_client_thread_readdir(RemminaSFTP *sftp, sftp_dir sftpdir)
+{
+	TRACE_CALL(__func__);
+	sftp_attributes sftpattr;
+
+	remmina_sftp_lock(sftp);
+	sftpattr = sftp_readdir(sftp->sftp_sess, sftpdir);
+	remmina_sftp_unlock(sftp);
+	return sftpattr;
+}
+
+/* A reply not arrived yet: leave the session to the other workers until
+ * something comes in on the socket */
+static void
+remmina_sftp_client_thread_wait_reply(RemminaSFTP *sftp)
+{
+	struct pollfd pfd;
+
+	pfd.fd = ssh_get_fd(REMMINA_SSH(sftp)->session);
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	poll(&pfd, 1, SFTP_REPLY_POLL_TIMEOUT);
+}
+
+/* ------------------------ Pipelined transfers ----------------------------- */
+
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 11, 0)
+#define REMMINA_SFTP_USE_AIO
+#endif
+
+/* State of one transfer, for the remmina_sftp_pipeline callbacks */
+typedef struct _RemminaSFTPTransfer {
+	RemminaSFTPClient *	client;
+	RemminaSFTP *		sftp;
+	RemminaFTPTask *	task;
+	sftp_file		remote_file;
+	FILE *			local_file;
+	guint64 *		donesize;
+#ifndef REMMINA_SFTP_USE_AIO
+	/* Result of the blocking write done by write_begin */
+	gssize			written;
+#endif
+} RemminaSFTPTransfer;
+
+/* Number of requests kept in flight, from the sftp_requests_in_flight preference */
+static gint
+remmina_sftp_client_get_window(void)
+{
+	TRACE_CALL(__func__);
+	return CLAMP(remmina_pref.sftp_requests_in_flight, 1, SFTP_MAX_REQUESTS_IN_FLIGHT);
+}
+
+/* Largest read and write payloads the server accepts */
+static void
+remmina_sftp_client_get_chunk_limits(RemminaSFTP *sftp, size_t *max_read, size_t *max_write)
+{
+	TRACE_CALL(__func__);
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 10, 0)
+	sftp_limits_t limits;
+
+	remmina_sftp_lock(sftp);
+	limits = sftp_limits(sftp->sftp_sess);
+	remmina_sftp_unlock(sftp);
+	if (limits) {
+		*max_read = CLAMP(limits->max_read_length, REMMINA_SFTP_CHUNK_MIN, REMMINA_SFTP_CHUNK_MAX);
+		*max_write = CLAMP(limits->max_write_length, REMMINA_SFTP_CHUNK_MIN, REMMINA_SFTP_CHUNK_MAX);
+		sftp_limits_free(limits);
+		return;
+	}
+#endif
+	/* Short reads shrink the read size again, every server must accept 32 KiB writes */
+	*max_read = REMMINA_SFTP_CHUNK_MAX;
+	*max_write = 32 * 1024;
+}
+
+/* libssh sends a request at the current offset of the file */
+static gboolean
+remmina_sftp_client_transfer_seek(RemminaSFTPTransfer *transfer, guint64 offset)
+{
+	return sftp_tell64(transfer->remote_file) == offset ||
+	       sftp_seek64(transfer->remote_file, offset) >= 0;
+}
+
+static gboolean
+remmina_sftp_client_transfer_read_begin(gpointer user_data, RemminaSFTPRequest *req)
+{
+	RemminaSFTPTransfer *transfer = user_data;
+	gint ret;
+
+	if (!remmina_sftp_client_transfer_seek(transfer, req->offset))
+		return FALSE;
+	remmina_sftp_lock(transfer->sftp);
+#ifdef REMMINA_SFTP_USE_AIO
+	ret = sftp_aio_begin_read(transfer->remote_file, req->len, (sftp_aio *)&req->handle);
+#else
+	ret = sftp_async_read_begin(transfer->remote_file, req->len);
+	req->handle = GINT_TO_POINTER(ret);
+#endif
+	remmina_sftp_unlock(transfer->sftp);
+	return ret >= 0;
+}
+
+static gssize
+remmina_sftp_client_transfer_read_wait(gpointer user_data, RemminaSFTPRequest *req, gchar *buf)
+{
+	RemminaSFTPTransfer *transfer = user_data;
+	gssize ret;
+
+	/* The file is non blocking, so the session lock is not held while
+	 * the server is busy with our request */
+	while (1) {
+		remmina_sftp_lock(transfer->sftp);
+#ifdef REMMINA_SFTP_USE_AIO
+		/* Waiting frees the aio handle, unless the reply is not there yet */
+		ret = sftp_aio_wait_read((sftp_aio *)&req->handle, buf, req->len);
+#else
+		ret = sftp_async_read(transfer->remote_file, buf, req->len, GPOINTER_TO_INT(req->handle));
+#endif
+		remmina_sftp_unlock(transfer->sftp);
+		if (ret != SSH_AGAIN)
+			return ret;
+		remmina_sftp_client_thread_wait_reply(transfer->sftp);
+	}
+}
+
+static gboolean
+remmina_sftp_client_transfer_deliver(gpointer user_data, const gchar *buf, gsize len)
+{
+	RemminaSFTPTransfer *transfer = user_data;
+
+	if (fwrite(buf, 1, len, transfer->local_file) < len)
+		return FALSE;
+
+	*transfer->donesize += (guint64)len;
+	transfer->task->donesize = (gfloat)(*transfer->donesize);
+	remmina_ftp_client_set_task_progress(transfer->task);
+	remmina_sftp_client_thread_throttle(transfer->client, transfer->task, len);
+	return TRUE;
+}
+
+static gssize
+remmina_sftp_client_transfer_fill(gpointer user_data, gchar *buf, gsize len)
+{
+	RemminaSFTPTransfer *transfer = user_data;
+	size_t n;
+
+	n = fread(buf, 1, len, transfer->local_file);
+	if (n == 0 && ferror(transfer->local_file))
+		return -1;
+	return n;
+}
+
+static gboolean
+remmina_sftp_client_transfer_write_begin(gpointer user_data, RemminaSFTPRequest *req, const gchar *buf)
+{
+	RemminaSFTPTransfer *transfer = user_data;
+	gboolean ret = TRUE;
+
+	if (!remmina_sftp_client_transfer_seek(transfer, req->offset))
+		return FALSE;
+	remmina_sftp_lock(transfer->sftp);
+#ifdef REMMINA_SFTP_USE_AIO
+	/* The data is copied into the request, so buf can be reused at once */
+	ret = sftp_aio_begin_write(transfer->remote_file, buf, req->len, (sftp_aio *)&req->handle) != SSH_ERROR;
+#else
+	/* No asynchronous write call before libssh 0.11, the window is 1 */
+	transfer->written = sftp_write(transfer->remote_file, buf, req->len);
+#endif
+	remmina_sftp_unlock(transfer->sftp);
+	return ret;
+}
+
+static gssize
+remmina_sftp_client_transfer_write_wait(gpointer user_data, RemminaSFTPRequest *req)
+{
+	RemminaSFTPTransfer *transfer = user_data;
+#ifdef REMMINA_SFTP_USE_AIO
+	gssize ret;
+
+	while (1) {
+		remmina_sftp_lock(transfer->sftp);
+		/* Waiting frees the aio handle, unless the reply is not there yet */
+		ret = sftp_aio_wait_write((sftp_aio *)&req->handle);
+		remmina_sftp_unlock(transfer->sftp);
+		if (ret != SSH_AGAIN)
+			return ret;
+		remmina_sftp_client_thread_wait_reply(transfer->sftp);
+	}
+#else
+	return transfer->written;
+#endif
+}
+
+static void
+remmina_sftp_client_transfer_written(gpointer user_data, gsize len)
+{
+	RemminaSFTPTransfer *transfer = user_data;
+
+	*transfer->donesize += (guint64)len;
+	transfer->task->donesize = (gfloat)(*transfer->donesize);
+	remmina_ftp_client_set_task_progress(transfer->task);
+	remmina_sftp_client_thread_throttle(transfer->client, transfer->task, len);
+}
+
+static void
+remmina_sftp_client_transfer_discard(gpointer user_data, RemminaSFTPRequest *req)
+{
+#ifdef REMMINA_SFTP_USE_AIO
+	sftp_aio_free((sftp_aio)req->handle);
+	req->handle = NULL;
+#endif
+}
+
+static gboolean
+remmina_sftp_client_transfer_cancelled(gpointer user_data)
+{
+	RemminaSFTPTransfer *transfer = user_data;
+	RemminaSFTPClient *client = transfer->client;
+	RemminaFTPTask *task = transfer->task;
+
+	return THREAD_CHECK_EXIT;
+}
+
+static const RemminaSFTPPipelineOps remmina_sftp_client_transfer_ops = {
+	.read_begin	= remmina_sftp_client_transfer_read_begin,
+	.read_wait	= remmina_sftp_client_transfer_read_wait,
+	.deliver	= remmina_sftp_client_transfer_deliver,
+	.fill		= remmina_sftp_client_transfer_fill,
+	.write_begin	= remmina_sftp_client_transfer_write_begin,
+	.write_wait	= remmina_sftp_client_transfer_write_wait,
+	.written	= remmina_sftp_client_transfer_written,
+	.discard	= remmina_sftp_client_transfer_discard,
+	.cancelled	= remmina_sftp_client_transfer_cancelled,
+};
+
+/* Download remote_file from offset to the end, keeping several read requests
+ * in flight to hide the round trip time */
+static gboolean
+remmina_sftp_client_thread_pipelined_read(RemminaSFTPClient *client, RemminaSFTP *sftp, RemminaFTPTask *task,
+					  sftp_file remote_file, FILE *local_file, uint64_t offset,
+					  const gchar *remote_path, const gchar *local_path, guint64 *donesize)
+{
+	TRACE_CALL(__func__);
+	RemminaSFTPTransfer transfer = { client, sftp, task, remote_file, local_file, donesize };
+	RemminaSFTPPipelineResult result;
+	size_t max_read, max_write;
+
+	remmina_sftp_client_get_chunk_limits(sftp, &max_read, &max_write);
+
+	sftp_file_set_nonblocking(remote_file);
+	result = remmina_sftp_pipeline_read(&remmina_sftp_client_transfer_ops, &transfer,
+					    remmina_sftp_client_get_window(), max_read, offset);
+	sftp_file_set_blocking(remote_file);
+
+	switch (result) {
+	case REMMINA_SFTP_PIPELINE_REMOTE_ERROR:
+		remmina_sftp_client_thread_set_ssh_error(client, sftp, task, _("Could not download the file “%s”. %s"),
+						      remote_path);
+		return FALSE;
+	case REMMINA_SFTP_PIPELINE_LOCAL_ERROR:
+		remmina_sftp_client_thread_set_error(client, task, _("Could not save the file “%s”."), local_path);
+		return FALSE;
+	default:
+		/* A cancel is noticed by the caller */
+		return TRUE;
+	}
+}
+
+/* Upload local_file to remote_file at offset. With libssh 0.11 or later
+ * several write requests are kept in flight */
+static gboolean
+remmina_sftp_client_thread_pipelined_write(RemminaSFTPClient *client, RemminaSFTP *sftp, RemminaFTPTask *task,
+					   sftp_file remote_file, FILE *local_file, uint64_t offset,
+					   const gchar *remote_path, const gchar *local_path, guint64 *donesize)
+{
+	TRACE_CALL(__func__);
+	RemminaSFTPTransfer transfer = { client, sftp, task, remote_file, local_file, donesize };
+	RemminaSFTPPipelineResult result;
+	size_t max_read, max_write;
+
+	remmina_sftp_client_get_chunk_limits(sftp, &max_read, &max_write);
+#ifdef REMMINA_SFTP_USE_AIO
+	sftp_file_set_nonblocking(remote_file);
+	result = remmina_sftp_pipeline_write(&remmina_sftp_client_transfer_ops, &transfer,
+					     remmina_sftp_client_get_window(), max_write, offset);
+	sftp_file_set_blocking(remote_file);
+#else
+	result = remmina_sftp_pipeline_write(&remmina_sftp_client_transfer_ops, &transfer, 1, max_write, offset);
+#endif
+
+	switch (result) {
+	case REMMINA_SFTP_PIPELINE_REMOTE_ERROR:
+		remmina_sftp_client_thread_set_ssh_error(client, sftp, task, _("Could not write to the file “%s” on the server. %s"),
+						      remote_path);
+		return FALSE;
+	case REMMINA_SFTP_PIPELINE_LOCAL_ERROR:
+		remmina_sftp_client_thread_set_error(client, task, _("Could not read the file “%s”."), local_path);
+		return FALSE;
+	default:
+		return TRUE;
+	}
+}
+
 static gboolean
 remmina_sftp_client_thread_download_file(RemminaSFTPClient *client, RemminaSFTP *sftp, RemminaFTPTask *task,
 					 const gchar *remote_path, const gchar *local_path, guint64 *donesize)
@@ -157,7 +542,6 @@ remmina_sftp_client_thread_download_file(RemminaSFTPClient *client, RemminaSFTP
 	FILE *local_file;
 	gchar *tmp;
 	gchar buf[20480];
-	gint len;
 	gint response;
 	uint64_t size;
 
@@ -211,45 +595,38 @@ remmina_sftp_client_thread_download_file(RemminaSFTPClient *client, RemminaSFTP
 	}
 
 	tmp = remmina_ssh_unconvert(REMMINA_SSH(sftp), remote_path);
+	remmina_sftp_lock(sftp);
 	remote_file = sftp_open(sftp->sftp_sess, tmp, O_RDONLY, 0);
+	remmina_sftp_unlock(sftp);
 	g_free(tmp);
 
 	if (!remote_file) {
 		fclose(local_file);
 		// TRANSLATORS: The placeholders %s are a file path, and an error message.
-		remmina_sftp_client_thread_set_error(client, task, _("Could not open the file “%s” on the server. %s"),
-						     remote_path, ssh_get_error(REMMINA_SSH(client->sftp)->session));
+		remmina_sftp_client_thread_set_ssh_error(client, sftp, task, _("Could not open the file “%s” on the server. %s"),
+						      remote_path);
 		return FALSE;
 	}
 
 	if (size > 0) {
 		if (sftp_seek64(remote_file, size) < 0) {
-			sftp_close(remote_file);
+			remmina_sftp_client_thread_close(sftp, remote_file);
 			fclose(local_file);
-			remmina_sftp_client_thread_set_error(client, task, "Could not download the file “%s”. %s",
-							     remote_path, ssh_get_error(REMMINA_SSH(client->sftp)->session));
+			remmina_sftp_client_thread_set_ssh_error(client, sftp, task, "Could not download the file “%s”. %s",
+							      remote_path);
 			return FALSE;
 		}
 		*donesize = size;
 	}
 
-	while (!THREAD_CHECK_EXIT && (len = sftp_read(remote_file, buf, sizeof(buf))) > 0) {
-		if (THREAD_CHECK_EXIT) break;
-
-		if (fwrite(buf, 1, len, local_file) < len) {
-			sftp_close(remote_file);
-			fclose(local_file);
-			remmina_sftp_client_thread_set_error(client, task, _("Could not save the file “%s”."), local_path);
-			return FALSE;
-		}
-
-		*donesize += (guint64)len;
-		task->donesize = (gfloat)(*donesize);
-
-		if (!remmina_sftp_client_thread_update_task(client, task)) break;
+	if (!remmina_sftp_client_thread_pipelined_read(client, sftp, task, remote_file, local_file, size,
+						       remote_path, local_path, donesize)) {
+		remmina_sftp_client_thread_close(sftp, remote_file);
+		fclose(local_file);
+		return FALSE;
 	}
 
-	sftp_close(remote_file);
+	remmina_sftp_client_thread_close(sftp, remote_file);
 	fclose(local_file);
 	return TRUE;
 }
@@ -274,19 +651,21 @@ remmina_sftp_client_thread_recursive_dir(RemminaSFTPClient *client, RemminaSFTP
 	else
 		dir_path = g_strdup(rootdir_path);
 	tmp = remmina_ssh_unconvert(REMMINA_SSH(sftp), dir_path);
+	remmina_sftp_lock(sftp);
 	sftpdir = sftp_opendir(sftp->sftp_sess, tmp);
+	remmina_sftp_unlock(sftp);
 	g_free(tmp);
 
 	if (!sftpdir) {
-		remmina_sftp_client_thread_set_error(client, task, _("Could not open the folder “%s”. %s"),
-						     dir_path, ssh_get_error(REMMINA_SSH(client->sftp)->session));
+		remmina_sftp_client_thread_set_ssh_error(client, sftp, task, _("Could not open the folder “%s”. %s"),
+						      dir_path);
 		g_free(dir_path);
 		return FALSE;
 	}
 
 	g_free(dir_path);
 
-	while ((sftpattr = sftp_readdir(sftp->sftp_sess, sftpdir))) {
+	while ((sftpattr = remmina_sftp_client_thread_readdir(sftp, sftpdir))) {
 		if (g_strcmp0(sftpattr->name, ".") != 0 &&
 		    g_strcmp0(sftpattr->name, "..") != 0) {
 			GET_SFTPATTR_TYPE(sftpattr, type);
@@ -310,7 +689,8 @@ remmina_sftp_client_thread_recursive_dir(RemminaSFTPClient *client, RemminaSFTP
 				task->size += (gfloat)sftpattr->size;
 				g_ptr_array_add(array, file_path);
 
-				if (!remmina_sftp_client_thread_update_task(client, task)) {
+				remmina_ftp_client_set_task_progress(task);
+				if (THREAD_CHECK_EXIT) {
 					sftp_attributes_free(sftpattr);
 					break;
 				}
@@ -321,7 +701,9 @@ remmina_sftp_client_thread_recursive_dir(RemminaSFTPClient *client, RemminaSFTP
 		if (THREAD_CHECK_EXIT) break;
 	}
 
+	remmina_sftp_lock(sftp);
 	sftp_closedir(sftpdir);
+	remmina_sftp_unlock(sftp);
 	return ret;
 }
 
@@ -375,15 +757,19 @@ remmina_sftp_client_thread_mkdir(RemminaSFTPClient *client, RemminaSFTP *sftp, R
 {
 	TRACE_CALL(__func__);
 	sftp_attributes sftpattr;
+	gint ret;
 
+	remmina_sftp_lock(sftp);
 	sftpattr = sftp_stat(sftp->sftp_sess, path);
+	ret = sftpattr ? 0 : sftp_mkdir(sftp->sftp_sess, path, 0755);
+	remmina_sftp_unlock(sftp);
 	if (sftpattr != NULL) {
 		sftp_attributes_free(sftpattr);
 		return TRUE;
 	}
-	if (sftp_mkdir(sftp->sftp_sess, path, 0755) < 0) {
-		remmina_sftp_client_thread_set_error(client, task, _("Could not create the folder “%s” on the server. %s"),
-						     path, ssh_get_error(REMMINA_SSH(client->sftp)->session));
+	if (ret < 0) {
+		remmina_sftp_client_thread_set_ssh_error(client, sftp, task, _("Could not create the folder “%s” on the server. %s"),
+						      path);
 		return FALSE;
 	}
 	return TRUE;
@@ -397,8 +783,6 @@ remmina_sftp_client_thread_upload_file(RemminaSFTPClient *client, RemminaSFTP *s
 	sftp_file remote_file;
 	FILE *local_file;
 	gchar *tmp;
-	gchar buf[20480];
-	gint len;
 	sftp_attributes attr;
 	gint response;
 	uint64_t size;
@@ -406,15 +790,19 @@ remmina_sftp_client_thread_upload_file(RemminaSFTPClient *client, RemminaSFTP *s
 	if (THREAD_CHECK_EXIT) return FALSE;
 
 	tmp = remmina_ssh_unconvert(REMMINA_SSH(sftp), remote_path);
+	remmina_sftp_lock(sftp);
 	remote_file = sftp_open(sftp->sftp_sess, tmp, O_WRONLY | O_CREAT, 0644);
+	remmina_sftp_unlock(sftp);
 	g_free(tmp);
 
 	if (!remote_file) {
-		remmina_sftp_client_thread_set_error(client, task, _("Could not create the file “%s” on the server. %s"),
-						     remote_path, ssh_get_error(REMMINA_SSH(client->sftp)->session));
+		remmina_sftp_client_thread_set_ssh_error(client, sftp, task, _("Could not create the file “%s” on the server. %s"),
+						      remote_path);
 		return FALSE;
 	}
+	remmina_sftp_lock(sftp);
 	attr = sftp_fstat(remote_file);
+	remmina_sftp_unlock(sftp);
 	size = attr->size;
 	sftp_attributes_free(attr);
 	if (size > 0) {
@@ -422,18 +810,20 @@ remmina_sftp_client_thread_upload_file(RemminaSFTPClient *client, RemminaSFTP *s
 		switch (response) {
 		case GTK_RESPONSE_CANCEL:
 		case GTK_RESPONSE_DELETE_EVENT:
-			sftp_close(remote_file);
+			remmina_sftp_client_thread_close(sftp, remote_file);
 			remmina_sftp_client_thread_set_error(client, task, NULL);
 			return FALSE;
 
 		case GTK_RESPONSE_ACCEPT:
-			sftp_close(remote_file);
+			remmina_sftp_client_thread_close(sftp, remote_file);
 			tmp = remmina_ssh_unconvert(REMMINA_SSH(sftp), remote_path);
+			remmina_sftp_lock(sftp);
 			remote_file = sftp_open(sftp->sftp_sess, tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			remmina_sftp_unlock(sftp);
 			g_free(tmp);
 			if (!remote_file) {
-				remmina_sftp_client_thread_set_error(client, task, _("Could not create the file “%s” on the server. %s"),
-								     remote_path, ssh_get_error(REMMINA_SSH(client->sftp)->session));
+				remmina_sftp_client_thread_set_ssh_error(client, sftp, task, _("Could not create the file “%s” on the server. %s"),
+								      remote_path);
 				return FALSE;
 			}
 			size = 0;
@@ -441,9 +831,9 @@ remmina_sftp_client_thread_upload_file(RemminaSFTPClient *client, RemminaSFTP *s
 
 		case GTK_RESPONSE_APPLY:
 			if (sftp_seek64(remote_file, size) < 0) {
-				sftp_close(remote_file);
-				remmina_sftp_client_thread_set_error(client, task, "Could not download the file “%s”. %s",
-								     remote_path, ssh_get_error(REMMINA_SSH(client->sftp)->session));
+				remmina_sftp_client_thread_close(sftp, remote_file);
+				remmina_sftp_client_thread_set_ssh_error(client, sftp, task, "Could not download the file “%s”. %s",
+								      remote_path);
 				return FALSE;
 			}
 			break;
@@ -452,14 +842,14 @@ remmina_sftp_client_thread_upload_file(RemminaSFTPClient *client, RemminaSFTP *s
 
 	local_file = g_fopen(local_path, "rb");
 	if (!local_file) {
-		sftp_close(remote_file);
+		remmina_sftp_client_thread_close(sftp, remote_file);
 		remmina_sftp_client_thread_set_error(client, task, _("Could not open the file “%s”."), local_path);
 		return FALSE;
 	}
 
 	if (size > 0) {
 		if (fseeko(local_file, size, SEEK_SET) < 0) {
-			sftp_close(remote_file);
+			remmina_sftp_client_thread_close(sftp, remote_file);
 			fclose(local_file);
 			remmina_sftp_client_thread_set_error(client, task, "Could not find the local file “%s”.", local_path);
 			return FALSE;
@@ -467,26 +857,91 @@ remmina_sftp_client_thread_upload_file(RemminaSFTPClient *client, RemminaSFTP *s
 		*donesize = size;
 	}
 
-	while (!THREAD_CHECK_EXIT && (len = fread(buf, 1, sizeof(buf), local_file)) > 0) {
-		if (THREAD_CHECK_EXIT) break;
+	if (!remmina_sftp_client_thread_pipelined_write(client, sftp, task, remote_file, local_file, size,
+							remote_path, local_path, donesize)) {
+		remmina_sftp_client_thread_close(sftp, remote_file);
+		fclose(local_file);
+		return FALSE;
+	}
 
-		if (sftp_write(remote_file, buf, len) < len) {
-			sftp_close(remote_file);
-			fclose(local_file);
-			remmina_sftp_client_thread_set_error(client, task, _("Could not write to the file “%s” on the server. %s"),
-							     remote_path, ssh_get_error(REMMINA_SSH(client->sftp)->session));
-			return FALSE;
-		}
+	remmina_sftp_client_thread_close(sftp, remote_file);
+	fclose(local_file);
+	return TRUE;
+}
 
-		*donesize += (guint64)len;
-		task->donesize = (gfloat)(*donesize);
+/* The workers share one SSH connection, opened by the first one that needs
+ * it and closed by the last one done with it. Each worker gets its own SFTP
+ * channel on that connection. A libssh session cannot be driven by several
+ * threads at once, so their libssh calls are serialized by remmina_sftp_lock(),
+ * but the lock is not held while a worker waits for a reply. */
+static RemminaSFTP *
+remmina_sftp_client_thread_open_channel(RemminaSFTPClient *client, gchar **error)
+{
+	TRACE_CALL(__func__);
+	RemminaSFTP *transfer;
+	RemminaSFTP *sftp;
+	gchar *host;
+	int port;
 
-		if (!remmina_sftp_client_thread_update_task(client, task)) break;
+	*error = NULL;
+	pthread_mutex_lock(&client->transfer_mutex);
+	if (!client->transfer) {
+		transfer = remmina_sftp_new_from_ssh(REMMINA_SSH(client->sftp));
+
+		/* we may need to open a new tunnel too */
+		host = NULL;
+		port = 0;
+		if (!remmina_plugin_sftp_start_direct_tunnel(client->gp, &host, &port)) {
+			remmina_sftp_free(transfer);
+			pthread_mutex_unlock(&client->transfer_mutex);
+			return NULL;
+		}
+		(REMMINA_SSH(transfer))->tunnel_entrance_host = host;
+		(REMMINA_SSH(transfer))->tunnel_entrance_port = port;
+
+		/* Open a new connection for the transfers */
+		g_debug("[SFTPCLI] %s opening ssh session to %s:%d", __func__, host, port);
+		if (!remmina_ssh_init_session(REMMINA_SSH(transfer)) ||
+		    remmina_ssh_auth(REMMINA_SSH(transfer), REMMINA_SSH(transfer)->password, client->gp, NULL) != REMMINA_SSH_AUTH_SUCCESS) {
+			g_debug("[SFTPCLI] could not open the transfer session: %s\n", (REMMINA_SSH(transfer))->error);
+			*error = g_strdup((REMMINA_SSH(transfer))->error);
+			remmina_sftp_free(transfer);
+			pthread_mutex_unlock(&client->transfer_mutex);
+			return NULL;
+		}
+		client->transfer = transfer;
 	}
 
-	sftp_close(remote_file);
-	fclose(local_file);
-	return TRUE;
+	sftp = remmina_sftp_new_channel(client->transfer);
+	if (remmina_sftp_open(sftp)) {
+		client->transfer_users++;
+	} else {
+		g_debug("[SFTPCLI] remmina_sftp_open returned error %s\n", (REMMINA_SSH(sftp))->error);
+		*error = g_strdup((REMMINA_SSH(sftp))->error);
+		remmina_sftp_free(sftp);
+		sftp = NULL;
+		if (client->transfer_users == 0) {
+			remmina_sftp_free(client->transfer);
+			client->transfer = NULL;
+		}
+	}
+	pthread_mutex_unlock(&client->transfer_mutex);
+
+	return sftp;
+}
+
+static void
+remmina_sftp_client_thread_close_channel(RemminaSFTPClient *client, RemminaSFTP *sftp)
+{
+	TRACE_CALL(__func__);
+	pthread_mutex_lock(&client->transfer_mutex);
+	remmina_sftp_free(sftp);
+	client->transfer_users--;
+	if (client->transfer_users == 0) {
+		remmina_sftp_free(client->transfer);
+		client->transfer = NULL;
+	}
+	pthread_mutex_unlock(&client->transfer_mutex);
 }
 
 static gpointer
@@ -504,45 +959,18 @@ remmina_sftp_client_thread_main(gpointer data)
 	gboolean ret;
 	gchar *refreshdir = NULL;
 	gchar *tmp;
-	gboolean refresh = FALSE;
-	gchar *host;
-	int port;
 
-	task = remmina_sftp_client_thread_get_task(client);
+	task = remmina_sftp_client_thread_get_task(client, FALSE, &refreshdir);
 	while (task) {
 		size = 0;
 		if (!sftp) {
-			sftp = remmina_sftp_new_from_ssh(REMMINA_SSH(client->sftp));
-
-			/* we may need to open a new tunnel too */
-			host = NULL;
-			port = 0;
-			if (!remmina_plugin_sftp_start_direct_tunnel(client->gp, &host, &port))
-				return NULL;
-			(REMMINA_SSH(sftp))->tunnel_entrance_host = host;
-			(REMMINA_SSH(sftp))->tunnel_entrance_port = port;
-
-			/* Open a new connection for this subcommand */
-			g_debug("[SFTPCLI] %s opening ssh session to %s:%d", __func__, host, port);
-			if (!remmina_ssh_init_session(REMMINA_SSH(sftp))) {
-				g_debug("[SFTPCLI] remmina_ssh_init_session returned error %s\n", (REMMINA_SSH(sftp))->error);
-				remmina_sftp_client_thread_set_error(client, task, (REMMINA_SSH(sftp))->error);
-				remmina_ftp_task_free(task);
-				break;
-			}
-
-			if (remmina_ssh_auth(REMMINA_SSH(sftp), REMMINA_SSH(sftp)->password, client->gp, NULL) != REMMINA_SSH_AUTH_SUCCESS) {
-				g_debug("[SFTPCLI] remmina_ssh_auth returned error %s\n", (REMMINA_SSH(sftp))->error);
-				remmina_sftp_client_thread_set_error(client, task, (REMMINA_SSH(sftp))->error);
-				remmina_ftp_task_free(task);
-				break;
-			}
-
-			if (!remmina_sftp_open(sftp)) {
-				g_debug("[SFTPCLI] remmina_sftp_open returned error %s\n", (REMMINA_SSH(sftp))->error);
-				remmina_sftp_client_thread_set_error(client, task, (REMMINA_SSH(sftp))->error);
-				remmina_ftp_task_free(task);
-				break;
+			sftp = remmina_sftp_client_thread_open_channel(client, &tmp);
+			if (!sftp) {
+				remmina_sftp_client_thread_set_error(client, task, tmp);
+				g_free(tmp);
+				remmina_sftp_client_thread_put_task(client, task);
+				task = remmina_sftp_client_thread_get_task(client, TRUE, &refreshdir);
+				continue;
 			}
 		}
 
@@ -629,9 +1057,10 @@ remmina_sftp_client_thread_main(gpointer data)
 				remmina_sftp_client_thread_set_finish(client, task);
 				tmp = remmina_ftp_client_get_dir(REMMINA_FTP_CLIENT(client));
 				if (g_strcmp0(tmp, task->remotedir) == 0) {
-					refresh = TRUE;
-					g_free(refreshdir);
-					refreshdir = tmp;
+					pthread_mutex_lock(&client->queue_mutex);
+					g_free(client->refreshdir);
+					client->refreshdir = tmp;
+					pthread_mutex_unlock(&client->queue_mutex);
 				} else {
 					g_free(tmp);
 				}
@@ -642,25 +1071,22 @@ remmina_sftp_client_thread_main(gpointer data)
 		g_free(remote);
 		g_free(local);
 
-		remmina_ftp_task_free(task);
-		client->taskid = 0;
-
-		if (client->thread_abort) break;
+		remmina_sftp_client_thread_put_task(client, task);
 
-		task = remmina_sftp_client_thread_get_task(client);
+		task = remmina_sftp_client_thread_get_task(client, FALSE, &refreshdir);
 	}
 
 	if (sftp)
-		remmina_sftp_free(sftp);
+		remmina_sftp_client_thread_close_channel(client, sftp);
 
-	if (!client->thread_abort && refresh) {
+	if (!client->thread_abort && refreshdir) {
 		tmp = remmina_ftp_client_get_dir(REMMINA_FTP_CLIENT(client));
 		if (g_strcmp0(tmp, refreshdir) == 0)
 			IDLE_ADD((GSourceFunc)remmina_sftp_client_refresh, client);
 		g_free(tmp);
 	}
 	g_free(refreshdir);
-	client->thread = 0;
+	g_atomic_int_add(&client->num_threads, -1);
 
 	return NULL;
 }
@@ -675,13 +1101,19 @@ remmina_sftp_client_destroy(RemminaSFTPClient *client, gpointer data)
 		remmina_sftp_free(client->sftp);
 		client->sftp = NULL;
 	}
+	pthread_mutex_lock(&client->queue_mutex);
 	client->thread_abort = TRUE;
-	/* We will wait for the thread to quit itself, and hopefully the thread is handling things correctly */
-	while (client->thread) {
+	g_queue_foreach(&client->queue, (GFunc)remmina_ftp_task_free, NULL);
+	g_queue_clear(&client->queue);
+	pthread_mutex_unlock(&client->queue_mutex);
+	/* We will wait for the threads to quit themselves, and hopefully the threads are handling things correctly */
+	while (g_atomic_int_get(&client->num_threads)) {
 		/* gdk_threads_leave (); */
 		sleep(1);
 		/* gdk_threads_enter (); */
 	}
+	g_free(client->refreshdir);
+	client->refreshdir = NULL;
 }
 
 static sftp_dir
@@ -690,15 +1122,20 @@ remmina_sftp_client_sftp_session_opendir(RemminaSFTPClient *client, const gchar
 	TRACE_CALL(__func__);
 	sftp_dir sftpdir;
 	GtkWidget *dialog;
+	gchar *error;
 
+	/* The SSH connection may be shared with the transfers and other sessions */
+	remmina_sftp_lock(client->sftp);
 	sftpdir = sftp_opendir(client->sftp->sftp_sess, (gchar *)dir);
+	error = sftpdir ? NULL : g_strdup(ssh_get_error(REMMINA_SSH(client->sftp)->session));
+	remmina_sftp_unlock(client->sftp);
 	if (!sftpdir) {
 		dialog = gtk_message_dialog_new(GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(client))),
 						GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
-						_("Could not open the folder “%s”. %s"), dir,
-						ssh_get_error(REMMINA_SSH(client->sftp)->session));
+						_("Could not open the folder “%s”. %s"), dir, error);
 		gtk_dialog_run(GTK_DIALOG(dialog));
 		gtk_widget_destroy(dialog);
+		g_free(error);
 		return NULL;
 	}
 	return sftpdir;
@@ -709,16 +1146,23 @@ remmina_sftp_client_sftp_session_closedir(RemminaSFTPClient *client, sftp_dir sf
 {
 	TRACE_CALL(__func__);
 	GtkWidget *dialog;
+	gchar *error;
 
 	if (!sftp_dir_eof(sftpdir)) {
+		remmina_sftp_lock(client->sftp);
+		error = g_strdup(ssh_get_error(REMMINA_SSH(client->sftp)->session));
+		remmina_sftp_unlock(client->sftp);
 		dialog = gtk_message_dialog_new(GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(client))),
 						GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
-						_("Could not read from the folder. %s"), ssh_get_error(REMMINA_SSH(client->sftp)->session));
+						_("Could not read from the folder. %s"), error);
 		gtk_dialog_run(GTK_DIALOG(dialog));
 		gtk_widget_destroy(dialog);
+		g_free(error);
 		return FALSE;
 	}
+	remmina_sftp_lock(client->sftp);
 	sftp_closedir(sftpdir);
+	remmina_sftp_unlock(client->sftp);
 	return TRUE;
 }
 
@@ -731,6 +1175,7 @@ remmina_sftp_client_on_opendir(RemminaSFTPClient *client, gchar *dir, gpointer d
 	GtkWidget *dialog;
 	gchar *newdir;
 	gchar *newdir_conv;
+	gchar *error;
 	gchar *tmp;
 	gint type;
 
@@ -751,20 +1196,24 @@ remmina_sftp_client_on_opendir(RemminaSFTPClient *client, gchar *dir, gpointer d
 	}
 
 	tmp = remmina_ssh_unconvert(REMMINA_SSH(client->sftp), newdir);
+	remmina_sftp_lock(client->sftp);
 	newdir_conv = sftp_canonicalize_path(client->sftp->sftp_sess, tmp);
+	error = newdir_conv ? NULL : g_strdup(ssh_get_error(REMMINA_SSH(client->sftp)->session));
+	remmina_sftp_unlock(client->sftp);
 	g_free(tmp);
 	g_free(newdir);
 	newdir = remmina_ssh_convert(REMMINA_SSH(client->sftp), newdir_conv);
 	if (!newdir) {
 		dialog = gtk_message_dialog_new(NULL,
 						GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
-						_("Could not open the folder “%s”. %s"), dir,
-						ssh_get_error(REMMINA_SSH(client->sftp)->session));
+						_("Could not open the folder “%s”. %s"), dir, error);
 		gtk_widget_show(dialog);
 		g_signal_connect(G_OBJECT(dialog), "response", G_CALLBACK(gtk_widget_destroy), NULL);
 		g_free(newdir_conv);
+		g_free(error);
 		return;
 	}
+	g_free(error);
 
 	sftpdir = remmina_sftp_client_sftp_session_opendir(client, newdir_conv);
 	g_free(newdir_conv);
@@ -775,7 +1224,7 @@ remmina_sftp_client_on_opendir(RemminaSFTPClient *client, gchar *dir, gpointer d
 
 	remmina_ftp_client_clear_file_list(REMMINA_FTP_CLIENT(client));
 
-	while ((sftpattr = sftp_readdir(client->sftp->sftp_sess, sftpdir))) {
+	while ((sftpattr = remmina_sftp_client_thread_readdir(client->sftp, sftpdir))) {
 		if (g_strcmp0(sftpattr->name, ".") != 0 &&
 		    g_strcmp0(sftpattr->name, "..") != 0) {
 			GET_SFTPATTR_TYPE(sftpattr, type);
@@ -803,20 +1252,65 @@ static void
 remmina_sftp_client_on_newtask(RemminaSFTPClient *client, gpointer data)
 {
 	TRACE_CALL(__func__);
-	if (client->thread) return;
+	GList *tasks, *l;
+	pthread_t thread;
+	gint max_workers;
+
+	tasks = remmina_ftp_client_take_new_tasks(REMMINA_FTP_CLIENT(client));
+	if (!tasks) return;
+
+	max_workers = CLAMP(remmina_pref.sftp_parallel_transfers, 1, SFTP_MAX_PARALLEL_TRANSFERS);
+
+	pthread_mutex_lock(&client->queue_mutex);
+	for (l = tasks; l; l = l->next)
+		g_queue_push_tail(&client->queue, l->data);
+	g_list_free(tasks);
+
+	/* Start a worker for each queued task that no idle worker will take */
+	while (client->num_workers < max_workers &&
+	       client->num_workers - (gint)g_list_length(client->running) < (gint)g_queue_get_length(&client->queue)) {
+		g_atomic_int_inc(&client->num_threads);
+		if (pthread_create(&thread, NULL, remmina_sftp_client_thread_main, client)) {
+			g_atomic_int_add(&client->num_threads, -1);
+			break;
+		}
+		pthread_detach(thread);
+		client->num_workers++;
+	}
+	pthread_mutex_unlock(&client->queue_mutex);
+}
 
-	if (pthread_create(&client->thread, NULL, remmina_sftp_client_thread_main, client))
-		client->thread = 0;
+static RemminaFTPTask *
+remmina_sftp_client_find_task(GList *list, gint taskid)
+{
+	TRACE_CALL(__func__);
+	for (; list; list = list->next)
+		if (((RemminaFTPTask *)list->data)->taskid == taskid)
+			return (RemminaFTPTask *)list->data;
+	return NULL;
 }
 
 static gboolean
 remmina_sftp_client_on_canceltask(RemminaSFTPClient *client, gint taskid, gpointer data)
 {
 	TRACE_CALL(__func__);
+	RemminaFTPTask *task;
 	GtkWidget *dialog;
 	gint ret;
 
-	if (client->taskid != taskid) return TRUE;
+	/* A task still in the queue is simply dropped */
+	pthread_mutex_lock(&client->queue_mutex);
+	task = remmina_sftp_client_find_task(client->queue.head, taskid);
+	if (task)
+		g_queue_remove(&client->queue, task);
+	ret = remmina_sftp_client_find_task(client->running, taskid) != NULL;
+	pthread_mutex_unlock(&client->queue_mutex);
+
+	if (task) {
+		remmina_ftp_task_free(task);
+		return TRUE;
+	}
+	if (!ret) return TRUE;
 
 	dialog = gtk_message_dialog_new(GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(client))),
 					GTK_DIALOG_MODAL, GTK_MESSAGE_QUESTION, GTK_BUTTONS_YES_NO,
@@ -824,8 +1318,11 @@ remmina_sftp_client_on_canceltask(RemminaSFTPClient *client, gint taskid, gpoint
 	ret = gtk_dialog_run(GTK_DIALOG(dialog));
 	gtk_widget_destroy(dialog);
 	if (ret == GTK_RESPONSE_YES) {
-		/* Make sure we are still handling the same task before we clear the flag */
-		if (client->taskid == taskid) client->taskid = 0;
+		/* Make sure the task is still running before we set the flag */
+		pthread_mutex_lock(&client->queue_mutex);
+		task = remmina_sftp_client_find_task(client->running, taskid);
+		if (task) g_atomic_int_set(&task->cancelled, 1);
+		pthread_mutex_unlock(&client->queue_mutex);
 		return TRUE;
 	}
 	return FALSE;
@@ -837,9 +1334,11 @@ remmina_sftp_client_on_deletefile(RemminaSFTPClient *client, gint type, gchar *n
 	TRACE_CALL(__func__);
 	GtkWidget *dialog;
 	gint ret = 0;
+	gchar *error;
 	gchar *tmp;
 
 	tmp = remmina_ssh_unconvert(REMMINA_SSH(client->sftp), name);
+	remmina_sftp_lock(client->sftp);
 	switch (type) {
 	case REMMINA_FTP_FILE_TYPE_DIR:
 		ret = sftp_rmdir(client->sftp->sftp_sess, tmp);
@@ -849,15 +1348,17 @@ remmina_sftp_client_on_deletefile(RemminaSFTPClient *client, gint type, gchar *n
 		ret = sftp_unlink(client->sftp->sftp_sess, tmp);
 		break;
 	}
+	error = ret != 0 ? g_strdup(ssh_get_error(REMMINA_SSH(client->sftp)->session)) : NULL;
+	remmina_sftp_unlock(client->sftp);
 	g_free(tmp);
 
 	if (ret != 0) {
 		dialog = gtk_message_dialog_new(GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(client))),
 						GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
-						_("Could not delete “%s”. %s"),
-						name, ssh_get_error(REMMINA_SSH(client->sftp)->session));
+						_("Could not delete “%s”. %s"), name, error);
 		gtk_dialog_run(GTK_DIALOG(dialog));
 		gtk_widget_destroy(dialog);
+		g_free(error);
 		return FALSE;
 	}
 	return TRUE;
@@ -868,9 +1369,17 @@ remmina_sftp_client_init(RemminaSFTPClient *client)
 {
 	TRACE_CALL(__func__);
 	client->sftp = NULL;
-	client->thread = 0;
-	client->taskid = 0;
+	pthread_mutex_init(&client->queue_mutex, NULL);
+	g_queue_init(&client->queue);
+	client->running = NULL;
+	client->num_workers = 0;
+	client->num_threads = 0;
 	client->thread_abort = FALSE;
+	client->refreshdir = NULL;
+	client->bandwidth_next = 0;
+	pthread_mutex_init(&client->transfer_mutex, NULL);
+	client->transfer = NULL;
+	client->transfer_users = 0;
 
 	/* Setup the internal signals */
 	g_signal_connect(G_OBJECT(client), "destroy",
@@ -58,9 +58,23 @@ typedef struct _RemminaSFTPClient {
 
 	RemminaSFTP *		sftp;
 
-	pthread_t		thread;
-	gint			taskid;
+	/* Transfer queue, served by up to sftp_parallel_transfers worker threads */
+	pthread_mutex_t		queue_mutex;
+	GQueue			queue;
+	GList *			running;
+	gint			num_workers;
+	/* Worker threads still alive, including the ones leaving the pool */
+	gint			num_threads;
 	gboolean		thread_abort;
+	/* Folder to refresh once the last worker is done */
+	gchar *			refreshdir;
+	/* Time at which the bandwidth cap allows the next transfer */
+	gint64			bandwidth_next;
+	/* SSH connection shared by the workers, each with its own SFTP channel.
+	 * transfer_mutex guards opening and closing it, not its use */
+	pthread_mutex_t		transfer_mutex;
+	RemminaSFTP *		transfer;
+	gint			transfer_users;
 	RemminaProtocolWidget * gp;
 } RemminaSFTPClient;
 
@@ -0,0 +1,217 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+
+#include <glib.h>
+#include "remmina_sftp_pipeline.h"
+#include "remmina/remmina_trace_calls.h"
+
+/* Discard the requests still in flight after the transfer stopped */
+static void
+remmina_sftp_pipeline_discard(const RemminaSFTPPipelineOps *ops, gpointer user_data,
+			      RemminaSFTPRequest *reqs, gint window, gint first, gint count)
+{
+	while (count-- > 0) {
+		ops->discard(user_data, &reqs[first]);
+		first = (first + 1) % window;
+	}
+}
+
+/* Download from offset to the end of file, keeping up to window read
+ * requests in flight to hide the round trip time */
+RemminaSFTPPipelineResult
+remmina_sftp_pipeline_read(const RemminaSFTPPipelineOps *ops, gpointer user_data,
+			   gint window, gsize max_chunk, guint64 offset)
+{
+	TRACE_CALL(__func__);
+	RemminaSFTPPipelineResult result;
+	RemminaSFTPRequest *reqs, *req;
+	gint first, count, full_reads;
+	gboolean stop, resync;
+	gsize chunk;
+	gchar *buf;
+	gssize len;
+
+	chunk = MIN(REMMINA_SFTP_CHUNK_INITIAL, max_chunk);
+	reqs = g_new0(RemminaSFTPRequest, window);
+	buf = g_malloc(max_chunk);
+	first = count = full_reads = 0;
+	stop = resync = FALSE;
+	result = REMMINA_SFTP_PIPELINE_DONE;
+
+	while (TRUE) {
+		/* Requests behind a short read are all drained */
+		if (resync && count == 0)
+			resync = FALSE;
+
+		/* Keep the pipeline full */
+		while (!stop && !resync && count < window) {
+			if (ops->cancelled(user_data)) {
+				result = REMMINA_SFTP_PIPELINE_CANCELLED;
+				stop = TRUE;
+				break;
+			}
+			req = &reqs[(first + count) % window];
+			req->offset = offset;
+			req->len = chunk;
+			if (!ops->read_begin(user_data, req)) {
+				result = REMMINA_SFTP_PIPELINE_REMOTE_ERROR;
+				stop = TRUE;
+				break;
+			}
+			offset += chunk;
+			count++;
+		}
+		if (count == 0)
+			break;
+
+		/* Collect the oldest request, even when the server answered a
+		 * later one first */
+		req = &reqs[first];
+		len = ops->read_wait(user_data, req, buf);
+		first = (first + 1) % window;
+		count--;
+
+		if (len < 0) {
+			if (result == REMMINA_SFTP_PIPELINE_DONE)
+				result = REMMINA_SFTP_PIPELINE_REMOTE_ERROR;
+			break;
+		}
+		if (stop || resync)
+			/* Discarding the replies after an error, the end of file, a
+			 * cancel, or behind a short read */
+			continue;
+
+		if (len == 0) {
+			stop = TRUE;
+			continue;
+		}
+
+		if (!ops->deliver(user_data, buf, len)) {
+			result = REMMINA_SFTP_PIPELINE_LOCAL_ERROR;
+			stop = TRUE;
+			continue;
+		}
+
+		if ((gsize)len < req->len) {
+			/* The server capped the payload, or the file ends here. The
+			 * requests behind this one would leave a gap: drop them and
+			 * restart after the received data with the size the server accepts */
+			chunk = MAX((gsize)len, REMMINA_SFTP_CHUNK_MIN);
+			max_chunk = MIN(max_chunk, chunk);
+			chunk = MIN(chunk, max_chunk);
+			full_reads = 0;
+			offset = req->offset + len;
+			resync = TRUE;
+		} else if (++full_reads >= REMMINA_SFTP_CHUNK_GROW_AFTER && chunk < max_chunk) {
+			chunk = MIN(chunk * 2, max_chunk);
+			full_reads = 0;
+		}
+	}
+
+	/* Requests left after a fatal error */
+	remmina_sftp_pipeline_discard(ops, user_data, reqs, window, first, count);
+
+	g_free(buf);
+	g_free(reqs);
+	return result;
+}
+
+/* Upload from offset, keeping up to window write requests in flight */
+RemminaSFTPPipelineResult
+remmina_sftp_pipeline_write(const RemminaSFTPPipelineOps *ops, gpointer user_data,
+			    gint window, gsize chunk, guint64 offset)
+{
+	TRACE_CALL(__func__);
+	RemminaSFTPPipelineResult result;
+	RemminaSFTPRequest *reqs, *req;
+	gint first, count;
+	gssize len, written;
+	gchar *buf;
+
+	reqs = g_new0(RemminaSFTPRequest, window);
+	buf = g_malloc(chunk);
+	first = count = 0;
+	result = REMMINA_SFTP_PIPELINE_DONE;
+
+	while (TRUE) {
+		while (result == REMMINA_SFTP_PIPELINE_DONE && count < window) {
+			if (ops->cancelled(user_data)) {
+				result = REMMINA_SFTP_PIPELINE_CANCELLED;
+				break;
+			}
+			len = ops->fill(user_data, buf, chunk);
+			if (len < 0) {
+				result = REMMINA_SFTP_PIPELINE_LOCAL_ERROR;
+				break;
+			}
+			if (len == 0)
+				break;
+			req = &reqs[(first + count) % window];
+			req->offset = offset;
+			req->len = len;
+			if (!ops->write_begin(user_data, req, buf)) {
+				result = REMMINA_SFTP_PIPELINE_REMOTE_ERROR;
+				break;
+			}
+			offset += len;
+			count++;
+		}
+		if (count == 0)
+			break;
+
+		req = &reqs[first];
+		written = ops->write_wait(user_data, req);
+		first = (first + 1) % window;
+		count--;
+
+		if (written < 0 || (gsize)written < req->len) {
+			/* A short write would leave a hole, the requests behind it
+			 * are collected but the upload fails */
+			if (result == REMMINA_SFTP_PIPELINE_DONE)
+				result = REMMINA_SFTP_PIPELINE_REMOTE_ERROR;
+			if (written < 0)
+				break;
+		} else if (result == REMMINA_SFTP_PIPELINE_DONE) {
+			ops->written(user_data, written);
+		}
+	}
+
+	/* Requests left after a fatal error */
+	remmina_sftp_pipeline_discard(ops, user_data, reqs, window, first, count);
+
+	g_free(buf);
+	g_free(reqs);
+	return result;
+}
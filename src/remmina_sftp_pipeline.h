@@ -0,0 +1,99 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Payload of the first read request, grown while the server returns full chunks */
+#define REMMINA_SFTP_CHUNK_INITIAL (32 * 1024)
+#define REMMINA_SFTP_CHUNK_MIN     (4 * 1024)
+/* Upper bound when the server does not advertise its limits */
+#define REMMINA_SFTP_CHUNK_MAX     (256 * 1024)
+/* Full reads needed before doubling the read chunk size */
+#define REMMINA_SFTP_CHUNK_GROW_AFTER 8
+
+typedef struct _RemminaSFTPRequest {
+	/* Owned by the I/O callbacks, e.g. the libssh request */
+	gpointer	handle;
+	guint64		offset;
+	gsize		len;
+} RemminaSFTPRequest;
+
+/**
+ * I/O of a pipelined transfer. Requests are sent in file order and their
+ * replies are collected in the same order, whatever order the server
+ * answers them in.
+ */
+typedef struct _RemminaSFTPPipelineOps {
+	/* Send a request for req->len bytes at req->offset */
+	gboolean (*read_begin)(gpointer user_data, RemminaSFTPRequest *req);
+	/* Wait for the reply to req: bytes read, 0 at end of file, < 0 on error */
+	gssize (*read_wait)(gpointer user_data, RemminaSFTPRequest *req, gchar *buf);
+	/* Store data received in file order, FALSE on error */
+	gboolean (*deliver)(gpointer user_data, const gchar *buf, gsize len);
+
+	/* Read up to len bytes to upload: bytes read, 0 at end of file, < 0 on error */
+	gssize (*fill)(gpointer user_data, gchar *buf, gsize len);
+	/* Send buf as req->len bytes at req->offset, buf can be reused on return */
+	gboolean (*write_begin)(gpointer user_data, RemminaSFTPRequest *req, const gchar *buf);
+	/* Wait for the reply to req: bytes written, < 0 on error */
+	gssize (*write_wait)(gpointer user_data, RemminaSFTPRequest *req);
+	/* Data acknowledged by the server */
+	void (*written)(gpointer user_data, gsize len);
+
+	/* Forget a request whose reply will not be collected */
+	void (*discard)(gpointer user_data, RemminaSFTPRequest *req);
+	/* TRUE when the transfer must stop */
+	gboolean (*cancelled)(gpointer user_data);
+} RemminaSFTPPipelineOps;
+
+typedef enum {
+	REMMINA_SFTP_PIPELINE_DONE,
+	REMMINA_SFTP_PIPELINE_CANCELLED,
+	/* A request failed on the server side */
+	REMMINA_SFTP_PIPELINE_REMOTE_ERROR,
+	/* deliver() or fill() failed */
+	REMMINA_SFTP_PIPELINE_LOCAL_ERROR
+} RemminaSFTPPipelineResult;
+
+RemminaSFTPPipelineResult remmina_sftp_pipeline_read(const RemminaSFTPPipelineOps *ops, gpointer user_data,
+						     gint window, gsize max_chunk, guint64 offset);
+RemminaSFTPPipelineResult remmina_sftp_pipeline_write(const RemminaSFTPPipelineOps *ops, gpointer user_data,
+						      gint window, gsize chunk, guint64 offset);
+
+G_END_DECLS
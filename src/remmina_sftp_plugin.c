@@ -251,6 +251,9 @@ remmina_plugin_sftp_close_connection(RemminaProtocolWidget *gp)
 	if (gpdata->thread) {
 		pthread_cancel(gpdata->thread);
 		if (gpdata->thread) pthread_join(gpdata->thread, NULL);
+		/* Whatever it was doing with the SSH connection is lost */
+		if (gpdata->sftp)
+			remmina_ssh_set_cancelled(REMMINA_SSH(gpdata->sftp));
 	}
 
 	remmina_ftp_client_save_state(REMMINA_FTP_CLIENT(gpdata->client), remminafile);
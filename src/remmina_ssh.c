@@ -46,7 +46,9 @@
 #include <libssh/libssh.h>
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include <time.h>
 #include <sys/types.h>
@@ -78,6 +80,10 @@
 #ifdef HAVE_PTY_H
 #include <pty.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#include <poll.h>
 #include "remmina_public.h"
 #include "remmina/types.h"
 #include "remmina_file.h"
@@ -104,8 +110,8 @@
 *                           SSH Base                                          *
 *-----------------------------------------------------------------------------*/
 
-#define LOCK_SSH(ssh) pthread_mutex_lock(&REMMINA_SSH(ssh)->ssh_mutex);
-#define UNLOCK_SSH(ssh) pthread_mutex_unlock(&REMMINA_SSH(ssh)->ssh_mutex);
+#define LOCK_SSH(ssh) remmina_ssh_lock(REMMINA_SSH(ssh));
+#define UNLOCK_SSH(ssh) remmina_ssh_unlock(REMMINA_SSH(ssh));
 
 static const gchar *common_identities[] =
 {
@@ -573,8 +579,9 @@ remmina_ssh_auth_gssapi(RemminaSSH *ssh)
 	return REMMINA_SSH_AUTH_FATAL_ERROR;
 }
 
-enum remmina_ssh_auth_result
-remmina_ssh_auth(RemminaSSH *ssh, const gchar *password, RemminaProtocolWidget *gp, RemminaFile *remminafile)
+/* Authenticate our own session, see remmina_ssh_auth() */
+static enum remmina_ssh_auth_result
+remmina_ssh_auth_session(RemminaSSH *ssh, RemminaProtocolWidget *gp, RemminaFile *remminafile)
 {
 	TRACE_CALL(__func__);
 	gint method;
@@ -599,16 +606,6 @@ remmina_ssh_auth(RemminaSSH *ssh, const gchar *password, RemminaProtocolWidget *
 		return REMMINA_SSH_AUTH_AUTHFAILED_RETRY_AFTER_PROMPT;
 	}
 
-	if (password) {
-		if (password != ssh->password) {
-			g_free(ssh->password);
-			ssh->password = NULL;
-		}
-		if (password != ssh->passphrase) g_free(ssh->passphrase);
-		ssh->password = g_strdup(password);
-		ssh->passphrase = g_strdup(password);
-	}
-
 	/** @todo Here we should call
 	 * gint method;
 	 * method = ssh_userauth_list(ssh->session, NULL);
@@ -883,7 +880,8 @@ remmina_ssh_auth_gui(RemminaSSH *ssh, RemminaProtocolWidget *gp, RemminaFile *re
 	gboolean save_password;
 	gint attempt;
 
-	/* Check if the server’s public key is known */
+	/* Check if the server’s public key is known. The server of a shared
+	 * connection is checked by remmina_ssh_init_session() under its lock */
 #if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 9, 0)
 	/* TODO: Add error checking
 	 * SSH_KNOWN_HOSTS_OK: The server is known and has not changed.
@@ -893,7 +891,7 @@ remmina_ssh_auth_gui(RemminaSSH *ssh, RemminaProtocolWidget *gp, RemminaFile *re
 	 * SSH_KNOWN_HOSTS_NOT_FOUND: The known host file does not exist. The host is thus unknown. File will be created if host key is accepted.
 	 * SSH_KNOWN_HOSTS_ERROR: There had been an error checking the host.
 	 */
-	ret = ssh_session_is_known_server(ssh->session);
+	ret = ssh->connection ? SSH_KNOWN_HOSTS_OK : ssh_session_is_known_server(ssh->session);
 	switch (ret) {
 	case SSH_KNOWN_HOSTS_OK:
 		break;                                                  /* ok */
@@ -904,7 +902,7 @@ remmina_ssh_auth_gui(RemminaSSH *ssh, RemminaProtocolWidget *gp, RemminaFile *re
 	case SSH_KNOWN_HOSTS_UNKNOWN:
 	case SSH_KNOWN_HOSTS_NOT_FOUND:
 #else
-	ret = ssh_is_server_known(ssh->session);
+	ret = ssh->connection ? SSH_SERVER_KNOWN_OK : ssh_is_server_known(ssh->session);
 	switch (ret) {
 	case SSH_SERVER_KNOWN_OK:
 		break;                                                                  /* ok */
@@ -1153,6 +1151,433 @@ remmina_ssh_log_callback(ssh_session session, int priority, const char *message,
 	REMMINA_DEBUG(message);
 }
 
+/*-----------------------------------------------------------------------------*
+*                           SSH shared connections                            *
+*-----------------------------------------------------------------------------*/
+
+/* SFTP clients and SSH shells to the same account share one authenticated
+ * connection, each of them opening its own channels on it. Once its owner is
+ * authenticated, a connection is offered to the sessions resolving the very
+ * same options, and remmina_ssh_auth() only lets in the ones coming with the
+ * same credentials. The last user gone, the connection is kept open for
+ * remmina_pref.ssh_session_pool_timeout seconds.
+ *
+ * A libssh session cannot be driven by several threads at once, so every
+ * libssh call on a shared session is made between remmina_ssh_lock() and
+ * remmina_ssh_unlock(). Tunnels keep their own connection: their event loop
+ * waits on the session socket and calls libssh without the lock. */
+
+/* Seconds between two scans for expired idle connections */
+#define REMMINA_SSH_CONNECTION_SWEEP_INTERVAL 5
+
+/* Milliseconds an idle connection has to answer before it is considered dead */
+#define REMMINA_SSH_CONNECTION_PROBE_TIMEOUT 3000
+
+/* Milliseconds between two looks at a channel while other sessions use the
+ * connection: they may have read its data off the socket */
+#define REMMINA_SSH_CONNECTION_POLL_INTERVAL 20
+
+struct _RemminaSSHConnection {
+	ssh_session	session;
+	ssh_callbacks	callback;
+	pthread_mutex_t mutex;
+	/* Options from remmina_ssh_connection_key(), and checksum of the
+	 * credentials the connection was authenticated with */
+	gchar *		key;
+	gchar *		secret;
+	/* Sessions using the connection, changed under ssh_connection_mutex */
+	gint		refcount;
+	gint64		idle_since;
+	/* Left behind by a cancelled thread, never offered again */
+	gboolean	broken;
+};
+
+static GMutex ssh_connection_mutex;
+/* Key -> RemminaSSHConnection offered to new sessions */
+static GHashTable *ssh_connections;
+static guint ssh_connection_timer;
+/* ssh_disconnect() may block on a dead network: connections are closed there,
+ * never from the main loop */
+static GThreadPool *ssh_connection_closer;
+
+/* Serialize the libssh calls on the session of ssh. The thread cannot be
+ * cancelled before remmina_ssh_unlock(), so it never leaves the session in
+ * the middle of a packet */
+static void
+remmina_ssh_lock(RemminaSSH *ssh)
+{
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	pthread_mutex_lock(ssh->connection ? &ssh->connection->mutex : &ssh->ssh_mutex);
+}
+
+static void
+remmina_ssh_unlock(RemminaSSH *ssh)
+{
+	pthread_mutex_unlock(ssh->connection ? &ssh->connection->mutex : &ssh->ssh_mutex);
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+}
+
+/* Whether other sessions use the connection of ssh right now */
+static gboolean
+remmina_ssh_connection_busy(RemminaSSH *ssh)
+{
+	return ssh->connection && g_atomic_int_get(&ssh->connection->refcount) > 1;
+}
+
+/* Everything deciding what a connection is allowed to do, taken once all the
+ * options are resolved, ssh_config included. NULL if it cannot be shared */
+static gchar *
+remmina_ssh_connection_key(RemminaSSH *ssh)
+{
+	TRACE_CALL(__func__);
+	/* A session going through another Remmina tunnel dies with that tunnel */
+	if (ssh->is_tunnel || ssh->tunnel_entrance_host == NULL ||
+	    g_strcmp0(ssh->tunnel_entrance_host, "127.0.0.1") == 0)
+		return NULL;
+
+	return g_strdup_printf("%s@%s:%d|auth=%d|%s|%s|proxy=%s|kex=%s|ciphers=%s|hostkeys=%s|strict=%d|compression=%s",
+			       ssh->user ? ssh->user : "",
+			       ssh->tunnel_entrance_host, ssh->tunnel_entrance_port,
+			       ssh->auth,
+			       ssh->privkeyfile ? ssh->privkeyfile : "",
+			       ssh->certfile ? ssh->certfile : "",
+			       ssh->proxycommand ? ssh->proxycommand : "",
+			       ssh->kex_algorithms ? ssh->kex_algorithms : "",
+			       ssh->ciphers ? ssh->ciphers : "",
+			       ssh->hostkeytypes ? ssh->hostkeytypes : "",
+			       ssh->stricthostkeycheck,
+			       ssh->compression ? ssh->compression : "");
+}
+
+/* Credentials are only kept as a checksum */
+static gchar *
+remmina_ssh_connection_secret(RemminaSSH *ssh)
+{
+	TRACE_CALL(__func__);
+	gchar *credentials;
+	gchar *secret;
+
+	credentials = g_strdup_printf("%s\n%s\n%s",
+				      ssh->password ? ssh->password : "",
+				      ssh->passphrase ? ssh->passphrase : "",
+				      g_getenv("SSH_AUTH_SOCK") ? g_getenv("SSH_AUTH_SOCK") : "");
+	secret = g_compute_checksum_for_string(G_CHECKSUM_SHA256, credentials, -1);
+	g_free(credentials);
+	return secret;
+}
+
+static void
+remmina_ssh_connection_close(gpointer data, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHConnection *conn = (RemminaSSHConnection *)data;
+
+	ssh_disconnect(conn->session);
+	ssh_free(conn->session);
+	g_free(conn->callback);
+	pthread_mutex_destroy(&conn->mutex);
+	g_free(conn->key);
+	g_free(conn->secret);
+	g_free(conn);
+}
+
+/* Stop offering conn to new sessions. Called with ssh_connection_mutex held */
+static void
+remmina_ssh_connection_withdraw(RemminaSSHConnection *conn)
+{
+	TRACE_CALL(__func__);
+	conn->broken = TRUE;
+	if (ssh_connections && g_hash_table_lookup(ssh_connections, conn->key) == conn)
+		g_hash_table_remove(ssh_connections, conn->key);
+}
+
+/* Hand conn over to the closing thread. Called with ssh_connection_mutex held */
+static void
+remmina_ssh_connection_close_later(RemminaSSHConnection *conn)
+{
+	TRACE_CALL(__func__);
+	remmina_ssh_connection_withdraw(conn);
+	if (!ssh_connection_closer)
+		ssh_connection_closer = g_thread_pool_new(remmina_ssh_connection_close, NULL, 1, FALSE, NULL);
+	g_thread_pool_push(ssh_connection_closer, conn, NULL);
+}
+
+static gboolean
+remmina_ssh_connection_sweep(gpointer data)
+{
+	TRACE_CALL(__func__);
+	GHashTableIter iter;
+	RemminaSSHConnection *conn;
+	GSList *expired = NULL;
+	GSList *l;
+	gint64 deadline;
+	gboolean keep;
+
+	deadline = g_get_monotonic_time() - (gint64)remmina_pref.ssh_session_pool_timeout * G_USEC_PER_SEC;
+
+	g_mutex_lock(&ssh_connection_mutex);
+	g_hash_table_iter_init(&iter, ssh_connections);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&conn))
+		if (conn->refcount == 0 && conn->idle_since <= deadline)
+			expired = g_slist_prepend(expired, conn);
+	for (l = expired; l; l = l->next)
+		remmina_ssh_connection_close_later((RemminaSSHConnection *)l->data);
+	keep = g_hash_table_size(ssh_connections) > 0;
+	if (!keep)
+		ssh_connection_timer = 0;
+	g_mutex_unlock(&ssh_connection_mutex);
+
+	if (expired)
+		REMMINA_DEBUG("Closing %u idle shared SSH connections", g_slist_length(expired));
+	g_slist_free(expired);
+
+	return keep ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+/* Drop a user of conn. Called with ssh_connection_mutex held. An idle
+ * connection is closed by remmina_ssh_connection_sweep(), a broken one now */
+static void
+remmina_ssh_connection_unref(RemminaSSHConnection *conn)
+{
+	TRACE_CALL(__func__);
+	if (!g_atomic_int_dec_and_test(&conn->refcount))
+		return;
+
+	if (conn->broken || !ssh_is_connected(conn->session)) {
+		remmina_ssh_connection_close_later(conn);
+		return;
+	}
+	conn->idle_since = g_get_monotonic_time();
+	if (!ssh_connection_timer)
+		ssh_connection_timer = g_timeout_add_seconds(REMMINA_SSH_CONNECTION_SWEEP_INTERVAL, remmina_ssh_connection_sweep, NULL);
+}
+
+/* Check that the server still answers on an idle connection: a server or a
+ * network gone meanwhile is only noticed on use */
+static gboolean
+remmina_ssh_connection_probe(ssh_session session)
+{
+	TRACE_CALL(__func__);
+	ssh_channel channel;
+	struct pollfd pfd;
+	gint64 deadline;
+	gint timeout;
+	gint rc;
+
+	if (!ssh_is_connected(session) || (channel = ssh_channel_new(session)) == NULL)
+		return FALSE;
+
+	/* Opening a channel needs an answer from the server. Do it without
+	 * blocking, so a dead network does not hang the caller */
+	ssh_set_blocking(session, 0);
+	deadline = g_get_monotonic_time() + REMMINA_SSH_CONNECTION_PROBE_TIMEOUT * 1000;
+	while ((rc = ssh_channel_open_session(channel)) == SSH_AGAIN) {
+		timeout = (gint)((deadline - g_get_monotonic_time()) / 1000);
+		if (timeout <= 0)
+			break;
+		pfd.fd = ssh_get_fd(session);
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, timeout) < 0 && errno != EINTR)
+			break;
+	}
+	ssh_set_blocking(session, 1);
+
+	if (rc == SSH_OK)
+		ssh_channel_close(channel);
+	ssh_channel_free(channel);
+
+	return rc == SSH_OK && ssh_is_connected(session);
+}
+
+/* Use an authenticated connection opened with the same options as ssh,
+ * instead of connecting the session ssh has prepared. remmina_ssh_auth()
+ * checks the credentials before anything goes through it */
+static gboolean
+remmina_ssh_connection_attach(RemminaSSH *ssh)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHConnection *conn;
+	gboolean idle;
+	gboolean usable;
+	gchar *key;
+
+	if (remmina_pref.ssh_session_pool_timeout <= 0 || ssh->connection_refused)
+		return FALSE;
+	if ((key = remmina_ssh_connection_key(ssh)) == NULL)
+		return FALSE;
+
+	/* Not cancellable while holding a reference */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+	g_mutex_lock(&ssh_connection_mutex);
+	conn = ssh_connections ? g_hash_table_lookup(ssh_connections, key) : NULL;
+	idle = conn && conn->refcount == 0;
+	if (conn)
+		g_atomic_int_inc(&conn->refcount);
+	g_mutex_unlock(&ssh_connection_mutex);
+	g_free(key);
+
+	if (conn) {
+		pthread_mutex_lock(&conn->mutex);
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 9, 0)
+		usable = ssh_session_is_known_server(conn->session) == SSH_KNOWN_HOSTS_OK;
+#else
+		usable = ssh_is_server_known(conn->session) == SSH_SERVER_KNOWN_OK;
+#endif
+		usable = usable && ssh_is_connected(conn->session) &&
+			 (!idle || remmina_ssh_connection_probe(conn->session));
+		pthread_mutex_unlock(&conn->mutex);
+
+		if (!usable) {
+			REMMINA_DEBUG("Shared SSH connection for %s is not usable, opening a new one", ssh->user);
+			g_mutex_lock(&ssh_connection_mutex);
+			remmina_ssh_connection_withdraw(conn);
+			remmina_ssh_connection_unref(conn);
+			g_mutex_unlock(&ssh_connection_mutex);
+			conn = NULL;
+		}
+	}
+
+	if (conn) {
+		REMMINA_DEBUG("Sharing an SSH connection for %s", ssh->user);
+		ssh_free(ssh->session);
+		g_free(ssh->callback);
+		ssh->callback = NULL;
+		ssh->session = conn->session;
+		ssh->connection = conn;
+		ssh->connection_unverified = TRUE;
+	}
+
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+	return conn != NULL;
+}
+
+/* ssh no longer uses its shared connection */
+static void
+remmina_ssh_connection_release(RemminaSSH *ssh)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHConnection *conn = ssh->connection;
+
+	if (!conn)
+		return;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	g_mutex_lock(&ssh_connection_mutex);
+	if (ssh->cancelled)
+		remmina_ssh_connection_withdraw(conn);
+	remmina_ssh_connection_unref(conn);
+	g_mutex_unlock(&ssh_connection_mutex);
+
+	ssh->connection = NULL;
+	ssh->connection_unverified = FALSE;
+	ssh->session = NULL;
+	ssh->authenticated = FALSE;
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+}
+
+/* Offer the connection ssh has just authenticated to the next sessions to
+ * the same account, with ssh as its first user */
+static void
+remmina_ssh_connection_publish(RemminaSSH *ssh)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHConnection *conn;
+	gchar *key;
+
+	if (remmina_pref.ssh_session_pool_timeout <= 0 || ssh->connection || ssh->cancelled ||
+	    !ssh->session || !ssh->callback)
+		return;
+	/* The options and the credentials as they are after the authentication,
+	 * prompts and server-driven method changes included */
+	if ((key = remmina_ssh_connection_key(ssh)) == NULL)
+		return;
+
+	conn = g_new0(RemminaSSHConnection, 1);
+	conn->session = ssh->session;
+	conn->callback = ssh->callback;
+	conn->key = key;
+	conn->secret = remmina_ssh_connection_secret(ssh);
+	conn->refcount = 1;
+	pthread_mutex_init(&conn->mutex, NULL);
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	g_mutex_lock(&ssh_connection_mutex);
+	if (!ssh_connections)
+		ssh_connections = g_hash_table_new(g_str_hash, g_str_equal);
+	/* One connection is offered per key, the others stay private */
+	if (!g_hash_table_contains(ssh_connections, key)) {
+		g_hash_table_insert(ssh_connections, conn->key, conn);
+		/* The connection may outlive ssh */
+		conn->callback->userdata = NULL;
+		ssh->callback = NULL;
+		ssh->connection = conn;
+	}
+	g_mutex_unlock(&ssh_connection_mutex);
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+
+	if (ssh->connection != conn) {
+		pthread_mutex_destroy(&conn->mutex);
+		g_free(conn->key);
+		g_free(conn->secret);
+		g_free(conn);
+	}
+}
+
+void
+remmina_ssh_set_cancelled(RemminaSSH *ssh)
+{
+	TRACE_CALL(__func__);
+	ssh->cancelled = TRUE;
+	if (ssh->connection) {
+		g_mutex_lock(&ssh_connection_mutex);
+		remmina_ssh_connection_withdraw(ssh->connection);
+		g_mutex_unlock(&ssh_connection_mutex);
+	}
+}
+
+enum remmina_ssh_auth_result
+remmina_ssh_auth(RemminaSSH *ssh, const gchar *password, RemminaProtocolWidget *gp, RemminaFile *remminafile)
+{
+	TRACE_CALL(__func__);
+	enum remmina_ssh_auth_result rv;
+	gchar *secret;
+
+	if (password) {
+		if (password != ssh->password) {
+			g_free(ssh->password);
+			ssh->password = NULL;
+		}
+		if (password != ssh->passphrase) g_free(ssh->passphrase);
+		ssh->password = g_strdup(password);
+		ssh->passphrase = g_strdup(password);
+	}
+
+	/* A shared connection is only used with the credentials it was
+	 * authenticated with, otherwise we open our own */
+	if (ssh->connection && ssh->connection_unverified) {
+		secret = remmina_ssh_connection_secret(ssh);
+		if (g_strcmp0(secret, ssh->connection->secret) == 0) {
+			ssh->connection_unverified = FALSE;
+			ssh->authenticated = TRUE;
+		} else {
+			REMMINA_DEBUG("Not the credentials of the shared SSH connection, opening a new one");
+			remmina_ssh_connection_release(ssh);
+			ssh->connection_refused = TRUE;
+		}
+		g_free(secret);
+		if (!ssh->connection && !remmina_ssh_init_session(ssh))
+			return REMMINA_SSH_AUTH_FATAL_ERROR;
+	}
+	if (ssh->connection)
+		return REMMINA_SSH_AUTH_SUCCESS;
+
+	rv = remmina_ssh_auth_session(ssh, gp, remminafile);
+	if (rv == REMMINA_SSH_AUTH_SUCCESS)
+		remmina_ssh_connection_publish(ssh);
+	return rv;
+}
+
 gboolean
 remmina_ssh_init_session(RemminaSSH *ssh)
 {
@@ -1332,6 +1757,11 @@ remmina_ssh_init_session(RemminaSSH *ssh)
 	else
 		REMMINA_DEBUG("SSH_OPTIONS_COMPRESSION does not have a valid value. %s", ssh->compression);
 
+	/* Every option is resolved now: a connection opened with the very same
+	 * ones can carry our channels instead of a new one */
+	if (remmina_ssh_connection_attach(ssh))
+		return TRUE;
+
 	if (ssh_connect(ssh->session)) {
 		// TRANSLATORS: The placeholder %s is an error message
 		remmina_ssh_set_error(ssh, _("Could not start SSH session. %s"));
@@ -1404,6 +1834,10 @@ remmina_ssh_init_from_file(RemminaSSH *ssh, RemminaFile *remminafile, gboolean i
 	ssh->authenticated = FALSE;
 	ssh->error = NULL;
 	ssh->passphrase = NULL;
+	ssh->connection = NULL;
+	ssh->connection_unverified = FALSE;
+	ssh->connection_refused = FALSE;
+	ssh->cancelled = FALSE;
 	ssh->is_tunnel = is_tunnel;
 	pthread_mutex_init(&ssh->ssh_mutex, NULL);
 
@@ -1491,8 +1925,13 @@ remmina_ssh_init_from_ssh(RemminaSSH *ssh, const RemminaSSH *ssh_src)
 {
 	TRACE_CALL(__func__);
 	ssh->session = NULL;
+	ssh->callback = NULL;
 	ssh->authenticated = FALSE;
 	ssh->error = NULL;
+	ssh->connection = NULL;
+	ssh->connection_unverified = FALSE;
+	ssh->connection_refused = FALSE;
+	ssh->cancelled = FALSE;
 	pthread_mutex_init(&ssh->ssh_mutex, NULL);
 
 	ssh->is_tunnel = ssh_src->is_tunnel;
@@ -1545,6 +1984,7 @@ void
 remmina_ssh_free(RemminaSSH *ssh)
 {
 	TRACE_CALL(__func__);
+	remmina_ssh_connection_release(ssh);
 	if (ssh->session) {
 		ssh_disconnect(ssh->session);
 		ssh_free(ssh->session);
@@ -1565,22 +2005,57 @@ remmina_ssh_free(RemminaSSH *ssh)
 /*-----------------------------------------------------------------------------*
 *                           SSH Tunnel                                        *
 *-----------------------------------------------------------------------------*/
+
+/* Size of the preallocated buffer holding SSH channel data not yet written
+ * to the local socket. When it is full, the channel is no longer read and
+ * the SSH window provides the backpressure towards the server */
+#define REMMINA_SSH_TUNNEL_BUFFER_SIZE 65536
+
+/* Size of the scratch buffer used to move local socket data to the channels */
+#define REMMINA_SSH_TUNNEL_READ_SIZE 32768
+
+#define REMMINA_SSH_TUNNEL_WATCH_IN  (1 << 0)
+#define REMMINA_SSH_TUNNEL_WATCH_OUT (1 << 1)
+#define REMMINA_SSH_TUNNEL_WATCH_ERR (1 << 2)
+
+/* Per channel state: the channel to socket ring buffer and the socket watch */
 struct _RemminaSSHTunnelBuffer {
 	gchar * data;
-	gchar * ptr;
-	ssize_t len;
+	gsize	size;
+	/* Free running read and write counters, the ring holds tail - head bytes */
+	gsize	head;
+	gsize	tail;
+	/* Events watched on the local socket and events reported by the last wait */
+	guint	events;
+	guint	revents;
+	/* The SSH channel reached EOF, close once the ring is empty */
+	gboolean eof;
 };
 
+/* Number of local ports scanned for an OPEN tunnel before letting the system
+ * choose a free one */
+#define REMMINA_SSH_TUNNEL_PORT_RANGE 100
+
+/* Seconds between two keepalives sent by a lingering OPEN tunnel */
+#define REMMINA_SSH_TUNNEL_PROBE_INTERVAL 10
+
+/* Local ports leased to OPEN tunnels of all the connections, port -> tunnel */
+static GHashTable *remmina_ssh_tunnel_port_leases = NULL;
+static pthread_mutex_t remmina_ssh_tunnel_port_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Tags identifying the SSH session and the listening socket in the poll set */
+static gchar remmina_ssh_tunnel_session_tag;
+static gchar remmina_ssh_tunnel_listen_tag;
+
 static RemminaSSHTunnelBuffer *
-remmina_ssh_tunnel_buffer_new(ssize_t len)
+remmina_ssh_tunnel_buffer_new(gsize size)
 {
 	TRACE_CALL(__func__);
 	RemminaSSHTunnelBuffer *buffer;
 
-	buffer = g_new(RemminaSSHTunnelBuffer, 1);
-	buffer->data = (gchar *)g_malloc(len);
-	buffer->ptr = buffer->data;
-	buffer->len = len;
+	buffer = g_new0(RemminaSSHTunnelBuffer, 1);
+	buffer->data = (gchar *)g_malloc(size);
+	buffer->size = size;
 	return buffer;
 }
 
@@ -1615,9 +2090,14 @@ remmina_ssh_tunnel_new_from_file(RemminaFile *remminafile)
 	tunnel->server_sock = -1;
 	tunnel->dest = NULL;
 	tunnel->port = 0;
+	tunnel->localport = 0;
+	tunnel->linger = 0;
+	tunnel->alive = TRUE;
 	tunnel->buffer = NULL;
 	tunnel->buffer_len = 0;
-	tunnel->channels_out = NULL;
+	tunnel->poll_fd = -1;
+	tunnel->poll_server_sock = -1;
+	tunnel->poll_session_events = 0;
 	tunnel->remotedisplay = 0;
 	tunnel->localdisplay = NULL;
 	tunnel->init_func = NULL;
@@ -1628,6 +2108,45 @@ remmina_ssh_tunnel_new_from_file(RemminaFile *remminafile)
 	return tunnel;
 }
 
+/* Add, update or remove (events == 0) a file descriptor in the poll set.
+ * Without epoll the set is rebuilt by remmina_ssh_tunnel_wait() */
+static void
+remmina_ssh_tunnel_watch_fd(RemminaSSHTunnel *tunnel, gint fd, guint old_events, guint events, gpointer tag)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event ev = { 0 };
+	gint op;
+
+	if (tunnel->poll_fd < 0 || fd < 0 || old_events == events)
+		return;
+
+	if (events & REMMINA_SSH_TUNNEL_WATCH_IN)
+		ev.events |= EPOLLIN;
+	if (events & REMMINA_SSH_TUNNEL_WATCH_OUT)
+		ev.events |= EPOLLOUT;
+	ev.data.ptr = tag;
+
+	if (old_events == 0)
+		op = EPOLL_CTL_ADD;
+	else if (events == 0)
+		op = EPOLL_CTL_DEL;
+	else
+		op = EPOLL_CTL_MOD;
+	if (epoll_ctl(tunnel->poll_fd, op, fd, &ev) < 0 && op != EPOLL_CTL_DEL)
+		REMMINA_DEBUG("epoll_ctl(%d) on fd %d failed: %s", op, fd, g_strerror(errno));
+#endif
+}
+
+/* Change the events watched on the local socket of channel n */
+static void
+remmina_ssh_tunnel_watch_channel(RemminaSSHTunnel *tunnel, gint n, guint events)
+{
+	RemminaSSHTunnelBuffer *buffer = tunnel->socketbuffers[n];
+
+	remmina_ssh_tunnel_watch_fd(tunnel, tunnel->sockets[n], buffer->events, events, buffer);
+	buffer->events = events;
+}
+
 static void
 remmina_ssh_tunnel_close_all_channels(RemminaSSHTunnel *tunnel)
 {
@@ -1651,12 +2170,20 @@ remmina_ssh_tunnel_close_all_channels(RemminaSSHTunnel *tunnel)
 
 	tunnel->num_channels = 0;
 	tunnel->max_channels = 0;
+
+	if (tunnel->poll_fd >= 0) {
+		close(tunnel->poll_fd);
+		tunnel->poll_fd = -1;
+	}
+	tunnel->poll_server_sock = -1;
+	tunnel->poll_session_events = 0;
 }
 
 static void
 remmina_ssh_tunnel_remove_channel(RemminaSSHTunnel *tunnel, gint n)
 {
 	TRACE_CALL(__func__);
+	remmina_ssh_tunnel_watch_channel(tunnel, n, 0);
 	ssh_channel_close(tunnel->channels[n]);
 	ssh_channel_send_eof(tunnel->channels[n]);
 	ssh_channel_free(tunnel->channels[n]);
@@ -1679,7 +2206,6 @@ remmina_ssh_tunnel_add_channel(RemminaSSHTunnel *tunnel, ssh_channel channel, gi
 
 	i = tunnel->num_channels++;
 	if (tunnel->num_channels > tunnel->max_channels) {
-		/* Allocate an extra NULL pointer in channels for ssh_select */
 		tunnel->channels = (ssh_channel *)g_realloc(tunnel->channels,
 							    sizeof(ssh_channel) * (tunnel->num_channels + 1));
 		tunnel->sockets = (gint *)g_realloc(tunnel->sockets,
@@ -1687,41 +2213,23 @@ remmina_ssh_tunnel_add_channel(RemminaSSHTunnel *tunnel, ssh_channel channel, gi
 		tunnel->socketbuffers = (RemminaSSHTunnelBuffer **)g_realloc(tunnel->socketbuffers,
 									     sizeof(RemminaSSHTunnelBuffer *) * tunnel->num_channels);
 		tunnel->max_channels = tunnel->num_channels;
-
-		tunnel->channels_out = (ssh_channel *)g_realloc(tunnel->channels_out,
-								sizeof(ssh_channel) * (tunnel->num_channels + 1));
 	}
 	tunnel->channels[i] = channel;
 	tunnel->channels[i + 1] = NULL;
 	tunnel->sockets[i] = sock;
-	tunnel->socketbuffers[i] = NULL;
+	tunnel->socketbuffers[i] = remmina_ssh_tunnel_buffer_new(REMMINA_SSH_TUNNEL_BUFFER_SIZE);
 
 	flags = fcntl(sock, F_GETFL, 0);
 	fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+	remmina_ssh_tunnel_watch_channel(tunnel, i, REMMINA_SSH_TUNNEL_WATCH_IN);
 }
 
+/* Accept a pending local connection, the listening socket is non blocking */
 static int
-remmina_ssh_tunnel_accept_local_connection(RemminaSSHTunnel *tunnel, gboolean blocking)
+remmina_ssh_tunnel_accept_local_connection(RemminaSSHTunnel *tunnel)
 {
-	gint sock, sock_flags;
-
-	sock_flags = fcntl(tunnel->server_sock, F_GETFL, 0);
-	if (blocking)
-		sock_flags &= ~O_NONBLOCK;
-	else
-		sock_flags |= O_NONBLOCK;
-	fcntl(tunnel->server_sock, F_SETFL, sock_flags);
-
-	/* Accept a local connection */
-	sock = accept(tunnel->server_sock, NULL, NULL);
-	if (sock < 0) {
-		if (blocking) {
-			g_free(REMMINA_SSH(tunnel)->error);
-			REMMINA_SSH(tunnel)->error = g_strdup("Local socket not accepted");
-		}
-	}
-
-	return sock;
+	return accept(tunnel->server_sock, NULL, NULL);
 }
 
 static ssh_channel
@@ -1750,72 +2258,326 @@ remmina_ssh_tunnel_create_forward_channel(RemminaSSHTunnel *tunnel)
 	return channel;
 }
 
-static gpointer
-remmina_ssh_tunnel_main_thread_proc(gpointer data)
+/* Connect a channel opened by the server (X11 or reverse forwarding) to the local endpoint */
+static void
+remmina_ssh_tunnel_add_forwarded_channel(RemminaSSHTunnel *tunnel, ssh_channel channel)
 {
 	TRACE_CALL(__func__);
-	RemminaSSHTunnel *tunnel = (RemminaSSHTunnel *)data;
-	gchar *ptr;
-	ssize_t len = 0, lenw = 0;
-	fd_set set;
-	struct timeval timeout;
-	g_autoptr(GDateTime) t1 = NULL;
-	g_autoptr(GDateTime) t2 = NULL;
-	GTimeSpan diff;                                                 // microseconds
-	ssh_channel channel = NULL;
-	gboolean first = TRUE;
-	gboolean disconnected;
-	gint sock;
-	gint maxfd;
-	gint i;
-	gint ret;
 	struct sockaddr_in sin;
+	gint sock;
 
-	t1 = t2 = g_date_time_new_now_local();
-
-	switch (tunnel->tunnel_type) {
-	case REMMINA_SSH_TUNNEL_OPEN:
-		sock = remmina_ssh_tunnel_accept_local_connection(tunnel, TRUE);
-		if (sock < 0) {
-			if (tunnel)
-				tunnel->thread = 0;
-			return NULL;
-		}
-
-		channel = remmina_ssh_tunnel_create_forward_channel(tunnel);
-		if (!tunnel) {
+	if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
+		sin.sin_family = AF_INET;
+		sin.sin_port = htons(tunnel->localport);
+		sin.sin_addr.s_addr = inet_addr("127.0.0.1");
+		sock = socket(AF_INET, SOCK_STREAM, 0);
+		if (connect(sock, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+			remmina_ssh_set_application_error(REMMINA_SSH(tunnel),
+							  _("Cannot connect to local port %i."), tunnel->localport);
 			close(sock);
-			tunnel->thread = 0;
-			return NULL;
+			sock = -1;
 		}
+	} else {
+		sock = remmina_public_open_xdisplay(tunnel->localdisplay);
+	}
 
+	if (sock >= 0) {
 		remmina_ssh_tunnel_add_channel(tunnel, channel, sock);
-		break;
+	} else {
+		/* Failed to create unix socket. Will this happen? */
+		ssh_channel_close(channel);
+		ssh_channel_send_eof(channel);
+		ssh_channel_free(channel);
+	}
+}
 
-	case REMMINA_SSH_TUNNEL_XPORT:
-		/* Detect the next available port starting from 6010 on the server */
-		for (i = 10; i <= MAX_X_DISPLAY_NUMBER; i++) {
-#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 7, 0)
-			if (ssh_channel_listen_forward(REMMINA_SSH(tunnel)->session, (tunnel->bindlocalhost ? "localhost" : NULL), 6000 + i, NULL)) {
-				continue;
-			} else {
-				tunnel->remotedisplay = i;
-				break;
-			}
+/* The SSH session socket stays readable as long as packets wait in the
+ * kernel, but channels are only read while their ring has room. Watch it
+ * only when at least one channel can take data, otherwise the level
+ * triggered wait returns at once for ever. */
+static void
+remmina_ssh_tunnel_watch_session(RemminaSSHTunnel *tunnel)
+{
+	RemminaSSHTunnelBuffer *buffer;
+	guint events;
+	gint i;
+
+	events = tunnel->num_channels > 0 ? 0 : REMMINA_SSH_TUNNEL_WATCH_IN;
+	for (i = 0; i < tunnel->num_channels && !events; i++) {
+		buffer = tunnel->socketbuffers[i];
+		if (!buffer->eof && buffer->tail - buffer->head < buffer->size)
+			events = REMMINA_SSH_TUNNEL_WATCH_IN;
+	}
+
+	remmina_ssh_tunnel_watch_fd(tunnel, ssh_get_fd(REMMINA_SSH(tunnel)->session),
+				    tunnel->poll_session_events, events, &remmina_ssh_tunnel_session_tag);
+	tunnel->poll_session_events = events;
+}
+
+/* Keep the listening socket of an OPEN tunnel in the poll set, it may be
+ * closed at any time by remmina_ssh_tunnel_cancel_accept() */
+static void
+remmina_ssh_tunnel_watch_server_sock(RemminaSSHTunnel *tunnel)
+{
+	gint sock = tunnel->server_sock;
+
+	if (sock == tunnel->poll_server_sock)
+		return;
+	if (tunnel->poll_server_sock >= 0)
+		remmina_ssh_tunnel_watch_fd(tunnel, tunnel->poll_server_sock, REMMINA_SSH_TUNNEL_WATCH_IN, 0, NULL);
+	if (sock >= 0) {
+		fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+		remmina_ssh_tunnel_watch_fd(tunnel, sock, 0, REMMINA_SSH_TUNNEL_WATCH_IN, &remmina_ssh_tunnel_listen_tag);
+	}
+	tunnel->poll_server_sock = sock;
+}
+
+/* Wait up to timeout ms (-1 for ever) for activity on the SSH session, the
+ * local sockets or the listening socket. Channel results are stored in
+ * socketbuffers[i]->revents */
+static gint
+remmina_ssh_tunnel_wait(RemminaSSHTunnel *tunnel, gint timeout, gboolean *session_ready, gboolean *server_ready)
+{
+	guint revents;
+	gint i, n, ret;
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event events[32];
 #else
-			if (ssh_forward_listen(REMMINA_SSH(tunnel)->session, (tunnel->bindlocalhost ? "localhost" : NULL), 6000 + i, NULL)) {
-				continue;
-			} else {
-				tunnel->remotedisplay = i;
-				break;
-			}
+	struct pollfd *fds;
+	gint nfds = 0;
 #endif
+
+	*session_ready = FALSE;
+	*server_ready = FALSE;
+	for (i = 0; i < tunnel->num_channels; i++)
+		tunnel->socketbuffers[i]->revents = 0;
+
+#ifdef HAVE_SYS_EPOLL_H
+	ret = epoll_wait(tunnel->poll_fd, events, G_N_ELEMENTS(events), timeout);
+	if (ret < 0)
+		return errno == EINTR ? 0 : -1;
+
+	for (n = 0; n < ret; n++) {
+		revents = 0;
+		if (events[n].events & (EPOLLIN | EPOLLHUP))
+			revents |= REMMINA_SSH_TUNNEL_WATCH_IN;
+		if (events[n].events & EPOLLOUT)
+			revents |= REMMINA_SSH_TUNNEL_WATCH_OUT;
+		if (events[n].events & EPOLLERR)
+			revents |= REMMINA_SSH_TUNNEL_WATCH_ERR;
+
+		if (events[n].data.ptr == &remmina_ssh_tunnel_session_tag) {
+			*session_ready = TRUE;
+		} else if (events[n].data.ptr == &remmina_ssh_tunnel_listen_tag) {
+			*server_ready = TRUE;
+		} else {
+			((RemminaSSHTunnelBuffer *)events[n].data.ptr)->revents = revents;
 		}
-		if (tunnel->remotedisplay < 1) {
-			// TRANSLATORS: The placeholder %s is an error message
-			remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not request port forwarding. %s"));
-			if (tunnel->disconnect_func)
-				(*tunnel->disconnect_func)(tunnel, tunnel->callback_data);
+	}
+#else
+	fds = g_new(struct pollfd, tunnel->num_channels + 2);
+	if (tunnel->poll_session_events) {
+		fds[nfds].fd = ssh_get_fd(REMMINA_SSH(tunnel)->session);
+		fds[nfds++].events = POLLIN;
+	}
+	if (tunnel->poll_server_sock >= 0) {
+		fds[nfds].fd = tunnel->poll_server_sock;
+		fds[nfds++].events = POLLIN;
+	}
+	for (i = 0; i < tunnel->num_channels; i++) {
+		fds[nfds].fd = tunnel->sockets[i];
+		fds[nfds].events = 0;
+		if (tunnel->socketbuffers[i]->events & REMMINA_SSH_TUNNEL_WATCH_IN)
+			fds[nfds].events |= POLLIN;
+		if (tunnel->socketbuffers[i]->events & REMMINA_SSH_TUNNEL_WATCH_OUT)
+			fds[nfds].events |= POLLOUT;
+		nfds++;
+	}
+
+	ret = poll(fds, nfds, timeout);
+	if (ret < 0) {
+		g_free(fds);
+		return errno == EINTR ? 0 : -1;
+	}
+
+	n = 0;
+	if (tunnel->poll_session_events)
+		*session_ready = fds[n++].revents != 0;
+	if (tunnel->poll_server_sock >= 0)
+		*server_ready = fds[n++].revents != 0;
+	for (i = 0; i < tunnel->num_channels; i++, n++) {
+		revents = 0;
+		if (fds[n].revents & (POLLIN | POLLHUP))
+			revents |= REMMINA_SSH_TUNNEL_WATCH_IN;
+		if (fds[n].revents & POLLOUT)
+			revents |= REMMINA_SSH_TUNNEL_WATCH_OUT;
+		if (fds[n].revents & (POLLERR | POLLNVAL))
+			revents |= REMMINA_SSH_TUNNEL_WATCH_ERR;
+		tunnel->socketbuffers[i]->revents = revents;
+	}
+	g_free(fds);
+#endif
+	return ret;
+}
+
+/* Move data from the local socket of channel n to the SSH channel, never
+ * more than the remote window so ssh_channel_write() does not block.
+ * Returns FALSE when the connection must be dropped */
+static gboolean
+remmina_ssh_tunnel_socket_to_channel(RemminaSSHTunnel *tunnel, gint n)
+{
+	RemminaSSHTunnelBuffer *buffer = tunnel->socketbuffers[n];
+	ssize_t len, lenw;
+	guint32 window;
+	gchar *ptr;
+
+	window = ssh_channel_window_size(tunnel->channels[n]);
+	if (window == 0) {
+		/* Stop reading the socket until the server opens the window again */
+		remmina_ssh_tunnel_watch_channel(tunnel, n, buffer->events & ~REMMINA_SSH_TUNNEL_WATCH_IN);
+		return TRUE;
+	}
+
+	len = read(tunnel->sockets[n], tunnel->buffer, MIN((guint32)tunnel->buffer_len, window));
+	if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return TRUE;
+	if (len <= 0) {
+		// TRANSLATORS: The placeholder %s is an error message
+		remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not read from tunnel listening socket. %s"));
+		return FALSE;
+	}
+
+	for (ptr = tunnel->buffer; len > 0; len -= lenw, ptr += lenw) {
+		lenw = ssh_channel_write(tunnel->channels[n], ptr, len);
+		if (lenw <= 0) {
+			// TRANSLATORS: The placeholder %s is an error message
+			remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not write to SSH channel. %s"));
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/* Write the ring of channel n to its local socket, then refill it from the
+ * data libssh has already received for the channel. *progress is set when
+ * new channel data was consumed. Returns FALSE when the connection must be dropped */
+static gboolean
+remmina_ssh_tunnel_channel_to_socket(RemminaSSHTunnel *tunnel, gint n, gboolean *progress)
+{
+	RemminaSSHTunnelBuffer *buffer = tunnel->socketbuffers[n];
+	ssize_t len;
+	gsize off, count;
+	guint events;
+
+	while (TRUE) {
+		/* Flush what is already buffered */
+		while (buffer->tail != buffer->head) {
+			off = buffer->head % buffer->size;
+			count = MIN(buffer->tail - buffer->head, buffer->size - off);
+			len = write(tunnel->sockets[n], buffer->data + off, count);
+			if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+				break;
+			if (len <= 0) {
+				// TRANSLATORS: The placeholder %s is an error message
+				remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not send data to tunnel listening socket. %s"));
+				return FALSE;
+			}
+			buffer->head += len;
+		}
+
+		if (buffer->eof || buffer->tail - buffer->head == buffer->size)
+			break;
+
+		/* Refill from the channel */
+		len = ssh_channel_poll(tunnel->channels[n], 0);
+		if (len == SSH_EOF) {
+			buffer->eof = TRUE;
+			break;
+		}
+		if (len == SSH_ERROR) {
+			// TRANSLATORS: The placeholder %s is an error message
+			remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not poll SSH channel. %s"));
+			return FALSE;
+		}
+		if (len == 0)
+			break;
+
+		off = buffer->tail % buffer->size;
+		count = MIN((gsize)len, MIN(buffer->size - (buffer->tail - buffer->head), buffer->size - off));
+		len = ssh_channel_read_nonblocking(tunnel->channels[n], buffer->data + off, count, 0);
+		if (len < 0) {
+			// TRANSLATORS: The placeholder %s is an error message
+			remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not read SSH channel in a non-blocking way. %s"));
+			return FALSE;
+		}
+		if (len == 0)
+			break;
+		buffer->tail += len;
+		*progress = TRUE;
+	}
+
+	if (buffer->eof && buffer->tail == buffer->head) {
+		remmina_ssh_set_application_error(REMMINA_SSH(tunnel), _("The SSH channel was closed by the server."));
+		return FALSE;
+	}
+
+	/* Wait for the socket to become writable only while data is pending, and
+	 * resume reading the socket once the remote window is open again */
+	events = buffer->events & ~REMMINA_SSH_TUNNEL_WATCH_OUT;
+	if (buffer->tail != buffer->head)
+		events |= REMMINA_SSH_TUNNEL_WATCH_OUT;
+	if (!(events & REMMINA_SSH_TUNNEL_WATCH_IN) && ssh_channel_window_size(tunnel->channels[n]) > 0)
+		events |= REMMINA_SSH_TUNNEL_WATCH_IN;
+	remmina_ssh_tunnel_watch_channel(tunnel, n, events);
+
+	return TRUE;
+}
+
+static gpointer
+remmina_ssh_tunnel_main_thread_proc(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHTunnel *tunnel = (RemminaSSHTunnel *)data;
+	ssh_channel channel = NULL;
+	gboolean session_ready, server_ready, progress;
+	gboolean connected = FALSE;
+	gint64 idle_since = 0;
+	gint64 probe_at = 0;
+	gint64 now;
+	gint sock = -1;
+	gint timeout;
+	gint i;
+	gint ret;
+
+	switch (tunnel->tunnel_type) {
+	case REMMINA_SSH_TUNNEL_OPEN:
+		/* Local connections are accepted by the event loop below */
+		break;
+
+	case REMMINA_SSH_TUNNEL_XPORT:
+		/* Detect the next available port starting from 6010 on the server */
+		for (i = 10; i <= MAX_X_DISPLAY_NUMBER; i++) {
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 7, 0)
+			if (ssh_channel_listen_forward(REMMINA_SSH(tunnel)->session, (tunnel->bindlocalhost ? "localhost" : NULL), 6000 + i, NULL)) {
+				continue;
+			} else {
+				tunnel->remotedisplay = i;
+				break;
+			}
+#else
+			if (ssh_forward_listen(REMMINA_SSH(tunnel)->session, (tunnel->bindlocalhost ? "localhost" : NULL), 6000 + i, NULL)) {
+				continue;
+			} else {
+				tunnel->remotedisplay = i;
+				break;
+			}
+#endif
+		}
+		if (tunnel->remotedisplay < 1) {
+			// TRANSLATORS: The placeholder %s is an error message
+			remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not request port forwarding. %s"));
+			if (tunnel->disconnect_func)
+				(*tunnel->disconnect_func)(tunnel, tunnel->callback_data);
 			tunnel->thread = 0;
 			return NULL;
 		}
@@ -1862,193 +2624,178 @@ remmina_ssh_tunnel_main_thread_proc(gpointer data)
 		break;
 	}
 
-	tunnel->buffer_len = 10240;
-	tunnel->buffer = g_malloc(tunnel->buffer_len);
-
-	/* Start the tunnel data transmission */
-	while (tunnel->running) {
-		if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_XPORT ||
-		    tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
-			if (first) {
-				first = FALSE;
-				channel = ssh_channel_accept_forward(REMMINA_SSH(tunnel)->session, 15000, &tunnel->port);
-				if (!channel) {
-					remmina_ssh_set_application_error(REMMINA_SSH(tunnel), _("The server did not respond."));
-					if (tunnel->disconnect_func)
-						(*tunnel->disconnect_func)(tunnel, tunnel->callback_data);
-					tunnel->thread = 0;
-					return NULL;
-				}
-				if (tunnel->connect_func)
-					(*tunnel->connect_func)(tunnel, tunnel->callback_data);
-				if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
-					/* For reverse tunnel, we only need one connection. */
+	if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_XPORT ||
+	    tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
+		channel = ssh_channel_accept_forward(REMMINA_SSH(tunnel)->session, 15000, &tunnel->port);
+		if (!channel) {
+			remmina_ssh_set_application_error(REMMINA_SSH(tunnel), _("The server did not respond."));
+			if (tunnel->disconnect_func)
+				(*tunnel->disconnect_func)(tunnel, tunnel->callback_data);
+			tunnel->thread = 0;
+			return NULL;
+		}
+		if (tunnel->connect_func)
+			(*tunnel->connect_func)(tunnel, tunnel->callback_data);
+		if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
+			/* For reverse tunnel, we only need one connection. */
 #if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 7, 0)
-					ssh_channel_cancel_forward(REMMINA_SSH(tunnel)->session, NULL, tunnel->port);
+			ssh_channel_cancel_forward(REMMINA_SSH(tunnel)->session, NULL, tunnel->port);
 #else
-					ssh_forward_cancel(REMMINA_SSH(tunnel)->session, NULL, tunnel->port);
+			ssh_forward_cancel(REMMINA_SSH(tunnel)->session, NULL, tunnel->port);
 #endif
-				}
-			} else if (tunnel->tunnel_type != REMMINA_SSH_TUNNEL_REVERSE) {
-				/* Poll once per some period of time if no incoming connections.
-				 * Don’t try to poll continuously as it will significantly slow down the loop */
-				t1 = g_date_time_new_now_local();
-				diff = g_date_time_difference(t1, t2) * 10000000
-				       + g_date_time_difference(t1, t2) / 100000;
-				if (diff > 1) {
-					REMMINA_DEBUG("Polling tunnel channels");
-						channel = ssh_channel_accept_forward(REMMINA_SSH(tunnel)->session, 0, &tunnel->port);
-					if (channel == NULL)
-						t2 = t1;
-				}
-				g_date_time_unref(t1);
-				g_date_time_unref(t2);
-			}
-
-			if (channel) {
-				if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_REVERSE) {
-					sin.sin_family = AF_INET;
-					sin.sin_port = htons(tunnel->localport);
-					sin.sin_addr.s_addr = inet_addr("127.0.0.1");
-					sock = socket(AF_INET, SOCK_STREAM, 0);
-					if (connect(sock, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
-						remmina_ssh_set_application_error(REMMINA_SSH(tunnel),
-										  _("Cannot connect to local port %i."), tunnel->localport);
-						close(sock);
-						sock = -1;
-					}
-				} else
-					sock = remmina_public_open_xdisplay(tunnel->localdisplay);
-				if (sock >= 0)
-					remmina_ssh_tunnel_add_channel(tunnel, channel, sock);
-				else {
-					/* Failed to create unix socket. Will this happen? */
-					ssh_channel_close(channel);
-					ssh_channel_send_eof(channel);
-					ssh_channel_free(channel);
-				}
-				channel = NULL;
-			}
 		}
+	}
 
-		if (tunnel->num_channels <= 0)
-			/* No more connections. We should quit */
-			break;
+	/* Everything below is driven by socket readiness: the SSH session socket,
+	 * the local sockets and, for OPEN tunnels, the listening socket */
+#ifdef HAVE_SYS_EPOLL_H
+	tunnel->poll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (tunnel->poll_fd < 0) {
+		remmina_ssh_set_application_error(REMMINA_SSH(tunnel), _("Could not create the tunnel event loop. %s"), g_strerror(errno));
+		if (channel) {
+			ssh_channel_close(channel);
+			ssh_channel_send_eof(channel);
+			ssh_channel_free(channel);
+		}
+		if (tunnel->disconnect_func)
+			(*tunnel->disconnect_func)(tunnel, tunnel->callback_data);
+		tunnel->thread = 0;
+		return NULL;
+	}
+#endif
+	remmina_ssh_tunnel_watch_session(tunnel);
 
-		timeout.tv_sec = 0;
-		timeout.tv_usec = 200000;
+	if (channel) {
+		remmina_ssh_tunnel_add_forwarded_channel(tunnel, channel);
+		channel = NULL;
+	}
 
-		FD_ZERO(&set);
-		maxfd = 0;
-		for (i = 0; i < tunnel->num_channels; i++) {
-			if (tunnel->sockets[i] > maxfd)
-				maxfd = tunnel->sockets[i];
-			FD_SET(tunnel->sockets[i], &set);
-		}
+	if (!tunnel->buffer) {
+		tunnel->buffer_len = REMMINA_SSH_TUNNEL_READ_SIZE;
+		tunnel->buffer = g_malloc(tunnel->buffer_len);
+	}
 
-		ret = ssh_select(tunnel->channels, tunnel->channels_out, maxfd + 1, &set, &timeout);
-		if (!tunnel->running) break;
-		if (ret == SSH_EINTR) continue;
-		if (ret == -1) break;
+	/* Data may already be waiting in libssh buffers */
+	session_ready = TRUE;
+	server_ready = FALSE;
 
+	/* Start the tunnel data transmission */
+	while (tunnel->running) {
+		/* Local sockets to SSH channels. Writing to a channel may make
+		 * libssh read incoming packets, so channels are checked afterwards */
 		i = 0;
 		while (tunnel->running && i < tunnel->num_channels) {
-			disconnected = FALSE;
-			if (FD_ISSET(tunnel->sockets[i], &set)) {
-				while (!disconnected &&
-				       (len = read(tunnel->sockets[i], tunnel->buffer, tunnel->buffer_len)) > 0) {
-					for (ptr = tunnel->buffer, lenw = 0; len > 0; len -= lenw, ptr += lenw) {
-						lenw = ssh_channel_write(tunnel->channels[i], (char *)ptr, len);
-						if (lenw <= 0) {
-							disconnected = TRUE;
-							// TRANSLATORS: The placeholder %s is an error message
-							remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not write to SSH channel. %s"));
-							break;
-						}
-					}
+			if (tunnel->socketbuffers[i]->revents & (REMMINA_SSH_TUNNEL_WATCH_IN | REMMINA_SSH_TUNNEL_WATCH_ERR)) {
+				session_ready = TRUE;
+				if (!remmina_ssh_tunnel_socket_to_channel(tunnel, i)) {
+					REMMINA_DEBUG("tunnel disconnected because %s", REMMINA_SSH(tunnel)->error);
+					remmina_ssh_tunnel_remove_channel(tunnel, i);
+					continue;
 				}
-				if (len == 0) {
-					// TRANSLATORS: The placeholder %s is an error message
-					remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not read from tunnel listening socket. %s"));
-					disconnected = TRUE;
-				}
-			}
-			if (disconnected) {
-				REMMINA_DEBUG("tunnel disconnected because %s", REMMINA_SSH(tunnel)->error);
-				remmina_ssh_tunnel_remove_channel(tunnel, i);
-				continue;
 			}
 			i++;
 		}
 		if (!tunnel->running) break;
 
-		i = 0;
-		while (tunnel->running && i < tunnel->num_channels) {
-			disconnected = FALSE;
-			if (!tunnel->socketbuffers[i]) {
-				len = ssh_channel_poll(tunnel->channels[i], 0);
-				if (len == SSH_ERROR || len == SSH_EOF) {
-					// TRANSLATORS: The placeholder %s is an error message
-					remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not poll SSH channel. %s"));
-					disconnected = TRUE;
-				} else if (len > 0) {
-					tunnel->socketbuffers[i] = remmina_ssh_tunnel_buffer_new(len);
-					len = ssh_channel_read_nonblocking(tunnel->channels[i], tunnel->socketbuffers[i]->data, len, 0);
-					if (len <= 0) {
-						// TRANSLATORS: The placeholder %s is an error message
-						remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not read SSH channel in a non-blocking way. %s"));
-						disconnected = TRUE;
-					} else {
-						tunnel->socketbuffers[i]->len = len;
-					}
-				}
-			}
-
-			if (!disconnected && tunnel->socketbuffers[i]) {
-				for (lenw = 0; tunnel->socketbuffers[i]->len > 0;
-				     tunnel->socketbuffers[i]->len -= lenw, tunnel->socketbuffers[i]->ptr += lenw) {
-					lenw = write(tunnel->sockets[i], tunnel->socketbuffers[i]->ptr, tunnel->socketbuffers[i]->len);
-					if (lenw == -1 && errno == EAGAIN && tunnel->running)
-						/* Sometimes we cannot write to a socket (always EAGAIN), probably because it’s internal
-						 * buffer is full. We need read the pending bytes from the socket first. so here we simply
-						 * break, leave the buffer there, and continue with other data */
-						break;
-					if (lenw <= 0) {
-						// TRANSLATORS: The placeholder %s is an error message
-						remmina_ssh_set_error(REMMINA_SSH(tunnel), _("Could not send data to tunnel listening socket. %s"));
-						disconnected = TRUE;
-						break;
-					}
-				}
-				if (tunnel->socketbuffers[i]->len <= 0) {
-					remmina_ssh_tunnel_buffer_free(tunnel->socketbuffers[i]);
-					tunnel->socketbuffers[i] = NULL;
+		/* SSH channels to local sockets. Reading a channel may pull packets
+		 * for other channels into libssh, so loop until nothing moves */
+		do {
+			progress = FALSE;
+			i = 0;
+			while (tunnel->running && i < tunnel->num_channels) {
+				if ((session_ready || tunnel->socketbuffers[i]->revents) &&
+				    !remmina_ssh_tunnel_channel_to_socket(tunnel, i, &progress)) {
+					REMMINA_DEBUG("Connection to SSH tunnel dropped. %s", REMMINA_SSH(tunnel)->error);
+					remmina_ssh_tunnel_remove_channel(tunnel, i);
+					continue;
 				}
+				i++;
 			}
+			session_ready = session_ready || progress;
+		} while (progress && tunnel->running);
+		if (!tunnel->running) break;
 
-			if (disconnected) {
-				REMMINA_DEBUG("Connection to SSH tunnel dropped. %s", REMMINA_SSH(tunnel)->error);
-				remmina_ssh_tunnel_remove_channel(tunnel, i);
-				continue;
-			}
-			i++;
+		/* New connections opened by the server (X11 forwarding) */
+		if (session_ready && tunnel->tunnel_type == REMMINA_SSH_TUNNEL_XPORT) {
+			while ((channel = ssh_channel_accept_forward(REMMINA_SSH(tunnel)->session, 0, &tunnel->port)) != NULL)
+				remmina_ssh_tunnel_add_forwarded_channel(tunnel, channel);
 		}
+
 		/**
 		 * Some protocols may open new connections during the session.
 		 * e.g: SPICE opens a new connection for some channels.
 		 */
-		sock = remmina_ssh_tunnel_accept_local_connection(tunnel, FALSE);
-		if (sock > 0) {
-			channel = remmina_ssh_tunnel_create_forward_channel(tunnel);
-			if (!channel) {
-				REMMINA_DEBUG("Could not open new SSH connection. %s", REMMINA_SSH(tunnel)->error);
-				close(sock);
-				/* Leave thread loop */
-				tunnel->running = FALSE;
-			} else {
+		if (server_ready && tunnel->server_sock >= 0) {
+			while ((sock = remmina_ssh_tunnel_accept_local_connection(tunnel)) >= 0) {
+				channel = remmina_ssh_tunnel_create_forward_channel(tunnel);
+				if (!channel) {
+					REMMINA_DEBUG("Could not open new SSH connection. %s", REMMINA_SSH(tunnel)->error);
+					close(sock);
+					/* Leave thread loop */
+					tunnel->running = FALSE;
+					break;
+				}
 				remmina_ssh_tunnel_add_channel(tunnel, channel, sock);
 			}
 		}
+
+		timeout = -1;
+		if (tunnel->num_channels > 0) {
+			connected = TRUE;
+			idle_since = 0;
+			g_atomic_int_set(&tunnel->alive, TRUE);
+		} else {
+			/* An OPEN tunnel keeps listening until its first connection, then
+			 * for tunnel->linger seconds after the last one is gone, so a
+			 * reconnecting plugin can use it again */
+			if (tunnel->tunnel_type != REMMINA_SSH_TUNNEL_OPEN || tunnel->server_sock < 0)
+				break;
+			/* Without channels nothing reads the session: process keepalives
+			 * and other requests of the server here */
+			if (session_ready) {
+				while ((channel = ssh_channel_accept_forward(REMMINA_SSH(tunnel)->session, 0, NULL)) != NULL)
+					ssh_channel_free(channel);
+				if (!ssh_is_connected(REMMINA_SSH(tunnel)->session)) {
+					remmina_ssh_set_error(REMMINA_SSH(tunnel), _("The SSH tunnel has been closed. %s"));
+					break;
+				}
+				g_atomic_int_set(&tunnel->alive, TRUE);
+			}
+			if (connected) {
+				now = g_get_monotonic_time();
+				if (idle_since == 0) {
+					idle_since = now;
+					probe_at = now;
+				}
+				timeout = tunnel->linger * 1000 - (gint)((now - idle_since) / 1000);
+				if (timeout <= 0) {
+					REMMINA_DEBUG("No connection through the tunnel for %d seconds, closing it", tunnel->linger);
+					break;
+				}
+#if LIBSSH_VERSION_INT >= SSH_VERSION_INT(0, 7, 0)
+				/* The plugin disconnected, maybe because the network went
+				 * down: the tunnel is not offered again until the server
+				 * answers a keepalive */
+				if (now >= probe_at) {
+					g_atomic_int_set(&tunnel->alive, FALSE);
+					ssh_send_keepalive(REMMINA_SSH(tunnel)->session);
+					probe_at = now + REMMINA_SSH_TUNNEL_PROBE_INTERVAL * G_USEC_PER_SEC;
+				}
+				timeout = MIN(timeout, (gint)((probe_at - now) / 1000) + 1);
+#endif
+			}
+		}
+
+		remmina_ssh_tunnel_watch_session(tunnel);
+		if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_OPEN)
+			remmina_ssh_tunnel_watch_server_sock(tunnel);
+
+		ret = remmina_ssh_tunnel_wait(tunnel, timeout, &session_ready, &server_ready);
+		if (!tunnel->running) break;
+		if (ret < 0) {
+			remmina_ssh_set_application_error(REMMINA_SSH(tunnel), _("Could not wait for tunnel events. %s"), g_strerror(errno));
+			break;
+		}
 	}
 
 	remmina_ssh_tunnel_close_all_channels(tunnel);
@@ -2095,10 +2842,73 @@ remmina_ssh_tunnel_main_thread(gpointer data)
 }
 
 
+/* Bind sock to the first free local port starting from first_port and lease
+ * it to the tunnel. Returns the bound port, or 0 on failure */
+static gint
+remmina_ssh_tunnel_bind_local_port(RemminaSSHTunnel *tunnel, gint sock, gint first_port)
+{
+	TRACE_CALL(__func__);
+	struct sockaddr_in sin;
+	socklen_t sinlen;
+	gint port, last_port;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+	pthread_mutex_lock(&remmina_ssh_tunnel_port_mutex);
+	if (!remmina_ssh_tunnel_port_leases)
+		remmina_ssh_tunnel_port_leases = g_hash_table_new(NULL, NULL);
+
+	last_port = first_port > 0 ? MIN(first_port + REMMINA_SSH_TUNNEL_PORT_RANGE - 1, 65535) : 0;
+	for (port = first_port; port > 0 && port <= last_port; port++) {
+		/* Skip the ports our own tunnels already hold */
+		if (g_hash_table_contains(remmina_ssh_tunnel_port_leases, GINT_TO_POINTER(port)))
+			continue;
+		sin.sin_port = htons(port);
+		if (bind(sock, (struct sockaddr *)&sin, sizeof(sin)) == 0)
+			break;
+	}
+
+	if (port <= 0 || port > last_port) {
+		/* Nothing free in the range, let the system pick an ephemeral port */
+		sin.sin_port = 0;
+		sinlen = sizeof(sin);
+		if (bind(sock, (struct sockaddr *)&sin, sizeof(sin)) ||
+		    getsockname(sock, (struct sockaddr *)&sin, &sinlen)) {
+			pthread_mutex_unlock(&remmina_ssh_tunnel_port_mutex);
+			return 0;
+		}
+		port = ntohs(sin.sin_port);
+	}
+
+	g_hash_table_insert(remmina_ssh_tunnel_port_leases, GINT_TO_POINTER(port), tunnel);
+	pthread_mutex_unlock(&remmina_ssh_tunnel_port_mutex);
+
+	REMMINA_DEBUG("SSH tunnel listening on local port %d", port);
+	return port;
+}
+
+static void
+remmina_ssh_tunnel_release_local_port(RemminaSSHTunnel *tunnel)
+{
+	TRACE_CALL(__func__);
+	gpointer port = GINT_TO_POINTER(tunnel->localport);
+
+	pthread_mutex_lock(&remmina_ssh_tunnel_port_mutex);
+	if (remmina_ssh_tunnel_port_leases &&
+	    g_hash_table_lookup(remmina_ssh_tunnel_port_leases, port) == tunnel)
+		g_hash_table_remove(remmina_ssh_tunnel_port_leases, port);
+	pthread_mutex_unlock(&remmina_ssh_tunnel_port_mutex);
+}
+
 void
 remmina_ssh_tunnel_cancel_accept(RemminaSSHTunnel *tunnel)
 {
 	TRACE_CALL(__func__);
+	/* A lingering tunnel keeps its listener for new connections and reconnects */
+	if (tunnel->linger > 0)
+		return;
 	if (tunnel->server_sock >= 0) {
 		close(tunnel->server_sock);
 		tunnel->server_sock = -1;
@@ -2111,7 +2921,6 @@ remmina_ssh_tunnel_open(RemminaSSHTunnel *tunnel, const gchar *host, gint port,
 	TRACE_CALL(__func__);
 	gint sock;
 	gint sockopt = 1;
-	struct sockaddr_in sin;
 
 	tunnel->tunnel_type = REMMINA_SSH_TUNNEL_OPEN;
 	tunnel->dest = g_strdup(host);
@@ -2129,18 +2938,18 @@ remmina_ssh_tunnel_open(RemminaSSHTunnel *tunnel, const gchar *host, gint port,
 	}
 	setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &sockopt, sizeof(sockopt));
 
-	sin.sin_family = AF_INET;
-	sin.sin_port = htons(local_port);
-	sin.sin_addr.s_addr = inet_addr("127.0.0.1");
-
-	if (bind(sock, (struct sockaddr *)&sin, sizeof(sin))) {
+	tunnel->localport = remmina_ssh_tunnel_bind_local_port(tunnel, sock, local_port);
+	if (tunnel->localport == 0) {
 		REMMINA_SSH(tunnel)->error = g_strdup(_("Could not bind server socket to local port."));
 		close(sock);
 		return FALSE;
 	}
 
-	if (listen(sock, 1)) {
+	/* Protocols like SPICE open several connections at once */
+	if (listen(sock, SOMAXCONN)) {
 		REMMINA_SSH(tunnel)->error = g_strdup(_("Could not listen to local port."));
+		remmina_ssh_tunnel_release_local_port(tunnel);
+		tunnel->localport = 0;
 		close(sock);
 		return FALSE;
 	}
@@ -2157,6 +2966,16 @@ remmina_ssh_tunnel_open(RemminaSSHTunnel *tunnel, const gchar *host, gint port,
 	return TRUE;
 }
 
+gboolean
+remmina_ssh_tunnel_listening(RemminaSSHTunnel *tunnel, const gchar *host, gint port)
+{
+	TRACE_CALL(__func__);
+	return tunnel->tunnel_type == REMMINA_SSH_TUNNEL_OPEN &&
+	       tunnel->thread != 0 && tunnel->running && tunnel->server_sock >= 0 &&
+	       g_atomic_int_get(&tunnel->alive) &&
+	       tunnel->port == port && g_strcmp0(tunnel->dest, host) == 0;
+}
+
 gboolean
 remmina_ssh_tunnel_xport(RemminaSSHTunnel *tunnel, gboolean bindlocalhost)
 {
@@ -2226,11 +3045,12 @@ remmina_ssh_tunnel_free(RemminaSSHTunnel *tunnel)
 		close(tunnel->server_sock);
 		tunnel->server_sock = -1;
 	}
+	if (tunnel->tunnel_type == REMMINA_SSH_TUNNEL_OPEN && tunnel->localport > 0)
+		remmina_ssh_tunnel_release_local_port(tunnel);
 
 	remmina_ssh_tunnel_close_all_channels(tunnel);
 
 	g_free(tunnel->buffer);
-	g_free(tunnel->channels_out);
 	g_free(tunnel->dest);
 	g_free(tunnel->localdisplay);
 
@@ -2251,6 +3071,7 @@ remmina_sftp_new_from_file(RemminaFile *remminafile)
 	remmina_ssh_init_from_file(REMMINA_SSH(sftp), remminafile, FALSE);
 
 	sftp->sftp_sess = NULL;
+	sftp->parent = NULL;
 
 	return sftp;
 }
@@ -2266,26 +3087,56 @@ remmina_sftp_new_from_ssh(RemminaSSH *ssh)
 	remmina_ssh_init_from_ssh(REMMINA_SSH(sftp), ssh);
 
 	sftp->sftp_sess = NULL;
+	sftp->parent = NULL;
 
 	return sftp;
 }
 
+RemminaSFTP *
+remmina_sftp_new_channel(RemminaSFTP *parent)
+{
+	TRACE_CALL(__func__);
+	RemminaSFTP *sftp;
+
+	sftp = remmina_sftp_new_from_ssh(REMMINA_SSH(parent));
+	sftp->parent = parent;
+	/* Borrowed, remmina_sftp_free() leaves it to the parent */
+	sftp->ssh.session = parent->ssh.session;
+	sftp->ssh.authenticated = TRUE;
+
+	return sftp;
+}
+
+void
+remmina_sftp_lock(RemminaSFTP *sftp)
+{
+	remmina_ssh_lock(REMMINA_SSH(sftp->parent ? sftp->parent : sftp));
+}
+
+void
+remmina_sftp_unlock(RemminaSFTP *sftp)
+{
+	remmina_ssh_unlock(REMMINA_SSH(sftp->parent ? sftp->parent : sftp));
+}
+
 gboolean
 remmina_sftp_open(RemminaSFTP *sftp)
 {
 	TRACE_CALL(__func__);
+	gboolean ret = FALSE;
+
+	remmina_sftp_lock(sftp);
 	sftp->sftp_sess = sftp_new(sftp->ssh.session);
-	if (!sftp->sftp_sess) {
+	if (!sftp->sftp_sess)
 		// TRANSLATORS: The placeholder %s is an error message
 		remmina_ssh_set_error(REMMINA_SSH(sftp), _("Could not create SFTP session. %s"));
-		return FALSE;
-	}
-	if (sftp_init(sftp->sftp_sess)) {
+	else if (sftp_init(sftp->sftp_sess))
 		// TRANSLATORS: The placeholder %s is an error message
 		remmina_ssh_set_error(REMMINA_SSH(sftp), _("Could not start SFTP session. %s"));
-		return FALSE;
-	}
-	return TRUE;
+	else
+		ret = TRUE;
+	remmina_sftp_unlock(sftp);
+	return ret;
 }
 
 void
@@ -2293,9 +3144,13 @@ remmina_sftp_free(RemminaSFTP *sftp)
 {
 	TRACE_CALL(__func__);
 	if (sftp->sftp_sess) {
+		remmina_sftp_lock(sftp);
 		sftp_free(sftp->sftp_sess);
+		remmina_sftp_unlock(sftp);
 		sftp->sftp_sess = NULL;
 	}
+	if (sftp->parent)
+		sftp->ssh.session = NULL;
 	remmina_ssh_free(REMMINA_SSH(sftp));
 }
 
@@ -2314,6 +3169,8 @@ remmina_ssh_shell_new_from_file(RemminaFile *remminafile)
 
 	shell->master = -1;
 	shell->slave = -1;
+	shell->input_pipe[0] = -1;
+	shell->input_pipe[1] = -1;
 	shell->exec = g_strdup(remmina_file_get_string(remminafile, "exec"));
 
 	return shell;
@@ -2331,6 +3188,8 @@ remmina_ssh_shell_new_from_ssh(RemminaSSH *ssh)
 
 	shell->master = -1;
 	shell->slave = -1;
+	shell->input_pipe[0] = -1;
+	shell->input_pipe[1] = -1;
 
 	return shell;
 }
@@ -2346,6 +3205,310 @@ remmina_ssh_call_exit_callback_on_main_thread(gpointer data)
 	return FALSE;
 }
 
+static gboolean
+remmina_ssh_call_eof_func_on_main_thread(gpointer data)
+{
+	TRACE_CALL(__func__);
+
+	RemminaSSHShell *shell = (RemminaSSHShell *)data;
+	shell->eof_idle = 0;
+	shell->eof_func(shell->user_data);
+	return FALSE;
+}
+
+/* Output of a shell without PTY waiting for the main thread. Over this
+ * size the shell thread stops reading the channel until the terminal
+ * catches up, and the SSH window slows down the server */
+#define REMMINA_SSH_SHELL_OUTPUT_MAX (4 * 1024 * 1024)
+
+static gboolean
+remmina_ssh_shell_output_idle(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHShell *shell = (RemminaSSHShell *)data;
+	GByteArray *output;
+
+	g_mutex_lock(&shell->output_mutex);
+	output = shell->output;
+	shell->output = g_byte_array_new();
+	shell->output_idle = 0;
+	g_cond_signal(&shell->output_cond);
+	g_mutex_unlock(&shell->output_mutex);
+
+	/* Everything the channel gave since the last run, in one go */
+	if (output->len > 0)
+		shell->output_func((const gchar *)output->data, output->len, shell->user_data);
+	g_byte_array_unref(output);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Called by the shell thread: queue output for the main thread */
+static void
+remmina_ssh_shell_output(RemminaSSHShell *shell, const gchar *data, gsize len)
+{
+	gint64 deadline;
+
+	g_mutex_lock(&shell->output_mutex);
+	while (!shell->closed && shell->output->len > REMMINA_SSH_SHELL_OUTPUT_MAX) {
+		/* Wake up now and then: remmina_ssh_shell_free() may be waiting for us */
+		deadline = g_get_monotonic_time() + 100 * G_TIME_SPAN_MILLISECOND;
+		g_cond_wait_until(&shell->output_cond, &shell->output_mutex, deadline);
+	}
+	g_byte_array_append(shell->output, (const guint8 *)data, len);
+	if (!shell->output_idle)
+		shell->output_idle = IDLE_ADD(remmina_ssh_shell_output_idle, shell);
+	g_mutex_unlock(&shell->output_mutex);
+}
+
+/* The session log is written by its own thread from a ring buffer, so the
+ * shell output never waits for the disk. When the ring is full the output
+ * is dropped from the log, and a note records how much was lost */
+#define REMMINA_SSH_SESSION_LOG_BUFFER_SIZE (1024 * 1024)
+
+/* The writer thread wakes up when this much output is pending, or after
+ * REMMINA_SSH_SESSION_LOG_FLUSH_INTERVAL seconds */
+#define REMMINA_SSH_SESSION_LOG_FLUSH_SIZE (64 * 1024)
+#define REMMINA_SSH_SESSION_LOG_FLUSH_INTERVAL 1
+
+typedef struct _RemminaSSHSessionLog {
+	/* Path without the ".gz" suffix of compressed logs */
+	gchar *		basename;
+	gchar *		filename;
+	gboolean	compress;
+	GOutputStream * stream;
+	/* Bytes of output in the current file, before compression */
+	guint64		written;
+	guint64		max_size;
+	gint		rotate;
+
+	GMutex		mutex;
+	GCond		cond;
+	GThread *	thread;
+	gchar *		buffer;
+	/* Free running read and write counters, the ring holds tail - head bytes */
+	gsize		head;
+	gsize		tail;
+	gsize		dropped;
+	gboolean	closing;
+} RemminaSSHSessionLog;
+
+static gboolean
+remmina_ssh_session_log_open_stream(RemminaSSHSessionLog *log)
+{
+	TRACE_CALL(__func__);
+	GFile *file;
+	GFileOutputStream *fstream;
+	GZlibCompressor *compressor;
+	GError *error = NULL;
+
+	file = g_file_new_for_path(log->filename);
+	fstream = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error);
+	g_object_unref(file);
+	if (!fstream) {
+		REMMINA_DEBUG("Could not open the session log %s: %s", log->filename, error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	if (log->compress) {
+		compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+		log->stream = g_converter_output_stream_new(G_OUTPUT_STREAM(fstream), G_CONVERTER(compressor));
+		g_object_unref(compressor);
+		g_object_unref(fstream);
+	} else {
+		log->stream = G_OUTPUT_STREAM(fstream);
+	}
+	log->written = 0;
+	return TRUE;
+}
+
+static void
+remmina_ssh_session_log_close_stream(RemminaSSHSessionLog *log)
+{
+	TRACE_CALL(__func__);
+	if (!log->stream)
+		return;
+	/* Closing the compressor writes the gzip trailer */
+	g_output_stream_close(log->stream, NULL, NULL);
+	g_object_unref(log->stream);
+	log->stream = NULL;
+}
+
+static gchar *
+remmina_ssh_session_log_rotated_name(RemminaSSHSessionLog *log, gint n)
+{
+	return g_strdup_printf("%s.%d%s", log->basename, n, log->compress ? ".gz" : "");
+}
+
+/* name.log -> name.log.1 -> ... -> name.log.<rotate>, then start a new file */
+static void
+remmina_ssh_session_log_rotate(RemminaSSHSessionLog *log)
+{
+	TRACE_CALL(__func__);
+	gchar *from, *to;
+	gint i;
+
+	remmina_ssh_session_log_close_stream(log);
+
+	for (i = log->rotate - 1; i > 0; i--) {
+		from = remmina_ssh_session_log_rotated_name(log, i);
+		to = remmina_ssh_session_log_rotated_name(log, i + 1);
+		g_rename(from, to);
+		g_free(from);
+		g_free(to);
+	}
+	if (log->rotate > 0) {
+		to = remmina_ssh_session_log_rotated_name(log, 1);
+		g_rename(log->filename, to);
+		g_free(to);
+	}
+
+	remmina_ssh_session_log_open_stream(log);
+}
+
+static void
+remmina_ssh_session_log_write(RemminaSSHSessionLog *log, const gchar *data, gsize len)
+{
+	TRACE_CALL(__func__);
+	GError *error = NULL;
+
+	if (!log->stream)
+		return;
+	if (!g_output_stream_write_all(log->stream, data, len, NULL, NULL, &error)) {
+		REMMINA_DEBUG("Could not write the session log %s: %s", log->filename, error->message);
+		g_error_free(error);
+		/* Give up, the shell keeps running without log */
+		remmina_ssh_session_log_close_stream(log);
+		return;
+	}
+	log->written += len;
+	if (log->max_size > 0 && log->written >= log->max_size)
+		remmina_ssh_session_log_rotate(log);
+}
+
+static gpointer
+remmina_ssh_session_log_thread(gpointer data)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHSessionLog *log = (RemminaSSHSessionLog *)data;
+	gint64 deadline;
+	gsize head, tail, dropped, offset, len;
+	gboolean closing;
+	gchar *note;
+
+	g_mutex_lock(&log->mutex);
+	while (TRUE) {
+		deadline = g_get_monotonic_time() + REMMINA_SSH_SESSION_LOG_FLUSH_INTERVAL * G_TIME_SPAN_SECOND;
+		while (!log->closing && log->tail - log->head < REMMINA_SSH_SESSION_LOG_FLUSH_SIZE)
+			if (!g_cond_wait_until(&log->cond, &log->mutex, deadline))
+				break;
+		head = log->head;
+		tail = log->tail;
+		dropped = log->dropped;
+		log->dropped = 0;
+		closing = log->closing;
+		g_mutex_unlock(&log->mutex);
+
+		/* The shell thread only appends after tail, [head, tail) is ours */
+		while (head < tail) {
+			offset = head % REMMINA_SSH_SESSION_LOG_BUFFER_SIZE;
+			len = MIN(tail - head, REMMINA_SSH_SESSION_LOG_BUFFER_SIZE - offset);
+			remmina_ssh_session_log_write(log, log->buffer + offset, len);
+			head += len;
+		}
+		if (dropped > 0) {
+			note = g_strdup_printf("\n[%" G_GSIZE_FORMAT " bytes of output not logged]\n", dropped);
+			remmina_ssh_session_log_write(log, note, strlen(note));
+			g_free(note);
+		}
+		if (log->stream && (tail != log->head || dropped > 0))
+			g_output_stream_flush(log->stream, NULL, NULL);
+
+		g_mutex_lock(&log->mutex);
+		log->head = tail;
+		if (closing)
+			break;
+	}
+	g_mutex_unlock(&log->mutex);
+
+	return NULL;
+}
+
+static RemminaSSHSessionLog *
+remmina_ssh_session_log_new(const gchar *filename, gboolean compress)
+{
+	TRACE_CALL(__func__);
+	RemminaSSHSessionLog *log;
+
+	log = g_new0(RemminaSSHSessionLog, 1);
+	log->basename = g_strdup(filename);
+	log->compress = compress;
+	log->filename = compress ? g_strconcat(filename, ".gz", NULL) : g_strdup(filename);
+	log->max_size = (guint64)MAX(remmina_pref.ssh_session_log_max_size, 0) * 1024 * 1024;
+	log->rotate = remmina_pref.ssh_session_log_rotate;
+
+	if (!remmina_ssh_session_log_open_stream(log)) {
+		g_free(log->filename);
+		g_free(log->basename);
+		g_free(log);
+		return NULL;
+	}
+
+	log->buffer = g_malloc(REMMINA_SSH_SESSION_LOG_BUFFER_SIZE);
+	g_mutex_init(&log->mutex);
+	g_cond_init(&log->cond);
+	log->thread = g_thread_new("remmina-ssh-log", remmina_ssh_session_log_thread, log);
+
+	return log;
+}
+
+/* Called by the shell thread only: copy the output to the ring, never wait */
+static void
+remmina_ssh_session_log_append(RemminaSSHSessionLog *log, const gchar *data, gsize len)
+{
+	gsize used, offset, chunk;
+
+	g_mutex_lock(&log->mutex);
+	used = log->tail - log->head;
+	if (len > REMMINA_SSH_SESSION_LOG_BUFFER_SIZE - used) {
+		log->dropped += len;
+		g_mutex_unlock(&log->mutex);
+		return;
+	}
+	while (len > 0) {
+		offset = log->tail % REMMINA_SSH_SESSION_LOG_BUFFER_SIZE;
+		chunk = MIN(len, REMMINA_SSH_SESSION_LOG_BUFFER_SIZE - offset);
+		memcpy(log->buffer + offset, data, chunk);
+		log->tail += chunk;
+		data += chunk;
+		len -= chunk;
+	}
+	if (used < REMMINA_SSH_SESSION_LOG_FLUSH_SIZE && log->tail - log->head >= REMMINA_SSH_SESSION_LOG_FLUSH_SIZE)
+		g_cond_signal(&log->cond);
+	g_mutex_unlock(&log->mutex);
+}
+
+/* Write what is left in the ring and close the log */
+static void
+remmina_ssh_session_log_free(RemminaSSHSessionLog *log)
+{
+	TRACE_CALL(__func__);
+	g_mutex_lock(&log->mutex);
+	log->closing = TRUE;
+	g_cond_signal(&log->cond);
+	g_mutex_unlock(&log->mutex);
+	g_thread_join(log->thread);
+
+	remmina_ssh_session_log_close_stream(log);
+	g_mutex_clear(&log->mutex);
+	g_cond_clear(&log->cond);
+	g_free(log->buffer);
+	g_free(log->filename);
+	g_free(log->basename);
+	g_free(log);
+}
+
 static gpointer
 remmina_ssh_shell_thread(gpointer data)
 {
@@ -2357,15 +3520,18 @@ remmina_ssh_shell_thread(gpointer data)
 	fd_set fds;
 	struct timeval timeout;
 	ssh_channel channel = NULL;
-	ssh_channel ch[2], chout[2];
 	gchar *buf = NULL;
 	gint buf_len;
 	gint len;
 	gint i, ret;
-	const gchar *filename;
+	gchar *p;
+	gchar *filename;
 	const gchar *dir;
 	const gchar *sshlogname;
-	FILE *fp;
+	RemminaSSHSessionLog *sessionlog = NULL;
+	GByteArray *input;
+	gint input_fd;
+	gint session_fd;
 
 	//gint screen;
 
@@ -2399,50 +3565,76 @@ remmina_ssh_shell_thread(gpointer data)
 	}
 
 	shell->channel = channel;
+	session_fd = ssh_get_fd(REMMINA_SSH(shell)->session);
 
 	UNLOCK_SSH(shell)
 
 	buf_len = 1000;
 	buf = g_malloc(buf_len + 1);
 
-	ch[0] = channel;
-	ch[1] = NULL;
-
-	GFile *rf = g_file_new_for_path(remminafile->filename);
+	if (remmina_file_get_int (remminafile, "sshsavesession", FALSE)) {
+		GFile *rf = g_file_new_for_path(remminafile->filename);
 
-	if (remmina_file_get_string(remminafile, "sshlogfolder") == NULL)
-		dir = g_build_path("/", g_get_user_cache_dir(), "remmina", NULL);
-	else
-		dir = remmina_file_get_string(remminafile, "sshlogfolder");
+		if (remmina_file_get_string(remminafile, "sshlogfolder") == NULL)
+			dir = g_build_path("/", g_get_user_cache_dir(), "remmina", NULL);
+		else
+			dir = remmina_file_get_string(remminafile, "sshlogfolder");
 
-	if (remmina_file_get_string(remminafile, "sshlogname") == NULL)
-		sshlogname = g_strconcat(g_file_get_basename(rf), ".", "log", NULL);
-	else
-		sshlogname = remmina_file_get_string(remminafile, "sshlogname");
-	sshlogname = remmina_file_format_properties(remminafile, sshlogname);
-	filename = g_strconcat(dir, "/", sshlogname, NULL);
+		if (remmina_file_get_string(remminafile, "sshlogname") == NULL)
+			sshlogname = g_strconcat(g_file_get_basename(rf), ".", "log", NULL);
+		else
+			sshlogname = remmina_file_get_string(remminafile, "sshlogname");
+		sshlogname = remmina_file_format_properties(remminafile, sshlogname);
+		filename = g_strconcat(dir, "/", sshlogname, NULL);
+		g_object_unref(rf);
 
-	if (remmina_file_get_int (remminafile, "sshsavesession", FALSE)) {
 		REMMINA_DEBUG("Saving session log to %s", filename);
-		fp = fopen(filename, "w");
+		sessionlog = remmina_ssh_session_log_new(filename, remmina_file_get_int(remminafile, "sshlogcompress", FALSE));
+		g_free(filename);
 	}
+	/* Without PTY the input is queued by remmina_ssh_shell_write(), which
+	 * wakes us up through input_pipe */
+	input_fd = shell->slave >= 0 ? shell->slave : shell->input_pipe[0];
 	while (!shell->closed) {
+		/* The session may be shared, libssh is only called with the lock
+		 * held: wait on the sockets, the channel is polled below. While
+		 * others use the connection, they may have read our data off the
+		 * socket, so do not sleep long */
 		timeout.tv_sec = 1;
 		timeout.tv_usec = 0;
+		if (remmina_ssh_connection_busy(REMMINA_SSH(shell))) {
+			timeout.tv_sec = 0;
+			timeout.tv_usec = REMMINA_SSH_CONNECTION_POLL_INTERVAL * 1000;
+		}
 
 		FD_ZERO(&fds);
-		FD_SET(shell->slave, &fds);
+		if (input_fd >= 0)
+			FD_SET(input_fd, &fds);
+		FD_SET(session_fd, &fds);
 
-		ret = ssh_select(ch, chout, shell->slave + 1, &fds, &timeout);
-		if (ret == SSH_EINTR) continue;
-		if (ret == -1) break;
+		ret = select(MAX(input_fd, session_fd) + 1, &fds, NULL, NULL, &timeout);
+		if (ret < 0 && errno == EINTR) continue;
+		if (ret < 0) break;
 
-		if (FD_ISSET(shell->slave, &fds)) {
+		if (shell->slave >= 0 && FD_ISSET(shell->slave, &fds)) {
 			len = read(shell->slave, buf, buf_len);
 			if (len <= 0) break;
 			LOCK_SSH(shell)
 			ssh_channel_write(channel, buf, len);
 			UNLOCK_SSH(shell)
+		} else if (shell->input && FD_ISSET(input_fd, &fds)) {
+			while (read(input_fd, buf, buf_len) > 0) {
+			}
+			g_mutex_lock(&shell->output_mutex);
+			input = shell->input;
+			shell->input = g_byte_array_new();
+			g_mutex_unlock(&shell->output_mutex);
+			if (input->len > 0) {
+				LOCK_SSH(shell)
+				ssh_channel_write(channel, input->data, input->len);
+				UNLOCK_SSH(shell)
+			}
+			g_byte_array_unref(input);
 		}
 
 		for (i = 0; i < 2; i++) {
@@ -2465,21 +3657,29 @@ remmina_ssh_shell_thread(gpointer data)
 				shell->closed = TRUE;
 				break;
 			}
+			if (sessionlog)
+				remmina_ssh_session_log_append(sessionlog, buf, len);
+			if (shell->output_func) {
+				remmina_ssh_shell_output(shell, buf, len);
+				continue;
+			}
+			p = buf;
 			while (len > 0) {
-				ret = write(shell->slave, buf, len);
-				if (remmina_file_get_int (remminafile, "sshsavesession", FALSE)) {
-					fwrite(buf, ret, 1, fp );
-					fflush(fp);
-				}
+				ret = write(shell->slave, p, len);
 				if (ret <= 0) break;
+				p += ret;
 				len -= ret;
 			}
 		}
 	}
 
+	if (sessionlog)
+		remmina_ssh_session_log_free(sessionlog);
+
 	LOCK_SSH(shell)
-	if (remmina_file_get_int (remminafile, "sshsavesession", FALSE))
-	fclose(fp);
+	/* Queued after the last output, so the terminal has it all when eof_func runs */
+	if (shell->output_func && shell->eof_func && ssh_channel_is_eof(channel))
+		shell->eof_idle = IDLE_ADD(remmina_ssh_call_eof_func_on_main_thread, shell);
 	shell->channel = NULL;
 	ssh_channel_close(channel);
 	ssh_channel_send_eof(channel);
@@ -2502,6 +3702,27 @@ remmina_ssh_shell_open(RemminaSSHShell *shell, RemminaSSHExitFunc exit_callback,
 	gchar *slavedevice;
 	struct termios stermios;
 
+	shell->exit_callback = exit_callback;
+	shell->user_data = data;
+
+	if (shell->output_func) {
+		if (pipe(shell->input_pipe)) {
+			REMMINA_SSH(shell)->error = g_strdup_printf(_("Could not create the terminal input pipe. %s"), g_strerror(errno));
+			shell->input_pipe[0] = -1;
+			shell->input_pipe[1] = -1;
+			return FALSE;
+		}
+		/* Neither the main thread nor the shell thread may block on it */
+		fcntl(shell->input_pipe[0], F_SETFL, fcntl(shell->input_pipe[0], F_GETFL, 0) | O_NONBLOCK);
+		fcntl(shell->input_pipe[1], F_SETFL, fcntl(shell->input_pipe[1], F_GETFL, 0) | O_NONBLOCK);
+		g_mutex_init(&shell->output_mutex);
+		g_cond_init(&shell->output_cond);
+		shell->output = g_byte_array_new();
+		shell->input = g_byte_array_new();
+		pthread_create(&shell->thread, NULL, remmina_ssh_shell_thread, shell);
+		return TRUE;
+	}
+
 	shell->master = posix_openpt(O_RDWR | O_NOCTTY);
 	if (shell->master == -1 ||
 	    grantpt(shell->master) == -1 ||
@@ -2521,9 +3742,6 @@ remmina_ssh_shell_open(RemminaSSHShell *shell, RemminaSSHExitFunc exit_callback,
 	stermios.c_cflag |= CS8;
 	tcsetattr(shell->slave, TCSANOW, &stermios);
 
-	shell->exit_callback = exit_callback;
-	shell->user_data = data;
-
 	/* Once the process started, we should always TRUE and assume the pthread will be created always */
 	pthread_create(&shell->thread, NULL, remmina_ssh_shell_thread, shell);
 
@@ -2540,6 +3758,27 @@ remmina_ssh_shell_set_size(RemminaSSHShell *shell, gint columns, gint rows)
 	UNLOCK_SSH(shell)
 }
 
+void
+remmina_ssh_shell_write(RemminaSSHShell *shell, const gchar *data, gsize len)
+{
+	TRACE_CALL(__func__);
+	gboolean wakeup;
+
+	/* With a PTY the input goes through the PTY */
+	if (!shell->input)
+		return;
+
+	/* The channel belongs to the shell thread, which may be in select():
+	 * queue the input and wake it up, it is written from there */
+	g_mutex_lock(&shell->output_mutex);
+	wakeup = shell->input->len == 0;
+	g_byte_array_append(shell->input, (const guint8 *)data, len);
+	g_mutex_unlock(&shell->output_mutex);
+
+	if (wakeup && write(shell->input_pipe[1], "", 1) < 0 && errno != EAGAIN)
+		REMMINA_DEBUG("Could not wake up the shell thread: %s", g_strerror(errno));
+}
+
 void
 remmina_ssh_shell_free(RemminaSSHShell *shell)
 {
@@ -2551,7 +3790,23 @@ remmina_ssh_shell_free(RemminaSSHShell *shell)
 		shell->closed = TRUE;
 		pthread_join(thread, NULL);
 	}
-	close(shell->slave);
+	if (shell->output) {
+		/* Output not fed yet is dropped with the terminal */
+		if (shell->output_idle)
+			g_source_remove(shell->output_idle);
+		if (shell->eof_idle)
+			g_source_remove(shell->eof_idle);
+		g_byte_array_unref(shell->output);
+		g_byte_array_unref(shell->input);
+		g_mutex_clear(&shell->output_mutex);
+		g_cond_clear(&shell->output_cond);
+	}
+	if (shell->input_pipe[0] >= 0)
+		close(shell->input_pipe[0]);
+	if (shell->input_pipe[1] >= 0)
+		close(shell->input_pipe[1]);
+	if (shell->slave >= 0)
+		close(shell->slave);
 	if (shell->exec) {
 		g_free(shell->exec);
 		shell->exec = NULL;
@@ -56,6 +56,8 @@ G_BEGIN_DECLS
 
 #define REMMINA_SSH(a) ((RemminaSSH *)a)
 
+typedef struct _RemminaSSHConnection RemminaSSHConnection;
+
 typedef struct _RemminaSSH {
 	ssh_session	session;
 	ssh_callbacks	callback;
@@ -88,6 +90,15 @@ typedef struct _RemminaSSH {
 	gchar *		tunnel_entrance_host;
 	gint		tunnel_entrance_port;
 
+	/* Connection shared with other sessions to the same account, NULL while
+	 * the session is our own. See remmina_ssh_init_session() */
+	RemminaSSHConnection *connection;
+	/* remmina_ssh_auth() has not checked our credentials against it yet */
+	gboolean	connection_unverified;
+	/* Our credentials did not match the shared connection, keep our own */
+	gboolean	connection_refused;
+	/* The thread driving the session was cancelled */
+	gboolean	cancelled;
 } RemminaSSH;
 
 gchar *remmina_ssh_identity_path(const gchar *id);
@@ -129,6 +140,9 @@ gchar *remmina_ssh_unconvert(RemminaSSH *ssh, const gchar *from);
 
 void remmina_ssh_free(RemminaSSH *ssh);
 
+/* The thread driving ssh was cancelled: its connection is never shared again */
+void remmina_ssh_set_cancelled(RemminaSSH *ssh);
+
 /*-----------------------------------------------------------------------------*
 *                           SSH Tunnel                                        *
 *-----------------------------------------------------------------------------*/
@@ -160,12 +174,22 @@ struct _RemminaSSHTunnel {
 
 	gchar *				buffer;
 	gint				buffer_len;
-	ssh_channel *			channels_out;
+
+	/* Event loop of the tunnel thread (epoll, or poll() where epoll is missing) */
+	gint				poll_fd;
+	gint				poll_server_sock;
+	guint				poll_session_events;
 
 	gint				server_sock;
 	gchar *				dest;
 	gint				port;
+	/* REVERSE: local port to connect to. OPEN: local port the tunnel listens on */
 	gint				localport;
+	/* OPEN: seconds the listener is kept once the last connection is gone,
+	 * 0 closes it in remmina_ssh_tunnel_cancel_accept() */
+	gint				linger;
+	/* The server answered the last keepalive sent while lingering */
+	gint				alive;
 
 	gint				remotedisplay;
 	gboolean			bindlocalhost;
@@ -186,15 +210,23 @@ RemminaSSHTunnel *remmina_ssh_tunnel_new_from_file(RemminaFile *remminafile);
 
 /* Open the tunnel. A new thread will be started and listen on a local port.
  * dest: The host:port of the remote destination
- * local_port: The listening local port for the tunnel
+ * local_port: The first local port tried for the tunnel. Ports in use, including
+ *             the ones leased to other tunnels, are skipped and the system picks
+ *             a free port when none is available. 0 lets the system pick directly.
+ *             The port actually used is stored in tunnel->localport.
  */
 gboolean remmina_ssh_tunnel_open(RemminaSSHTunnel *tunnel, const gchar *host, gint port, gint local_port);
 
 /* Cancel accepting any incoming tunnel request.
  * Typically called after the connection has already been establish.
+ * Does nothing when the tunnel lingers (tunnel->linger > 0).
  */
 void remmina_ssh_tunnel_cancel_accept(RemminaSSHTunnel *tunnel);
 
+/* Tells if an OPEN tunnel to host:port still accepts local connections and
+ * its SSH transport answered the last keepalive */
+gboolean remmina_ssh_tunnel_listening(RemminaSSHTunnel *tunnel, const gchar *host, gint port);
+
 /* start X Port Forwarding */
 gboolean remmina_ssh_tunnel_xport(RemminaSSHTunnel *tunnel, gboolean bindlocalhost);
 
@@ -220,6 +252,9 @@ typedef struct _RemminaSFTP {
 	RemminaSSH	ssh;
 
 	sftp_session	sftp_sess;
+	/* Set on a channel opened by remmina_sftp_new_channel(): the SSH session
+	 * and its lock belong to parent */
+	struct _RemminaSFTP *parent;
 } RemminaSFTP;
 
 /* Create a new SFTP session object from RemminaFile */
@@ -228,9 +263,17 @@ RemminaSFTP *remmina_sftp_new_from_file(RemminaFile *remminafile);
 /* Create a new SFTP session object from existing SSH session */
 RemminaSFTP *remmina_sftp_new_from_ssh(RemminaSSH *ssh);
 
+/* Create another SFTP session object on the SSH session of parent, which
+ * must be connected and must outlive it. Open it with remmina_sftp_open() */
+RemminaSFTP *remmina_sftp_new_channel(RemminaSFTP *parent);
+
 /* open the SFTP session, assuming the session already authenticated */
 gboolean remmina_sftp_open(RemminaSFTP *sftp);
 
+/* Serialize the libssh calls of the SFTP sessions sharing one SSH session */
+void remmina_sftp_lock(RemminaSFTP *sftp);
+void remmina_sftp_unlock(RemminaSFTP *sftp);
+
 /* Free the SFTP session */
 void remmina_sftp_free(RemminaSFTP *sftp);
 
@@ -238,6 +281,7 @@ void remmina_sftp_free(RemminaSFTP *sftp);
 *                           SSH Shell                                         *
 *-----------------------------------------------------------------------------*/
 typedef void (*RemminaSSHExitFunc) (gpointer data);
+typedef void (*RemminaSSHShellOutputFunc) (const gchar *data, gsize len, gpointer user_data);
 
 typedef struct _RemminaSSHShell {
 	RemminaSSH		ssh;
@@ -250,6 +294,22 @@ typedef struct _RemminaSSHShell {
 	gboolean		closed;
 	RemminaSSHExitFunc	exit_callback;
 	gpointer		user_data;
+
+	/* When set before remmina_ssh_shell_open(), no PTY is created: the output
+	 * is given to output_func on the main thread, with user_data, and the
+	 * input is sent with remmina_ssh_shell_write() */
+	RemminaSSHShellOutputFunc output_func;
+	/* Without PTY VTE never sees the end of the shell: eof_func is called on
+	 * the main thread, with user_data, when the channel reaches EOF */
+	RemminaSSHExitFunc	eof_func;
+	guint			eof_idle;
+	GMutex			output_mutex;
+	GCond			output_cond;
+	GByteArray *		output;
+	guint			output_idle;
+	/* Input waiting for the shell thread, which is woken up through input_pipe */
+	GByteArray *		input;
+	gint			input_pipe[2];
 } RemminaSSHShell;
 
 /* Create a new SSH Shell session object from RemminaFile */
@@ -264,6 +324,9 @@ gboolean remmina_ssh_shell_open(RemminaSSHShell *shell, RemminaSSHExitFunc exit_
 /* Change the SSH Shell terminal size */
 void remmina_ssh_shell_set_size(RemminaSSHShell *shell, gint columns, gint rows);
 
+/* Send user input to a shell opened with an output_func, from the main thread */
+void remmina_ssh_shell_write(RemminaSSHShell *shell, const gchar *data, gsize len);
+
 /* Free the SFTP session */
 void remmina_ssh_shell_free(RemminaSSHShell *shell);
 
@@ -242,6 +242,41 @@ static RemminaPluginService *remmina_plugin_service = NULL;
 
 static gboolean
 remmina_plugin_ssh_on_size_allocate(GtkWidget *widget, GtkAllocation *alloc, RemminaProtocolWidget *gp);
+static void
+remmina_plugin_ssh_eof(VteTerminal *vteterminal, RemminaProtocolWidget *gp);
+
+/* The terminal has no PTY: the shell output is fed to VTE directly */
+static void
+remmina_plugin_ssh_shell_output(const gchar *data, gsize len, gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaProtocolWidget *gp = (RemminaProtocolWidget *)user_data;
+	RemminaPluginSshData *gpdata = GET_PLUGIN_DATA(gp);
+
+	vte_terminal_feed(VTE_TERMINAL(gpdata->vte), data, len);
+}
+
+/* VTE has no child to see exiting, so the shell tells us when the channel ends */
+static void
+remmina_plugin_ssh_shell_eof(gpointer user_data)
+{
+	TRACE_CALL(__func__);
+	RemminaProtocolWidget *gp = (RemminaProtocolWidget *)user_data;
+	RemminaPluginSshData *gpdata = GET_PLUGIN_DATA(gp);
+
+	remmina_plugin_ssh_eof(VTE_TERMINAL(gpdata->vte), gp);
+}
+
+/* and the keyboard input, paste included, goes to the SSH channel */
+static void
+remmina_plugin_ssh_on_commit(VteTerminal *vte, gchar *text, guint size, RemminaProtocolWidget *gp)
+{
+	TRACE_CALL(__func__);
+	RemminaPluginSshData *gpdata = GET_PLUGIN_DATA(gp);
+
+	if (gpdata->shell)
+		remmina_ssh_shell_write(gpdata->shell, text, size);
+}
 
 static gboolean
 valid_color(GdkRGBA const* color)
@@ -293,6 +328,8 @@ remmina_plugin_ssh_main_thread(gpointer data)
 	if (ssh) {
 		REMMINA_DEBUG("Creating SSH shell based on existing SSH session");
 		shell = remmina_ssh_shell_new_from_ssh(ssh);
+		shell->output_func = remmina_plugin_ssh_shell_output;
+		shell->eof_func = remmina_plugin_ssh_shell_eof;
 		REMMINA_DEBUG("Calling remmina_public_get_server_port");
 		remmina_plugin_service->get_server_port(hostport, 22, &ssh->tunnel_entrance_host, &ssh->tunnel_entrance_port);
 		REMMINA_DEBUG("tunnel_entrance_host: %s, tunnel_entrance_port: %d", ssh->tunnel_entrance_host, ssh->tunnel_entrance_port);
@@ -306,6 +343,8 @@ remmina_plugin_ssh_main_thread(gpointer data)
 		/* New SSH Shell connection */
 		REMMINA_DEBUG("Creating SSH shell based on a new SSH session");
 		shell = remmina_ssh_shell_new_from_file(remminafile);
+		shell->output_func = remmina_plugin_ssh_shell_output;
+		shell->eof_func = remmina_plugin_ssh_shell_eof;
 		ssh = REMMINA_SSH(shell);
 		REMMINA_DEBUG("Calling remmina_public_get_server_port");
 		remmina_plugin_service->get_server_port(hostport, 22, &ssh->tunnel_entrance_host, &ssh->tunnel_entrance_port);
@@ -415,6 +454,10 @@ void remmina_plugin_ssh_vte_terminal_set_encoding_and_pty(VteTerminal *terminal,
 	vte_terminal_set_backspace_binding(terminal, VTE_ERASE_ASCII_DELETE);
 	vte_terminal_set_delete_binding(terminal, VTE_ERASE_DELETE_SEQUENCE);
 
+	/* A shell without PTY is connected through "commit" and vte_terminal_feed() */
+	if (master < 0)
+		return;
+
 #if VTE_CHECK_VERSION(0, 38, 0)
 	/* vte_pty_new_foreign expect master FD, see https://bugzilla.gnome.org/show_bug.cgi?id=765382 */
 	vte_terminal_set_pty(terminal, vte_pty_new_foreign_sync(master, NULL, NULL));
@@ -876,6 +919,9 @@ remmina_plugin_ssh_close_connection(RemminaProtocolWidget *gp)
 	if (gpdata->thread) {
 		pthread_cancel(gpdata->thread);
 		if (gpdata->thread) pthread_join(gpdata->thread, NULL);
+		/* Whatever it was doing with the SSH connection is lost */
+		if (gpdata->shell)
+			remmina_ssh_set_cancelled(REMMINA_SSH(gpdata->shell));
 	}
 	if (gpdata->shell) {
 		remmina_ssh_shell_free(gpdata->shell);
@@ -1245,6 +1291,7 @@ remmina_plugin_ssh_init(RemminaProtocolWidget *gp)
 	gpdata->vte_session_file = g_file_new_for_path(fp);
 
 	g_signal_connect(G_OBJECT(vte), "size-allocate", G_CALLBACK(remmina_plugin_ssh_on_size_allocate), gp);
+	g_signal_connect(G_OBJECT(vte), "commit", G_CALLBACK(remmina_plugin_ssh_on_commit), gp);
 	g_signal_connect (G_OBJECT(vte), "unrealize", G_CALLBACK(remmina_plugin_ssh_eof), gp);
 	g_signal_connect (G_OBJECT(vte), "eof", G_CALLBACK(remmina_plugin_ssh_eof), gp);
 	g_signal_connect (G_OBJECT(vte), "child-exited", G_CALLBACK(remmina_plugin_ssh_eof), gp);
@@ -1514,6 +1561,7 @@ static const RemminaProtocolSetting remmina_ssh_advanced_settings[] =
 	{ REMMINA_PROTOCOL_SETTING_TYPE_TEXT,	"sshlogname",		  N_("Filename for SSH session log"),	      FALSE, NULL,		   log_tips },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	"sshlogenabled",	  N_("Log SSH session when exiting Remmina"), FALSE, NULL,		   NULL	    },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	"sshsavesession",	  N_("Log SSH session asynchronously"), FALSE, NULL,		   N_("Saving the session asynchronously may have a notable performance impact")	    },
+	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	"sshlogcompress",	  N_("Compress SSH session log with gzip"),  FALSE, NULL,		   NULL	    },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	"audiblebell",		  N_("Audible terminal bell"),		      FALSE, NULL,		   NULL	    },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	"ssh_compression",	  N_("SSH compression"),		      FALSE, NULL,		   NULL	    },
 	{ REMMINA_PROTOCOL_SETTING_TYPE_CHECK,	"disablepasswordstoring", N_("Don't remember passwords"),	      TRUE,  NULL,		   NULL	    },
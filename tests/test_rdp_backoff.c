@@ -0,0 +1,138 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+
+#include <glib.h>
+#include "rdp/rdp_backoff.h"
+
+#define INITIAL_DELAY 500
+#define MAX_DELAY 30000
+
+typedef struct {
+	gint64 now;
+} FakeClock;
+
+static gint64 fake_clock_now(gpointer user_data)
+{
+	return ((FakeClock *)user_data)->now;
+}
+
+static void test_delay_doubles_up_to_max(void)
+{
+	/* Without jitter the delay is half of initial_delay * 2^nattempt */
+	g_assert_cmpint(remmina_rdp_backoff_delay(0, INITIAL_DELAY, MAX_DELAY, 0.0), ==, 250);
+	g_assert_cmpint(remmina_rdp_backoff_delay(1, INITIAL_DELAY, MAX_DELAY, 0.0), ==, 500);
+	g_assert_cmpint(remmina_rdp_backoff_delay(2, INITIAL_DELAY, MAX_DELAY, 0.0), ==, 1000);
+	g_assert_cmpint(remmina_rdp_backoff_delay(5, INITIAL_DELAY, MAX_DELAY, 0.0), ==, 8000);
+
+	/* 500 * 2^6 is over the maximum */
+	g_assert_cmpint(remmina_rdp_backoff_delay(6, INITIAL_DELAY, MAX_DELAY, 0.0), ==, MAX_DELAY / 2);
+	g_assert_cmpint(remmina_rdp_backoff_delay(G_MAXINT, INITIAL_DELAY, MAX_DELAY, 0.0), ==, MAX_DELAY / 2);
+}
+
+static void test_delay_jitter(void)
+{
+	const gdouble randoms[] = { 0.0, 0.25, 0.5, 0.75, 0.999999 };
+	gint64 delay, previous;
+	gint nattempt;
+	guint i;
+
+	g_assert_cmpint(remmina_rdp_backoff_delay(3, INITIAL_DELAY, MAX_DELAY, 0.5), ==, 3000);
+
+	/* The randomized delay stays in [delay / 2, delay] and grows with random */
+	for (nattempt = 0; nattempt < 10; nattempt++) {
+		previous = 0;
+		for (i = 0; i < G_N_ELEMENTS(randoms); i++) {
+			delay = remmina_rdp_backoff_delay(nattempt, INITIAL_DELAY, MAX_DELAY, randoms[i]);
+			g_assert_cmpint(delay, >=, MIN(INITIAL_DELAY << nattempt, MAX_DELAY) / 2);
+			g_assert_cmpint(delay, <=, MIN(INITIAL_DELAY << nattempt, MAX_DELAY));
+			g_assert_cmpint(delay, >=, previous);
+			previous = delay;
+		}
+	}
+}
+
+static void test_schedule_fake_clock(void)
+{
+	RemminaRdpBackoff backoff;
+	FakeClock clock = { 1000000 };
+
+	remmina_rdp_backoff_init(&backoff, INITIAL_DELAY, MAX_DELAY, fake_clock_now, &clock);
+	g_assert_cmpint(remmina_rdp_backoff_remaining(&backoff), ==, 0);
+
+	g_assert_cmpint(remmina_rdp_backoff_schedule(&backoff, 0, 0.0), ==, 250);
+	g_assert_cmpint(remmina_rdp_backoff_remaining(&backoff), ==, 250);
+	clock.now += 100000;
+	g_assert_cmpint(remmina_rdp_backoff_remaining(&backoff), ==, 150);
+
+	/* Not due a microsecond early */
+	clock.now += 149999;
+	g_assert_cmpint(remmina_rdp_backoff_remaining(&backoff), ==, 1);
+	clock.now += 1;
+	g_assert_cmpint(remmina_rdp_backoff_remaining(&backoff), ==, 0);
+	clock.now += 5000000;
+	g_assert_cmpint(remmina_rdp_backoff_remaining(&backoff), ==, 0);
+}
+
+static void test_schedule_from_end_of_attempt(void)
+{
+	RemminaRdpBackoff backoff;
+	FakeClock clock = { 0 };
+	gint nattempt;
+
+	remmina_rdp_backoff_init(&backoff, INITIAL_DELAY, MAX_DELAY, fake_clock_now, &clock);
+
+	/* Every attempt takes 20 s, longer than any delay: the full delay is
+	 * still waited once it failed */
+	for (nattempt = 0; nattempt < 8; nattempt++) {
+		remmina_rdp_backoff_schedule(&backoff, nattempt, 0.0);
+		g_assert_cmpint(remmina_rdp_backoff_remaining(&backoff), ==,
+				remmina_rdp_backoff_delay(nattempt, INITIAL_DELAY, MAX_DELAY, 0.0));
+		clock.now = backoff.next_attempt;
+		g_assert_cmpint(remmina_rdp_backoff_remaining(&backoff), ==, 0);
+		clock.now += 20000000;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/rdp/backoff/delay", test_delay_doubles_up_to_max);
+	g_test_add_func("/rdp/backoff/jitter", test_delay_jitter);
+	g_test_add_func("/rdp/backoff/fake-clock", test_schedule_fake_clock);
+	g_test_add_func("/rdp/backoff/end-of-attempt", test_schedule_from_end_of_attempt);
+
+	return g_test_run();
+}
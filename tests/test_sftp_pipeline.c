@@ -0,0 +1,439 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+
+#include <glib.h>
+#include <string.h>
+#include "remmina_sftp_pipeline.h"
+
+/* A fake SFTP server for remmina_sftp_pipeline: it answers the requests
+ * in a random order, caps the payloads like real servers do, and keeps a
+ * virtual clock to estimate the throughput for a given round trip time */
+
+typedef struct {
+	guint64		offset;
+	gsize		len;
+	gssize		result;
+	gboolean	answered;
+	gint64		ready;  /* Virtual time the reply arrives at, in us */
+} FakeReply;
+
+typedef struct {
+	GByteArray *	remote;
+	GByteArray *	local;
+	gsize		upload_pos;
+
+	gsize		max_payload;    /* 0 for no cap */
+	gint		window;
+	gint		fail_request;   /* Index of the request failing, -1 for none */
+	gint		cancel_after;   /* Replies stored before cancelling, -1 for never */
+
+	GList *		unanswered;
+	gint		in_flight, begun, collected, discarded, stored;
+	gint		out_of_order;
+	GRand *		rand;
+
+	/* Virtual link */
+	gint64		now, link_free, rtt;
+	gdouble		bytes_per_us;
+} FakeServer;
+
+static void fake_server_init(FakeServer *server, GByteArray *remote, gint window, gsize max_payload)
+{
+	memset(server, 0, sizeof(*server));
+	server->remote = remote;
+	server->local = g_byte_array_new();
+	server->window = window;
+	server->max_payload = max_payload;
+	server->fail_request = -1;
+	server->cancel_after = -1;
+	server->rand = g_rand_new_with_seed(window * 7919 + max_payload);
+}
+
+static void fake_server_clear(FakeServer *server)
+{
+	/* Every request sent was either collected or discarded */
+	g_assert_cmpint(server->in_flight, ==, 0);
+	g_assert_cmpint(server->begun, ==, server->collected + server->discarded);
+	g_assert_null(server->unanswered);
+	g_byte_array_unref(server->local);
+	g_rand_free(server->rand);
+}
+
+static gsize fake_server_cap(FakeServer *server, gsize len)
+{
+	return server->max_payload ? MIN(len, server->max_payload) : len;
+}
+
+static FakeReply *fake_server_begin(FakeServer *server, RemminaSFTPRequest *req)
+{
+	FakeReply *reply;
+	gint64 transfer;
+	gsize len;
+
+	g_assert_cmpint(server->in_flight, <, server->window);
+	reply = g_new0(FakeReply, 1);
+	reply->offset = req->offset;
+	reply->len = req->len;
+	reply->result = server->begun == server->fail_request ? -1 : 0;
+
+	/* The request reaches the server after half a round trip, the payload
+	 * then waits for the link and comes back after the other half */
+	len = MIN(req->len, req->offset < server->remote->len ? server->remote->len - req->offset : 0);
+	transfer = server->bytes_per_us > 0 ? (gint64)(len / server->bytes_per_us) : 0;
+	server->link_free = MAX(server->link_free, server->now + server->rtt / 2) + transfer;
+	reply->ready = server->link_free + server->rtt / 2;
+
+	req->handle = reply;
+	server->unanswered = g_list_append(server->unanswered, reply);
+	server->in_flight++;
+	server->begun++;
+	return reply;
+}
+
+/* Answer a random number of requests in a random order, then make sure
+ * reply is answered too */
+static void fake_server_answer(FakeServer *server, FakeReply *reply)
+{
+	FakeReply *other;
+	gint n;
+
+	n = g_rand_int_range(server->rand, 0, g_list_length(server->unanswered) + 1);
+	while (n-- > 0) {
+		other = g_list_nth_data(server->unanswered, g_rand_int_range(server->rand, 0, g_list_length(server->unanswered)));
+		if (other != server->unanswered->data)
+			server->out_of_order++;
+		other->answered = TRUE;
+		server->unanswered = g_list_remove(server->unanswered, other);
+	}
+	if (!reply->answered) {
+		reply->answered = TRUE;
+		server->unanswered = g_list_remove(server->unanswered, reply);
+	}
+	server->now = MAX(server->now, reply->ready);
+}
+
+static FakeReply *fake_server_collect(FakeServer *server, RemminaSFTPRequest *req)
+{
+	FakeReply *reply = req->handle;
+
+	/* The reply is the one of this request, at the offset it asked for */
+	g_assert_nonnull(reply);
+	g_assert_cmpuint(reply->offset, ==, req->offset);
+	g_assert_cmpuint(reply->len, ==, req->len);
+	fake_server_answer(server, reply);
+	req->handle = NULL;
+	server->in_flight--;
+	server->collected++;
+	return reply;
+}
+
+static gboolean fake_read_begin(gpointer user_data, RemminaSFTPRequest *req)
+{
+	fake_server_begin(user_data, req);
+	return TRUE;
+}
+
+static gssize fake_read_wait(gpointer user_data, RemminaSFTPRequest *req, gchar *buf)
+{
+	FakeServer *server = user_data;
+	FakeReply *reply;
+	gssize len;
+
+	reply = fake_server_collect(server, req);
+	len = reply->result;
+	if (len == 0 && reply->offset < server->remote->len) {
+		len = fake_server_cap(server, MIN(reply->len, server->remote->len - reply->offset));
+		memcpy(buf, server->remote->data + reply->offset, len);
+	}
+	g_free(reply);
+	return len;
+}
+
+static gboolean fake_deliver(gpointer user_data, const gchar *buf, gsize len)
+{
+	FakeServer *server = user_data;
+
+	g_byte_array_append(server->local, (const guint8 *)buf, len);
+	server->stored++;
+	return TRUE;
+}
+
+static gssize fake_fill(gpointer user_data, gchar *buf, gsize len)
+{
+	FakeServer *server = user_data;
+
+	len = MIN(len, server->local->len - server->upload_pos);
+	memcpy(buf, server->local->data + server->upload_pos, len);
+	server->upload_pos += len;
+	return len;
+}
+
+static gboolean fake_write_begin(gpointer user_data, RemminaSFTPRequest *req, const gchar *buf)
+{
+	FakeServer *server = user_data;
+	FakeReply *reply;
+	gsize len;
+
+	reply = fake_server_begin(server, req);
+	if (reply->result == 0) {
+		/* A server writing less than asked */
+		len = fake_server_cap(server, req->len);
+		if (server->remote->len < req->offset + len)
+			g_byte_array_set_size(server->remote, req->offset + len);
+		memcpy(server->remote->data + req->offset, buf, len);
+		reply->result = len;
+	}
+	return TRUE;
+}
+
+static gssize fake_write_wait(gpointer user_data, RemminaSFTPRequest *req)
+{
+	FakeReply *reply;
+	gssize len;
+
+	reply = fake_server_collect(user_data, req);
+	len = reply->result;
+	g_free(reply);
+	return len;
+}
+
+static void fake_written(gpointer user_data, gsize len)
+{
+	((FakeServer *)user_data)->stored++;
+}
+
+static void fake_discard(gpointer user_data, RemminaSFTPRequest *req)
+{
+	FakeServer *server = user_data;
+	FakeReply *reply = req->handle;
+
+	server->unanswered = g_list_remove(server->unanswered, reply);
+	g_free(reply);
+	req->handle = NULL;
+	server->in_flight--;
+	server->discarded++;
+}
+
+static gboolean fake_cancelled(gpointer user_data)
+{
+	FakeServer *server = user_data;
+
+	return server->cancel_after >= 0 && server->stored >= server->cancel_after;
+}
+
+static const RemminaSFTPPipelineOps fake_ops = {
+	.read_begin	= fake_read_begin,
+	.read_wait	= fake_read_wait,
+	.deliver	= fake_deliver,
+	.fill		= fake_fill,
+	.write_begin	= fake_write_begin,
+	.write_wait	= fake_write_wait,
+	.written	= fake_written,
+	.discard	= fake_discard,
+	.cancelled	= fake_cancelled,
+};
+
+static GByteArray *random_file(gsize size)
+{
+	GByteArray *file;
+	gsize i;
+
+	file = g_byte_array_sized_new(size);
+	g_byte_array_set_size(file, size);
+	for (i = 0; i < size; i++)
+		file->data[i] = g_random_int_range(0, 256);
+	return file;
+}
+
+static const gsize sizes[] = { 0, 1, 4095, REMMINA_SFTP_CHUNK_INITIAL, REMMINA_SFTP_CHUNK_INITIAL + 1, 1000003 };
+static const gsize caps[] = { 0, 4096, 10000, 65536 };
+static const gint windows[] = { 1, 2, 16 };
+
+static void test_read(void)
+{
+	RemminaSFTPPipelineResult result;
+	FakeServer server;
+	GByteArray *remote;
+	guint s, c, w;
+	gsize offset;
+	gint out_of_order = 0;
+
+	for (s = 0; s < G_N_ELEMENTS(sizes); s++) {
+		remote = random_file(sizes[s]);
+		for (c = 0; c < G_N_ELEMENTS(caps); c++) {
+			for (w = 0; w < G_N_ELEMENTS(windows); w++) {
+				/* From the start, and resuming a partial download */
+				for (offset = 0; offset <= sizes[s]; offset += MAX(sizes[s] / 3 + 1, 1)) {
+					fake_server_init(&server, remote, windows[w], caps[c]);
+					result = remmina_sftp_pipeline_read(&fake_ops, &server, windows[w], REMMINA_SFTP_CHUNK_MAX, offset);
+					g_assert_cmpint(result, ==, REMMINA_SFTP_PIPELINE_DONE);
+					/* Short reads at the end of file and capped payloads leave no gap */
+					g_assert_cmpmem(server.local->data, server.local->len, remote->data + offset, remote->len - offset);
+					out_of_order += server.out_of_order;
+					fake_server_clear(&server);
+				}
+			}
+		}
+		g_byte_array_unref(remote);
+	}
+
+	/* The replies were really answered out of order */
+	g_assert_cmpint(out_of_order, >, 0);
+}
+
+static void test_read_error(void)
+{
+	RemminaSFTPPipelineResult result;
+	FakeServer server;
+	GByteArray *remote;
+
+	remote = random_file(1000003);
+
+	/* A failed request: what was stored before is the start of the file */
+	fake_server_init(&server, remote, 16, 10000);
+	server.fail_request = 20;
+	result = remmina_sftp_pipeline_read(&fake_ops, &server, 16, REMMINA_SFTP_CHUNK_MAX, 0);
+	g_assert_cmpint(result, ==, REMMINA_SFTP_PIPELINE_REMOTE_ERROR);
+	g_assert_cmpuint(server.local->len, <, remote->len);
+	g_assert_cmpmem(server.local->data, server.local->len, remote->data, server.local->len);
+	fake_server_clear(&server);
+
+	/* A cancel drains the requests in flight */
+	fake_server_init(&server, remote, 16, 0);
+	server.cancel_after = 5;
+	result = remmina_sftp_pipeline_read(&fake_ops, &server, 16, REMMINA_SFTP_CHUNK_MAX, 0);
+	g_assert_cmpint(result, ==, REMMINA_SFTP_PIPELINE_CANCELLED);
+	g_assert_cmpint(server.stored, ==, 5);
+	g_assert_cmpmem(server.local->data, server.local->len, remote->data, server.local->len);
+	fake_server_clear(&server);
+
+	g_byte_array_unref(remote);
+}
+
+static void test_write(void)
+{
+	RemminaSFTPPipelineResult result;
+	FakeServer server;
+	GByteArray *remote, *source;
+	guint s, w;
+
+	for (s = 0; s < G_N_ELEMENTS(sizes); s++) {
+		source = random_file(sizes[s]);
+		for (w = 0; w < G_N_ELEMENTS(windows); w++) {
+			remote = g_byte_array_new();
+			fake_server_init(&server, remote, windows[w], 0);
+			g_byte_array_append(server.local, source->data, source->len);
+			result = remmina_sftp_pipeline_write(&fake_ops, &server, windows[w], 32 * 1024, 0);
+			g_assert_cmpint(result, ==, REMMINA_SFTP_PIPELINE_DONE);
+			g_assert_cmpmem(remote->data, remote->len, source->data, source->len);
+			fake_server_clear(&server);
+			g_byte_array_unref(remote);
+		}
+		g_byte_array_unref(source);
+	}
+}
+
+static void test_write_error(void)
+{
+	RemminaSFTPPipelineResult result;
+	FakeServer server;
+	GByteArray *remote, *source;
+
+	source = random_file(1000003);
+
+	/* A short write fails the upload, the requests behind it are collected */
+	remote = g_byte_array_new();
+	fake_server_init(&server, remote, 16, 10000);
+	g_byte_array_append(server.local, source->data, source->len);
+	result = remmina_sftp_pipeline_write(&fake_ops, &server, 16, 32 * 1024, 0);
+	g_assert_cmpint(result, ==, REMMINA_SFTP_PIPELINE_REMOTE_ERROR);
+	g_assert_cmpint(server.stored, ==, 0);
+	fake_server_clear(&server);
+	g_byte_array_unref(remote);
+
+	/* A failed request */
+	remote = g_byte_array_new();
+	fake_server_init(&server, remote, 16, 0);
+	server.fail_request = 3;
+	g_byte_array_append(server.local, source->data, source->len);
+	result = remmina_sftp_pipeline_write(&fake_ops, &server, 16, 32 * 1024, 0);
+	g_assert_cmpint(result, ==, REMMINA_SFTP_PIPELINE_REMOTE_ERROR);
+	g_assert_cmpint(server.stored, ==, 3);
+	fake_server_clear(&server);
+	g_byte_array_unref(remote);
+
+	g_byte_array_unref(source);
+}
+
+static void test_benchmark(void)
+{
+	const gint bench_windows[] = { 1, 4, 16, 64 };
+	const gint64 rtts[] = { 1000, 20000, 100000 };
+	FakeServer server;
+	GByteArray *remote;
+	guint r, w;
+
+	if (!g_test_perf())
+		return;
+
+	/* 64 MiB over a 100 MB/s link, on a virtual clock */
+	remote = random_file(64 * 1024 * 1024);
+	for (r = 0; r < G_N_ELEMENTS(rtts); r++) {
+		for (w = 0; w < G_N_ELEMENTS(bench_windows); w++) {
+			fake_server_init(&server, remote, bench_windows[w], 0);
+			server.rtt = rtts[r];
+			server.bytes_per_us = 100.0;
+			g_assert_cmpint(remmina_sftp_pipeline_read(&fake_ops, &server, bench_windows[w], REMMINA_SFTP_CHUNK_MAX, 0),
+					==, REMMINA_SFTP_PIPELINE_DONE);
+			g_test_message("download, rtt %" G_GINT64_FORMAT " ms, %d requests in flight: %.1f MB/s",
+				       rtts[r] / 1000, bench_windows[w], (gdouble)remote->len / server.now);
+			fake_server_clear(&server);
+		}
+	}
+	g_byte_array_unref(remote);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/sftp/pipeline/read", test_read);
+	g_test_add_func("/sftp/pipeline/read-error", test_read_error);
+	g_test_add_func("/sftp/pipeline/write", test_write);
+	g_test_add_func("/sftp/pipeline/write-error", test_write_error);
+	g_test_add_func("/sftp/pipeline/benchmark", test_benchmark);
+
+	return g_test_run();
+}
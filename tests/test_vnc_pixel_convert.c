@@ -0,0 +1,201 @@
+/*
+ * Remmina - The GTK+ Remote Desktop Client
+ * Copyright (C) 2016-2021 Antenore Gatta, Giovanni Panozzo
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ *
+ *  In addition, as a special exception, the copyright holders give
+ *  permission to link the code of portions of this program with the
+ *  OpenSSL library under certain conditions as described in each
+ *  individual source file, and distribute linked combinations
+ *  including the two.
+ *  You must obey the GNU General Public License in all respects
+ *  for all of the code used other than OpenSSL. *  If you modify
+ *  file(s) with this exception, you may extend this exception to your
+ *  version of the file(s), but you are not obligated to do so. *  If you
+ *  do not wish to do so, delete this exception statement from your
+ *  version. *  If you delete this exception statement from all source
+ *  files in the program, then also delete it here.
+ *
+ */
+
+
+#include <glib.h>
+#include <string.h>
+#include "vnc/vnc_pixel_convert.h"
+
+/* Every row kernel is checked against the generic scalar code, which is
+ * the conversion the VNC plugin always had. Run with -m perf to also get
+ * the throughput of each kernel */
+
+#define CANARY 0xdeadbeef
+
+static const gchar *kernels[] = { "avx2", "sse2", "neon", "scalar", "lut", "generic" };
+
+typedef struct {
+	const gchar *	name;
+	rfbPixelFormat	format;
+} TestFormat;
+
+static const TestFormat formats[] = {
+	/* bitsPerPixel, depth, bigEndian, trueColour, red/green/blueMax, red/green/blueShift */
+	{ "bgrx8888", { 32, 24, 0, 1, 255, 255, 255, 16, 8, 0 } },
+	{ "rgb565", { 16, 16, 0, 1, 31, 63, 31, 11, 5, 0 } },
+	{ "rgb555", { 16, 15, 0, 1, 31, 31, 31, 10, 5, 0 } },
+	{ "rgb444", { 16, 12, 0, 1, 15, 15, 15, 8, 4, 0 } },
+	{ "bgr233", { 8, 8, 0, 1, 7, 7, 3, 0, 3, 6 } },
+};
+
+static void fill_random(guchar *buf, gsize size)
+{
+	gsize i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = g_random_int_range(0, 256);
+}
+
+/* Convert a w x h rectangle with the given kernel. Rows are padded on both
+ * sides, and the padding must come out untouched */
+static guint32 *convert(const rfbPixelFormat *format, const gchar *kernel, const guchar *src, gint src_rowstride,
+			const guchar *mask, gint w, gint h)
+{
+	RemminaPluginVncPixelConverter conv = { 0 };
+	gint dest_stride = w + 2;
+	guint32 *dest;
+	gint i;
+
+	if (!remmina_plugin_vnc_pixel_converter_prepare_kernel(&conv, format, kernel))
+		return NULL;
+	g_assert_cmpstr(conv.kernel_name, ==, kernel);
+
+	dest = g_new(guint32, dest_stride * h);
+	for (i = 0; i < dest_stride * h; i++)
+		dest[i] = CANARY;
+	remmina_plugin_vnc_pixel_converter_convert(&conv, (guchar *)(dest + 1), dest_stride * 4, src, src_rowstride, mask, w, h);
+	for (i = 0; i < h; i++) {
+		g_assert_cmphex(dest[i * dest_stride], ==, CANARY);
+		g_assert_cmphex(dest[i * dest_stride + w + 1], ==, CANARY);
+	}
+	return dest;
+}
+
+static void test_kernels(gconstpointer data)
+{
+	const TestFormat *tf = data;
+	gint bytesPerPixel = tf->format.bitsPerPixel / 8;
+	gint w, h = 3, src_rowstride;
+	guint32 *expected, *result;
+	guchar *src, *mask;
+	guint k;
+	gint m;
+
+	/* Odd widths and every tail length of the 4, 8 and 16 pixel kernels */
+	for (w = 1; w <= 70; w++) {
+		src_rowstride = w * bytesPerPixel + 3;
+		src = g_malloc(src_rowstride * h);
+		fill_random(src, src_rowstride * h);
+		mask = g_malloc(w * h);
+		fill_random(mask, w * h);
+		for (m = 0; m < w * h; m++)
+			mask[m] = mask[m] & 1;
+
+		for (m = 0; m < 2; m++) {
+			expected = convert(&tf->format, "generic", src, src_rowstride, m ? mask : NULL, w, h);
+			g_assert_nonnull(expected);
+			for (k = 0; k < G_N_ELEMENTS(kernels); k++) {
+				result = convert(&tf->format, kernels[k], src, src_rowstride, m ? mask : NULL, w, h);
+				if (!result)
+					continue;
+				g_assert_cmpmem(result, (w + 2) * h * 4, expected, (w + 2) * h * 4);
+				g_free(result);
+			}
+			g_free(expected);
+		}
+
+		g_free(mask);
+		g_free(src);
+	}
+}
+
+static void test_best_kernel(void)
+{
+	RemminaPluginVncPixelConverter conv = { 0 };
+	rfbPixelFormat format = formats[0].format;
+
+	/* Without a name the best kernel is picked, and a change of format
+	 * prepares the converter again */
+	remmina_plugin_vnc_pixel_converter_prepare(&conv, &format);
+	g_assert_nonnull(conv.convert_row);
+	g_assert_cmpstr(conv.kernel_name, !=, "generic");
+	format.bitsPerPixel = 24;
+	remmina_plugin_vnc_pixel_converter_prepare(&conv, &format);
+	g_assert_cmpstr(conv.kernel_name, ==, "generic");
+	format = formats[4].format;
+	remmina_plugin_vnc_pixel_converter_prepare(&conv, &format);
+	g_assert_cmpstr(conv.kernel_name, ==, "lut");
+}
+
+static void test_benchmark(void)
+{
+	RemminaPluginVncPixelConverter conv = { 0 };
+	const gint w = 1920, h = 1080, rounds = 20;
+	guchar *src, *dest;
+	gint64 start, elapsed;
+	guint f, k;
+	gint i;
+
+	if (!g_test_perf())
+		return;
+
+	src = g_malloc(w * h * 4);
+	dest = g_malloc(w * h * 4);
+	fill_random(src, w * h * 4);
+
+	for (f = 0; f < G_N_ELEMENTS(formats); f++) {
+		for (k = 0; k < G_N_ELEMENTS(kernels); k++) {
+			if (!remmina_plugin_vnc_pixel_converter_prepare_kernel(&conv, &formats[f].format, kernels[k]))
+				continue;
+			start = g_get_monotonic_time();
+			for (i = 0; i < rounds; i++)
+				remmina_plugin_vnc_pixel_converter_convert(&conv, dest, w * 4, src,
+									   w * formats[f].format.bitsPerPixel / 8, NULL, w, h);
+			elapsed = MAX(g_get_monotonic_time() - start, 1);
+			g_test_message("%s %s: %.1f Mpixel/s", formats[f].name, kernels[k],
+				       (gdouble)w * h * rounds / elapsed);
+		}
+	}
+
+	g_free(dest);
+	g_free(src);
+}
+
+int main(int argc, char *argv[])
+{
+	gchar *path;
+	guint f;
+
+	g_test_init(&argc, &argv, NULL);
+
+	for (f = 0; f < G_N_ELEMENTS(formats); f++) {
+		path = g_strdup_printf("/vnc/pixel-convert/%s", formats[f].name);
+		g_test_add_data_func(path, &formats[f], test_kernels);
+		g_free(path);
+	}
+	g_test_add_func("/vnc/pixel-convert/best-kernel", test_best_kernel);
+	g_test_add_func("/vnc/pixel-convert/benchmark", test_benchmark);
+
+	return g_test_run();
+}